@@ -0,0 +1,72 @@
+#include "bench_thread.h"
+#include "../src/library.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+
+#define BENCH_MAX_THREADS 64
+
+typedef struct bench_thread {
+    pthread_t thread;
+    int (*proc)(void*);
+    void* ctx;
+    int result;
+    _Atomic bool used;
+} bench_thread_t;
+
+static bench_thread_t threads[BENCH_MAX_THREADS];
+static _Atomic int threads_alive = 0;
+
+static void* run_thread(void* param) {
+    bench_thread_t* thread = param;
+    thread->result = thread->proc(thread->ctx);
+    return NULL;
+}
+
+int bench_create_thread(int (*proc)(void*), void* ctx, uint32_t stack_size, unsigned int priority) {
+    for(int i = 0; i < BENCH_MAX_THREADS; i++) {
+        bool expected = false;
+        if(!atomic_compare_exchange_strong(&threads[i].used, &expected, true)) {
+            continue;
+        }
+
+        threads[i].proc = proc;
+        threads[i].ctx = ctx;
+        threads[i].result = 0;
+        if(pthread_create(&threads[i].thread, NULL, run_thread, &threads[i]) != 0) {
+            atomic_store(&threads[i].used, false);
+            return -1;
+        }
+
+        atomic_fetch_add(&threads_alive, 1);
+        return i;
+    }
+
+    return -1;
+}
+
+void bench_join_thread(int thread_id, int* result) {
+    pthread_join(threads[thread_id].thread, NULL);
+    if(result != NULL) {
+        *result = threads[thread_id].result;
+    }
+}
+
+void bench_destroy_thread(int thread_id) {
+    atomic_fetch_sub(&threads_alive, 1);
+    atomic_store(&threads[thread_id].used, false);
+}
+
+int bench_threads_alive(void) {
+    return atomic_load(&threads_alive);
+}
+
+void bench_use_threads(void) {
+    create_thread = bench_create_thread;
+    join_thread = bench_join_thread;
+    destroy_thread = bench_destroy_thread;
+}
+
+void bench_discard_log(const char* module, const char* fmt, ...) {
+}
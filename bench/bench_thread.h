@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+
+// pthread-backed stand-ins for the bemanitools thread callbacks, so every bench can hand the
+// library a host the way a game would. Slots are reused once destroyed.
+int bench_create_thread(int (*proc)(void*), void* ctx, uint32_t stack_size, unsigned int priority);
+void bench_join_thread(int thread_id, int* result);
+void bench_destroy_thread(int thread_id);
+
+// Threads created and not yet destroyed
+int bench_threads_alive(void);
+
+// Installs the callbacks above as create_thread/join_thread/destroy_thread
+void bench_use_threads(void);
+
+// Logger for eam_io_set_loggers() that drops everything
+void bench_discard_log(const char* module, const char* fmt, ...);
@@ -0,0 +1,150 @@
+// Allocation-counting test for the enumeration pipeline. malloc(), calloc(), realloc() and free() are
+// wrapped at link time (-Wl,--wrap), so every call the library makes is counted while libc's own are not.
+// Enumerates the machine's readers over and over and requires the same number of allocations each time,
+// nothing outstanding once the table is freed, and so memory that stays flat. Then groups a synthetic 1k
+// interfaces through an arena to show allocations follow arena blocks and not interfaces. Built with
+// LeakSanitizer, which catches what the counters can't see. Prints one JSON object and exits non-zero when
+// a check fails.
+//
+//   eamio_enumeration_allocs [enumerations]
+#include "../src/arena.h"
+#include "../src/device.h"
+#include "../src/device_group.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// The AIC Pico aic.c looks for
+#define VID 0xCAFF
+#define PID 0x400E
+#define CARDIO_MI 0
+#define KEYPAD_MI 1
+#define SYNTHETIC_READERS 500
+
+typedef struct allocation_counts {
+    uint64_t allocations;
+    uint64_t frees;
+    uint64_t bytes;
+    int64_t outstanding;
+} allocation_counts_t;
+
+static allocation_counts_t counts;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void* memory, size_t size);
+void __real_free(void* memory);
+
+void* __wrap_malloc(const size_t size) {
+    counts.allocations++;
+    counts.outstanding++;
+    counts.bytes += size;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(const size_t count, const size_t size) {
+    counts.allocations++;
+    counts.outstanding++;
+    counts.bytes += count * size;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void* memory, const size_t size) {
+    counts.allocations++;
+    counts.bytes += size;
+    if(memory == NULL) {
+        counts.outstanding++;
+    }
+    return __real_realloc(memory, size);
+}
+
+void __wrap_free(void* memory) {
+    if(memory != NULL) {
+        counts.frees++;
+        counts.outstanding--;
+    }
+    __real_free(memory);
+}
+
+static int checks_failed = 0;
+
+static void check(const bool passed, const char* what) {
+    if(!passed) {
+        fprintf(stderr, "Failed: %s\n", what);
+        checks_failed++;
+    }
+}
+
+// Every reader has its keypad interface half the list away from its CardIO one
+static allocation_counts_t group_synthetic(int* device_count) {
+    static char locations[SYNTHETIC_READERS][32];
+    static char cardio_paths[SYNTHETIC_READERS][32];
+    static char keypad_identifiers[SYNTHETIC_READERS][32];
+    static parsed_device_t parsed_devices[SYNTHETIC_READERS * 2];
+    for(int i = 0; i < SYNTHETIC_READERS; i++) {
+        snprintf(locations[i], sizeof(locations[i]), "usb-0000:00:14.0-%d", i);
+        snprintf(cardio_paths[i], sizeof(cardio_paths[i]), "/dev/hidraw%d", i * 2);
+        snprintf(keypad_identifiers[i], sizeof(keypad_identifiers[i]), "/sys/devices/hid-%d", i);
+        parsed_devices[i] = (parsed_device_t){.location = locations[i], .cardio_path = cardio_paths[i]};
+        parsed_devices[SYNTHETIC_READERS + i] = (parsed_device_t){.location = locations[i], .keypad_identifier = keypad_identifiers[i]};
+    }
+
+    const allocation_counts_t before = counts;
+    arena_t arena = {0};
+    device_t* devices = group_devices(&arena, parsed_devices, SYNTHETIC_READERS * 2, device_count);
+    arena_free(&arena);
+    free(devices);
+
+    return (allocation_counts_t){
+        .allocations = counts.allocations - before.allocations,
+        .bytes = counts.bytes - before.bytes,
+        .outstanding = counts.outstanding - before.outstanding,
+    };
+}
+
+int main(int argc, char** argv) {
+    const int enumerations = argc > 1 ? atoi(argv[1]) : 1000;
+    if(enumerations < 2) {
+        fprintf(stderr, "usage: eamio_enumeration_allocs [enumerations, at least 2]\n");
+        return EXIT_FAILURE;
+    }
+
+    int readers = 0;
+    uint64_t first_allocations = 0;
+    uint64_t first_bytes = 0;
+    bool steady = true;
+    const int64_t outstanding_before = counts.outstanding;
+    for(int i = 0; i < enumerations; i++) {
+        const allocation_counts_t before = counts;
+        device_t* devices = get_devices(VID, PID, CARDIO_MI, KEYPAD_MI, &readers);
+        free(devices);
+
+        const uint64_t allocations = counts.allocations - before.allocations;
+        const uint64_t bytes = counts.bytes - before.bytes;
+        if(i == 0) {
+            first_allocations = allocations;
+            first_bytes = bytes;
+        }
+        steady = steady && allocations == first_allocations && bytes == first_bytes;
+    }
+    const int64_t outstanding = counts.outstanding - outstanding_before;
+    check(steady, "every enumeration allocates the same");
+    check(outstanding == 0, "nothing is left allocated after the tables are freed");
+
+    int synthetic_devices = 0;
+    const allocation_counts_t synthetic = group_synthetic(&synthetic_devices);
+    check(synthetic_devices == SYNTHETIC_READERS, "the synthetic interfaces group into one device per reader");
+    check(synthetic.outstanding == 0, "nothing is left allocated after grouping");
+    // The table plus a few arena blocks, not one allocation per interface
+    check(synthetic.allocations < SYNTHETIC_READERS / 10, "grouping allocates per arena block, not per interface");
+
+    printf("{\n  \"benchmark\": \"enumeration_allocs\",\n  \"checks_failed\": %d,\n  \"enumerations\": %d,\n  \"readers\": %d,\n",
+        checks_failed, enumerations, readers);
+    printf("  \"allocations_per_enumeration\": %llu,\n  \"bytes_per_enumeration\": %llu,\n  \"outstanding_after\": %lld,\n",
+        (unsigned long long)first_allocations, (unsigned long long)first_bytes, (long long)outstanding);
+    printf("  \"synthetic_interfaces\": %d,\n  \"synthetic_allocations\": %llu,\n  \"synthetic_bytes\": %llu\n}\n",
+        SYNTHETIC_READERS * 2, (unsigned long long)synthetic.allocations, (unsigned long long)synthetic.bytes);
+
+    return checks_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
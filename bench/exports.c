@@ -0,0 +1,143 @@
+// Measures ns/call of the eam_io_* exports the game calls every frame, idle and while every
+// reader is publishing as fast as it can. Prints one JSON object to stdout.
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_ITERATIONS 2000000
+
+uint16_t eam_io_get_keypad_state(uint8_t unit_no);
+uint8_t eam_io_get_sensor_state(uint8_t unit_no);
+bool eam_io_poll(uint8_t unit_no);
+uint8_t eam_io_read_card(uint8_t unit_no, uint8_t* card_id, uint8_t nbytes);
+void eam_io_set_loggers(log_formatter_t misc, log_formatter_t info, log_formatter_t warning, log_formatter_t fatal);
+
+static _Atomic bool keypad_running = false;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+// Stands in for the keypad thread while readers produce
+static void* press_keys(void* param) {
+    bool pressed = false;
+    while(atomic_load(&keypad_running)) {
+        pressed = !pressed;
+        for(int i = 0; i < STUB_UNIT_COUNT; i++) {
+            update_keypad_state(i, 82, pressed);
+        }
+    }
+
+    return NULL;
+}
+
+typedef enum bench_export {
+    BENCH_GET_KEYPAD_STATE,
+    BENCH_GET_SENSOR_STATE,
+    BENCH_POLL,
+    BENCH_READ_CARD,
+    BENCH_EXPORT_COUNT,
+} bench_export_t;
+
+static const char* export_names[BENCH_EXPORT_COUNT] = {
+    "eam_io_get_keypad_state",
+    "eam_io_get_sensor_state",
+    "eam_io_poll",
+    "eam_io_read_card",
+};
+
+static void measure(const bench_export_t export, const bool producer, bool* first) {
+    volatile uint32_t sink = 0;
+    uint8_t card_id[8];
+
+    // One loop per export, so the dispatch isn't part of what is measured
+    const uint64_t start = clock_now_us();
+    switch(export) {
+        case BENCH_GET_KEYPAD_STATE:
+            for(int i = 0; i < BENCH_ITERATIONS; i++) {
+                sink += eam_io_get_keypad_state((uint8_t)(i % STUB_UNIT_COUNT));
+            }
+            break;
+        case BENCH_GET_SENSOR_STATE:
+            for(int i = 0; i < BENCH_ITERATIONS; i++) {
+                sink += eam_io_get_sensor_state((uint8_t)(i % STUB_UNIT_COUNT));
+            }
+            break;
+        case BENCH_POLL:
+            for(int i = 0; i < BENCH_ITERATIONS; i++) {
+                sink += eam_io_poll((uint8_t)(i % STUB_UNIT_COUNT));
+            }
+            break;
+        default:
+            for(int i = 0; i < BENCH_ITERATIONS; i++) {
+                sink += eam_io_read_card((uint8_t)(i % STUB_UNIT_COUNT), card_id, sizeof(card_id));
+            }
+            break;
+    }
+    const double ns_per_call = (double)(clock_now_us() - start) * 1000.0 / BENCH_ITERATIONS;
+
+    printf("%s\n    {\"export\": \"%s\", \"producer\": %s, \"ns_per_call\": %.2f}", *first ? "" : ",", export_names[export], producer ? "true" : "false", ns_per_call);
+    *first = false;
+}
+
+int main() {
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+
+    // Queue overflow warnings would otherwise dominate the producer runs
+    log_runtime_level = LOG_LEVEL_ERROR;
+    log_start(NULL);
+
+    static aic_config_t config = {
+        .presence = {
+            .min_presence_us = 0,
+            .hold_us = 0,
+            .cooldown_us = 0,
+            .retap_extends = true,
+        },
+        .single_thread_io = false,
+    };
+    const int init_thread = create_thread(run_init, &config, 0x4000, 0);
+    while(get_unit_count() == 0) {
+        clock_sleep_ms(1);
+    }
+
+    bool first = true;
+    printf("{\n  \"benchmark\": \"eam_io_exports\",\n  \"units\": %d,\n  \"iterations\": %d,\n  \"results\": [", STUB_UNIT_COUNT, BENCH_ITERATIONS);
+
+    for(int i = 0; i < BENCH_EXPORT_COUNT; i++) {
+        measure((bench_export_t)i, false, &first);
+    }
+
+    pthread_t keypad_thread;
+    atomic_store(&keypad_running, true);
+    pthread_create(&keypad_thread, NULL, press_keys, NULL);
+    atomic_store(&stub_producing, true);
+
+    const uint64_t reports_before = atomic_load(&stub_reports);
+    const uint64_t producer_start = clock_now_us();
+    for(int i = 0; i < BENCH_EXPORT_COUNT; i++) {
+        measure((bench_export_t)i, true, &first);
+    }
+    const uint64_t producer_us = clock_now_us() - producer_start;
+    const uint64_t reports = atomic_load(&stub_reports) - reports_before;
+
+    atomic_store(&stub_producing, false);
+    atomic_store(&keypad_running, false);
+    pthread_join(keypad_thread, NULL);
+
+    printf("\n  ],\n  \"producer_reports_per_second\": %.0f\n}\n", producer_us == 0 ? 0.0 : (double)reports * 1000000.0 / (double)producer_us);
+
+    request_stop();
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    fini();
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,50 @@
+// libFuzzer target for the report parser. Each input is tried as a report descriptor, and as a report
+// against both the standard CardIO parser and the parser that descriptor sets up.
+// Seeds are in bench/corpus/report_parser.
+#include "../src/report_parser.h"
+#include "../src/reader_state.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static void check_decode(const report_parser_t* parser, const uint8_t* data, const uint32_t length) {
+    card_record_t card;
+    const report_result_t result = report_parser_decode(parser, data, length, &card);
+
+    // A card always points at a whole ID inside the report
+    if(result == REPORT_CARD && (card.id != data + 1 || length < 1 + CARD_ID_SIZE || card.type == CARD_TYPE_NONE)) {
+        abort();
+    }
+    if(result != REPORT_CARD && (card.id != NULL || card.type != CARD_TYPE_NONE)) {
+        abort();
+    }
+    // Report ID 0 is reserved
+    if(length > 0 && data[0] == 0 && result != REPORT_MALFORMED) {
+        abort();
+    }
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t* data, const size_t size) {
+    report_parser_t parser;
+    report_parser_init_cardio(&parser);
+    check_decode(&parser, data, (uint32_t)size);
+
+    report_layout_t layout;
+    if(report_descriptor_parse(data, size, &layout)) {
+        if(layout.input_count <= 0 || layout.input_count > REPORT_MAX_INPUTS) {
+            abort();
+        }
+        if(report_parser_init(&parser, &layout)) {
+            // Every declared report fits one read, none wrapped to undeclared
+            for(int i = 0; i < layout.input_count; i++) {
+                const uint16_t length = parser.reports[layout.inputs[i].id].length;
+                if(length == 0 || length > READER_REPORT_SIZE) {
+                    abort();
+                }
+            }
+            check_decode(&parser, data, (uint32_t)size);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,93 @@
+// Measures ns/interface of group_devices() for 10, 1k and 100k enumerated interfaces, two per reader,
+// with every reader's keypad interface turning up far from its CardIO one. Prints one JSON object and
+// exits non-zero when a size doesn't group into one complete device per reader.
+#include "../src/device_group.h"
+#include "../src/clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Interfaces grouped per size, repeated until roughly this many
+#define BENCH_INTERFACES 4000000
+
+static const int interface_counts[] = {10, 1000, 100000};
+
+// Readers' CardIO interfaces in order, then their keypad interfaces back to front
+static parsed_device_t* make_interfaces(arena_t* arena, const int interface_count) {
+    const int reader_count = interface_count / 2;
+    parsed_device_t* parsed_devices = arena_alloc(arena, interface_count * sizeof(parsed_device_t));
+
+    for(int i = 0; i < reader_count; i++) {
+        char location[DEVICE_LOCATION_SIZE];
+        char path[DEVICE_PATH_SIZE];
+
+        const int location_length = snprintf(location, sizeof(location), "usb-0000:00:14.0-%d.%d", i / 127 + 1, i % 127 + 1);
+        const char* shared_location = arena_copy(arena, location, location_length + 1);
+
+        parsed_device_t* cardio = &parsed_devices[i];
+        cardio->location = shared_location;
+        const int cardio_length = snprintf(path, sizeof(path), "/dev/hidraw%d", i * 2);
+        cardio->cardio_path = arena_copy(arena, path, cardio_length + 1);
+
+        // Locations of the same reader are equal strings, not the same pointer
+        parsed_device_t* keypad = &parsed_devices[interface_count - 1 - i];
+        keypad->location = arena_copy(arena, location, location_length + 1);
+        const int keypad_length = snprintf(path, sizeof(path), "/sys/devices/virtual/misc/uhid/0003:CAFF:400E.%04X", i * 2 + 1);
+        keypad->keypad_identifier = arena_copy(arena, path, keypad_length + 1);
+    }
+
+    return parsed_devices;
+}
+
+static bool check_devices(const device_t* devices, const int device_count, const int interface_count) {
+    if(devices == NULL || device_count != interface_count / 2) {
+        return false;
+    }
+
+    for(int i = 0; i < device_count; i++) {
+        if(devices[i].cardio_path[0] == '\0' || devices[i].keypad_identifier[0] == '\0') {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main() {
+    bool passed = true;
+
+    printf("{\n  \"benchmark\": \"device_grouping\",\n  \"results\": [");
+
+    for(size_t c = 0; c < sizeof(interface_counts) / sizeof(interface_counts[0]); c++) {
+        const int interface_count = interface_counts[c];
+        const int iterations = BENCH_INTERFACES / interface_count;
+
+        arena_t input_arena = {0};
+        const parsed_device_t* parsed_devices = make_interfaces(&input_arena, interface_count);
+
+        // Each run gets a fresh scratch arena the way an enumeration does
+        uint64_t total_us = 0;
+        bool grouped = true;
+        for(int i = 0; i < iterations; i++) {
+            arena_t arena = {0};
+            int device_count;
+
+            const uint64_t start = clock_now_us();
+            device_t* devices = group_devices(&arena, parsed_devices, interface_count, &device_count);
+            arena_free(&arena);
+            total_us += clock_now_us() - start;
+
+            grouped = grouped && check_devices(devices, device_count, interface_count);
+            free(devices);
+        }
+        arena_free(&input_arena);
+        passed = passed && grouped;
+
+        printf("%s\n    {\"interfaces\": %d, \"iterations\": %d, \"ns_per_interface\": %.2f, \"grouped\": %s}", c == 0 ? "" : ",",
+            interface_count, iterations, (double)total_us * 1000.0 / ((double)iterations * interface_count), grouped ? "true" : "false");
+    }
+
+    printf("\n  ]\n}\n");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,201 @@
+// Unit test and benchmark for the raw-input handle cache. The test checks hits, misses, updates, the
+// reserved handle and refilling after the cache drops itself, then runs random inserts and clears against
+// a plain table and fails if a lookup ever returns a wrong unit. The benchmark replays a stream of key
+// events where most come from keyboards that aren't keypads, resolving each one the way the raw-input
+// path does, through the cache and the old way (name copy and strstr() per event). Prints one JSON object
+// and exits non-zero when a check fails.
+#include "../src/handle_cache.h"
+#include "../src/clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MODEL_HANDLES 200
+#define MODEL_STEPS 1000000
+#define BENCH_EVENTS 10000000
+// WM_INPUT_DEVICE_CHANGE clears the cache, as often as a busy machine might plug something in
+#define BENCH_CHANGE_EVERY 100000
+#define BENCH_DEVICES 12
+#define BENCH_KEYPADS 2
+
+typedef struct bench_device {
+    uintptr_t handle;
+    char name[128];
+} bench_device_t;
+
+static int checks_failed = 0;
+
+static void check(const bool passed, const char* what) {
+    if(!passed) {
+        fprintf(stderr, "Failed: %s\n", what);
+        checks_failed++;
+    }
+}
+
+// Raw-input handles are pointer-like, so they are spaced the same way here
+static uintptr_t make_handle(const int i) {
+    return 0x10000 + (uintptr_t)i * 0x10;
+}
+
+static bool lookup_is(const handle_cache_t* cache, const uintptr_t handle, const int expected) {
+    int unit = 12345;
+    return handle_cache_lookup(cache, handle, &unit) && unit == expected;
+}
+
+static bool misses(const handle_cache_t* cache, const uintptr_t handle) {
+    int unit;
+    return !handle_cache_lookup(cache, handle, &unit);
+}
+
+static void run_unit_checks() {
+    handle_cache_t cache;
+    handle_cache_clear(&cache);
+
+    check(misses(&cache, make_handle(1)), "empty cache misses");
+
+    handle_cache_insert(&cache, make_handle(1), 0);
+    handle_cache_insert(&cache, make_handle(2), 1);
+    handle_cache_insert(&cache, make_handle(3), HANDLE_CACHE_NO_UNIT);
+    check(lookup_is(&cache, make_handle(1), 0), "first unit hits");
+    check(lookup_is(&cache, make_handle(2), 1), "second unit hits");
+    check(lookup_is(&cache, make_handle(3), HANDLE_CACHE_NO_UNIT), "unrelated device is cached as no unit");
+    check(misses(&cache, make_handle(4)), "unknown handle misses");
+
+    handle_cache_insert(&cache, make_handle(2), 0);
+    check(lookup_is(&cache, make_handle(2), 0) && cache.count == 3, "inserting a known handle updates it in place");
+
+    handle_cache_insert(&cache, 0, 1);
+    check(misses(&cache, 0) && cache.count == 3, "handle 0 is never stored");
+
+    handle_cache_clear(&cache);
+    check(misses(&cache, make_handle(1)) && misses(&cache, make_handle(2)) && cache.count == 0, "clear forgets every handle");
+
+    // Up to the fill limit everything stays, the next new handle starts over
+    int kept = 0;
+    while(cache.count < HANDLE_CACHE_SIZE * 3 / 4) {
+        handle_cache_insert(&cache, make_handle(100 + kept), kept % 4);
+        kept++;
+    }
+    bool all_found = true;
+    for(int i = 0; i < kept; i++) {
+        all_found = all_found && lookup_is(&cache, make_handle(100 + i), i % 4);
+    }
+    check(all_found, "a full cache finds every handle");
+
+    handle_cache_insert(&cache, make_handle(1000), 2);
+    check(cache.count == 1 && lookup_is(&cache, make_handle(1000), 2) && misses(&cache, make_handle(100)), "a full cache drops itself and keeps the new handle");
+}
+
+// Random inserts and clears against a plain table: a miss is always allowed, a wrong unit never
+static void run_model_check() {
+    handle_cache_t cache;
+    handle_cache_clear(&cache);
+    int units[MODEL_HANDLES];
+    for(int i = 0; i < MODEL_HANDLES; i++) {
+        units[i] = HANDLE_CACHE_NO_UNIT - 1;
+    }
+
+    srand(7);
+    int wrong = 0;
+    for(int step = 0; step < MODEL_STEPS; step++) {
+        const int i = rand() % MODEL_HANDLES;
+        const int action = rand() % 100;
+
+        if(action == 0) {
+            handle_cache_clear(&cache);
+        }
+        else if(action < 30) {
+            units[i] = rand() % 5 - 1;
+            handle_cache_insert(&cache, make_handle(i), units[i]);
+        }
+        else {
+            int unit;
+            if(handle_cache_lookup(&cache, make_handle(i), &unit) && unit != units[i]) {
+                wrong++;
+            }
+        }
+    }
+
+    check(wrong == 0, "random lookups never return a wrong unit");
+}
+
+static bench_device_t devices[BENCH_DEVICES];
+static const char* keypad_identifiers[BENCH_KEYPADS] = {"7&2f1a3b4c&0&0001", "7&3e5d6f70&0&0001"};
+
+// The lookup done for every key before the cache: copy the device name out, then search it for each keypad
+static int resolve_uncached(const bench_device_t* device) {
+    char* name = malloc(sizeof(device->name));
+    memcpy(name, device->name, sizeof(device->name));
+
+    int unit = HANDLE_CACHE_NO_UNIT;
+    for(int i = 0; i < BENCH_KEYPADS; i++) {
+        if(strstr(name, keypad_identifiers[i]) != NULL) {
+            unit = i;
+        }
+    }
+
+    free(name);
+    return unit;
+}
+
+static int resolve_cached(handle_cache_t* cache, const bench_device_t* device) {
+    int unit;
+    if(handle_cache_lookup(cache, device->handle, &unit)) {
+        return unit;
+    }
+
+    unit = resolve_uncached(device);
+    handle_cache_insert(cache, device->handle, unit);
+    return unit;
+}
+
+int main() {
+    run_unit_checks();
+    run_model_check();
+
+    for(int i = 0; i < BENCH_DEVICES; i++) {
+        devices[i].handle = make_handle(5000 + i * 7);
+        if(i < BENCH_KEYPADS) {
+            snprintf(devices[i].name, sizeof(devices[i].name), "\\\\?\\HID#VID_0CAF&PID_420D&MI_01#%s#{884b96c3-56ef-11d1-bc8c-00a0c91405dd}", keypad_identifiers[i]);
+        }
+        else {
+            snprintf(devices[i].name, sizeof(devices[i].name), "\\\\?\\HID#VID_046D&PID_C5%02X&MI_00#7&1a2b3c%02x&0&0000#{884b96c3-56ef-11d1-bc8c-00a0c91405dd}", i, i);
+        }
+    }
+
+    // Nine events in ten come from the unrelated keyboards
+    static uint8_t stream[4096];
+    srand(3);
+    for(int i = 0; i < (int)sizeof(stream); i++) {
+        stream[i] = rand() % 10 == 0 ? rand() % BENCH_KEYPADS : BENCH_KEYPADS + rand() % (BENCH_DEVICES - BENCH_KEYPADS);
+    }
+
+    uint64_t keypad_events = 0;
+    uint64_t start = clock_now_us();
+    for(int i = 0; i < BENCH_EVENTS; i++) {
+        keypad_events += resolve_uncached(&devices[stream[i & 4095]]) != HANDLE_CACHE_NO_UNIT;
+    }
+    const uint64_t uncached_us = clock_now_us() - start;
+
+    handle_cache_t cache;
+    handle_cache_clear(&cache);
+    uint64_t cached_keypad_events = 0;
+    start = clock_now_us();
+    for(int i = 0; i < BENCH_EVENTS; i++) {
+        if(i % BENCH_CHANGE_EVERY == 0) {
+            handle_cache_clear(&cache);
+        }
+        cached_keypad_events += resolve_cached(&cache, &devices[stream[i & 4095]]) != HANDLE_CACHE_NO_UNIT;
+    }
+    const uint64_t cached_us = clock_now_us() - start;
+    check(cached_keypad_events == keypad_events, "the cache resolves the same events to keypads");
+
+    printf("{\n  \"benchmark\": \"handle_cache\",\n  \"checks_failed\": %d,\n  \"events\": %d,\n  \"devices\": %d,\n  \"keypad_events\": %llu,\n",
+        checks_failed, BENCH_EVENTS, BENCH_DEVICES, (unsigned long long)keypad_events);
+    printf("  \"uncached_ns_per_event\": %.2f,\n  \"cached_ns_per_event\": %.2f,\n  \"cached_events_per_s\": %.0f\n}\n",
+        (double)uncached_us * 1000.0 / BENCH_EVENTS, (double)cached_us * 1000.0 / BENCH_EVENTS,
+        cached_us > 0 ? BENCH_EVENTS * 1e6 / (double)cached_us : 0.0);
+
+    return checks_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,209 @@
+// Times how long a reader takes to come back after it was unplugged, against two virtual AIC Picos (see
+// uhid_reader.h) and the real Linux platform layer. Each cycle unplugs the first reader, leaves it out for
+// a while and plugs it back in, then taps new cards and presses KP1 on it until eam_io_poll() shows them.
+// Recovery is timed from the plug until the tap and the press come through. The second reader is tapped
+// throughout and has to keep working, hotplug must not touch the other units. Prints one JSON object and
+// exits non-zero when a reader doesn't recover or the other one stops answering. Needs write access to
+// /dev/uhid.
+//
+//   eamio_hotplug_recovery [cycles] [down_ms] [thread|loop]
+#include "bench_thread.h"
+#include "samples.h"
+#include "uhid_reader.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define REPLUG_PHYS "eamio-hotplug-replugged"
+#define OTHER_PHYS "eamio-hotplug-other"
+#define RECOVERY_TIMEOUT_US 5000000
+// How long one tap or press is given to show up before it is sent again
+#define ATTEMPT_TIMEOUT_US 20000
+#define MAX_CYCLES 1000
+
+typedef struct recovery {
+    uint64_t card[MAX_CYCLES];
+    uint64_t keypad[MAX_CYCLES];
+    uint64_t other[MAX_CYCLES * 4];
+    int card_count;
+    int keypad_count;
+    int other_count;
+    int failed;
+    int other_missed;
+} recovery_t;
+
+static recovery_t recovery;
+static uint32_t serial = 0;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+static int find_unit(const char* phys) {
+    for(int i = 0; i < get_unit_count(); i++) {
+        if(strcmp(devices[i].location, phys) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+// Taps a card nobody has seen yet and polls until the unit shows it, false after timeout_us
+static bool tap(const uhid_reader_t* reader, const int unit, const uint64_t timeout_us) {
+    uint8_t id[CARD_ID_SIZE] = {0xE0, 0x04};
+    serial++;
+    memcpy(id + 4, &serial, sizeof(serial));
+    if(!uhid_reader_send_card(reader, CARD_TYPE_ISO15693, id)) {
+        return false;
+    }
+
+    const uint64_t sent = clock_now_us();
+    uint8_t card[CARD_ID_SIZE];
+    while(clock_now_us() - sent < timeout_us) {
+        eam_io_poll(unit);
+        if(eam_io_read_card(unit, card, sizeof(card)) != 0 && memcmp(card, id, CARD_ID_SIZE) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool press(const uhid_reader_t* reader, const int unit, const uint64_t timeout_us) {
+    if(!uhid_reader_send_keys(reader, UHID_READER_USAGE_KP1)) {
+        return false;
+    }
+
+    bool seen = false;
+    const uint64_t sent = clock_now_us();
+    while(!seen && clock_now_us() - sent < timeout_us) {
+        eam_io_poll(unit);
+        seen = (eam_io_get_keypad_state(unit) >> EAM_IO_KEYPAD_1) & 1;
+    }
+
+    uhid_reader_send_keys(reader, 0);
+    return seen;
+}
+
+// Keeps the other reader busy while the first one is away
+static void tap_other(const uhid_reader_t* other, const int other_unit) {
+    const uint64_t start = clock_now_us();
+    if(tap(other, other_unit, ATTEMPT_TIMEOUT_US * 5)) {
+        if(recovery.other_count < MAX_CYCLES * 4) {
+            recovery.other[recovery.other_count++] = clock_now_us() - start;
+        }
+    }
+    else {
+        recovery.other_missed++;
+    }
+}
+
+// Retries until the tap and the press both came through on the replugged reader
+static void recover(uhid_reader_t* reader, const int unit, const uhid_reader_t* other, const int other_unit, const uint64_t plugged) {
+    bool card = false;
+    bool keypad = false;
+    while((!card || !keypad) && clock_now_us() - plugged < RECOVERY_TIMEOUT_US) {
+        if(!card && tap(reader, unit, ATTEMPT_TIMEOUT_US)) {
+            card = true;
+            recovery.card[recovery.card_count++] = clock_now_us() - plugged;
+        }
+        if(!keypad && press(reader, unit, ATTEMPT_TIMEOUT_US)) {
+            keypad = true;
+            recovery.keypad[recovery.keypad_count++] = clock_now_us() - plugged;
+        }
+        tap_other(other, other_unit);
+    }
+
+    if(!card || !keypad) {
+        recovery.failed++;
+    }
+}
+
+int main(int argc, char** argv) {
+    const int cycles = argc > 1 ? atoi(argv[1]) : 20;
+    const int down_ms = argc > 2 ? atoi(argv[2]) : 100;
+    const bool loop = argc > 3 && strcmp(argv[3], "loop") == 0;
+    if(cycles < 1 || cycles > MAX_CYCLES || down_ms < 0) {
+        fprintf(stderr, "usage: eamio_hotplug_recovery [cycles, 1-%d] [down_ms] [thread|loop]\n", MAX_CYCLES);
+        return EXIT_FAILURE;
+    }
+
+    uhid_reader_t reader;
+    uhid_reader_t other;
+    if(!uhid_reader_create(&reader, REPLUG_PHYS) || !uhid_reader_create(&other, OTHER_PHYS)) {
+        fprintf(stderr, "Failed to create uhid devices, is /dev/uhid writable?\n");
+        return EXIT_FAILURE;
+    }
+
+    // udev needs a moment to create the nodes
+    clock_sleep_ms(500);
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_start(NULL);
+
+    // Cards stay until replaced, so every tap is published on arrival
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 60000000,
+        },
+        .single_thread_io = loop,
+    };
+    const int init_thread = create_thread(run_init, (void*)&config, 0x4000, 0);
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+
+    const int unit = find_unit(REPLUG_PHYS);
+    const int other_unit = find_unit(OTHER_PHYS);
+    bool found = unit >= 0 && other_unit >= 0;
+    if(!found) {
+        fprintf(stderr, "The virtual readers were not found\n");
+    }
+
+    // Both readers answer before anything is unplugged
+    if(found && (!tap(&reader, unit, RECOVERY_TIMEOUT_US) || !tap(&other, other_unit, RECOVERY_TIMEOUT_US))) {
+        fprintf(stderr, "The virtual readers don't answer\n");
+        found = false;
+    }
+
+    for(int i = 0; i < cycles && found; i++) {
+        uhid_reader_destroy(&reader);
+        const uint64_t unplugged = clock_now_us();
+        while(clock_now_us() - unplugged < (uint64_t)down_ms * 1000) {
+            tap_other(&other, other_unit);
+        }
+
+        if(!uhid_reader_create(&reader, REPLUG_PHYS)) {
+            fprintf(stderr, "Failed to plug the reader back in\n");
+            found = false;
+            break;
+        }
+        recover(&reader, unit, &other, other_unit, clock_now_us());
+    }
+
+    printf("{\n  \"benchmark\": \"hotplug_recovery\",\n  \"io\": \"%s\",\n  \"cycles\": %d,\n  \"down_ms\": %d,\n  \"not_recovered\": %d,\n",
+        loop ? "loop" : "thread", cycles, down_ms, recovery.failed);
+    printf("  ");
+    samples_print("plug_to_card", "us", recovery.card, recovery.card_count);
+    printf(",\n  ");
+    samples_print("plug_to_keypad", "us", recovery.keypad, recovery.keypad_count);
+    printf(",\n  \"other_reader_missed\": %d,\n  ", recovery.other_missed);
+    samples_print("other_reader_tap", "us", recovery.other, recovery.other_count);
+    printf("\n}\n");
+
+    request_stop();
+    fini();
+    uhid_reader_destroy(&reader);
+    uhid_reader_destroy(&other);
+    log_stop();
+
+    return found && recovery.failed == 0 && recovery.other_missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,231 @@
+// Compares the thread-per-reader model with single_thread_io on the real Linux I/O code (poll() per reader
+// thread against one epoll/timerfd loop). Every reader's CardIO path is a FIFO the bench writes
+// CardIO reports into, so no hardware or uhid is needed. For each model it counts the library's threads,
+// how often they wake while idle and per tap, and times taps from the write until eam_io_read_card()
+// returns the ID after an eam_io_poll(). Prints one JSON object and exits non-zero when a tap never shows up.
+//
+//   eamio_bench_io_models [readers] [taps]
+#include "bench_thread.h"
+#include "samples.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define MAX_READERS 16
+#define MAX_TAPS 100000
+#define TAP_TIMEOUT_US 100000
+#define IDLE_MS 1000
+// ISO15693 report ID the CardIO parser assumes when the FIFO has no descriptor to read
+#define REPORT_ISO15693 1
+
+typedef struct model {
+    const char* name;
+    bool single_thread_io;
+    int threads;
+    uint64_t idle_wakeups;
+    uint64_t tap_wakeups;
+    int missed;
+    uint64_t samples[MAX_TAPS];
+    int sample_count;
+} model_t;
+
+static model_t models[] = {
+    {.name = "thread_per_reader", .single_thread_io = false},
+    {.name = "single_loop", .single_thread_io = true},
+};
+
+static int writers[MAX_READERS];
+static uint32_t serial = 0;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+// Context switches of every thread but the main one (whose ID is the process ID), each is a wakeup of a library thread
+static uint64_t library_wakeups() {
+    DIR* tasks = opendir("/proc/self/task");
+    if(tasks == NULL) {
+        return 0;
+    }
+
+    uint64_t wakeups = 0;
+    const struct dirent* entry;
+    while((entry = readdir(tasks)) != NULL) {
+        if(entry->d_name[0] == '.' || atoi(entry->d_name) == getpid()) {
+            continue;
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "/proc/self/task/%s/status", entry->d_name);
+        FILE* file = fopen(path, "r");
+        if(file == NULL) {
+            continue;
+        }
+
+        char line[128];
+        unsigned long long switches;
+        while(fgets(line, sizeof(line), file) != NULL) {
+            if(sscanf(line, "voluntary_ctxt_switches: %llu", &switches) == 1 || sscanf(line, "nonvoluntary_ctxt_switches: %llu", &switches) == 1) {
+                wakeups += switches;
+            }
+        }
+        fclose(file);
+    }
+    closedir(tasks);
+
+    return wakeups;
+}
+
+static int count_threads() {
+    DIR* tasks = opendir("/proc/self/task");
+    if(tasks == NULL) {
+        return -1;
+    }
+
+    int count = 0;
+    while(readdir(tasks) != NULL) {
+        count++;
+    }
+    closedir(tasks);
+
+    // ., .. and the main thread
+    return count - 3;
+}
+
+// Writes a new card to the reader and polls back to back until the game would see it
+static uint64_t tap(const int unit) {
+    uint8_t report[1 + CARD_ID_SIZE] = {REPORT_ISO15693, 0xE0, 0x04};
+    serial++;
+    memcpy(report + 5, &serial, sizeof(serial));
+
+    const uint64_t sent = clock_now_us();
+    if(write(writers[unit], report, sizeof(report)) != sizeof(report)) {
+        return UINT64_MAX;
+    }
+
+    uint8_t card[CARD_ID_SIZE];
+    while(clock_now_us() - sent < TAP_TIMEOUT_US) {
+        eam_io_poll(unit);
+        if(eam_io_read_card(unit, card, sizeof(card)) != 0 && memcmp(card, report + 1, CARD_ID_SIZE) == 0) {
+            return clock_now_us() - sent;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+static bool run_model(model_t* model, const int readers, const int taps) {
+    // Cards stay until replaced, so every tap is published on arrival
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 60000000,
+        },
+        .single_thread_io = model->single_thread_io,
+    };
+    const int init_thread = create_thread(run_init, (void*)&config, 0x4000, 0);
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+
+    if(get_unit_count() != readers) {
+        fini();
+        return false;
+    }
+
+    // Also waits for every reader to have its FIFO open
+    for(int i = 0; i < readers; i++) {
+        if(tap(i) == UINT64_MAX) {
+            model->missed++;
+        }
+    }
+    model->threads = count_threads();
+
+    uint64_t wakeups = library_wakeups();
+    clock_sleep_ms(IDLE_MS);
+    model->idle_wakeups = library_wakeups() - wakeups;
+
+    wakeups = library_wakeups();
+    for(int i = 0; i < taps; i++) {
+        const uint64_t latency = tap(i % readers);
+        if(latency == UINT64_MAX) {
+            model->missed++;
+        }
+        else {
+            model->samples[model->sample_count++] = latency;
+        }
+    }
+    model->tap_wakeups = library_wakeups() - wakeups;
+
+    request_stop();
+    fini();
+    return true;
+}
+
+int main(int argc, char** argv) {
+    const int readers = argc > 1 ? atoi(argv[1]) : 4;
+    const int taps = argc > 2 ? atoi(argv[2]) : 5000;
+    if(readers < 1 || readers > MAX_READERS || taps < 1 || taps > MAX_TAPS) {
+        fprintf(stderr, "usage: eamio_bench_io_models [readers, 1-%d] [taps, 1-%d]\n", MAX_READERS, MAX_TAPS);
+        return EXIT_FAILURE;
+    }
+
+    char directory[] = "/tmp/eamio-io-models-XXXXXX";
+    if(mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Failed to create a directory for the FIFOs\n");
+        return EXIT_FAILURE;
+    }
+
+    // Held open for both ends, so reports written before a reader opens its FIFO wait there
+    char path_format[sizeof(directory) + 16];
+    snprintf(path_format, sizeof(path_format), "%s/reader-%%d", directory);
+    for(int i = 0; i < readers; i++) {
+        char path[sizeof(path_format) + 8];
+        snprintf(path, sizeof(path), path_format, i);
+        if(mkfifo(path, 0600) != 0 || (writers[i] = open(path, O_RDWR | O_NONBLOCK)) < 0) {
+            fprintf(stderr, "Failed to create %s\n", path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    stub_device_count = readers;
+    stub_cardio_path_format = path_format;
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    // The log drain thread is left out, it wakes on a timer of its own whichever model runs
+    bench_use_threads();
+
+    bool passed = true;
+    printf("{\n  \"benchmark\": \"io_models\",\n  \"readers\": %d,\n  \"taps\": %d,\n  \"models\": [", readers, taps);
+    for(size_t m = 0; m < sizeof(models) / sizeof(models[0]); m++) {
+        model_t* model = &models[m];
+        const bool ran = run_model(model, readers, taps);
+        passed = passed && ran && model->missed == 0;
+
+        printf("%s\n    {\"model\": \"%s\", \"ran\": %s, \"threads\": %d, \"idle_wakeups_per_s\": %.1f, \"wakeups_per_tap\": %.2f, \"missed\": %d, ",
+            m == 0 ? "" : ",", model->name, ran ? "true" : "false", model->threads, model->idle_wakeups * 1000.0 / IDLE_MS,
+            (double)model->tap_wakeups / taps, model->missed);
+        samples_print("tap_latency", "us", model->samples, model->sample_count);
+        printf("}");
+    }
+    printf("\n  ]\n}\n");
+
+    for(int i = 0; i < readers; i++) {
+        char path[sizeof(path_format) + 8];
+        snprintf(path, sizeof(path), path_format, i);
+        close(writers[i]);
+        unlink(path);
+    }
+    rmdir(directory);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,174 @@
+// Maps every possible key code through the keymap tables and through the switch statements they replaced,
+// and fails on the first code the two disagree on. Also checks every table maps one code to each keypad
+// bit, and times a lookup in both. Prints one JSON object and exits non-zero when a check fails.
+#include "../src/keymap.h"
+#include "../src/clock.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <linux/input-event-codes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_ITERATIONS 100000000
+#define CODE_COUNT 65536
+
+static const char* const keymap_names[] = {"aic", "aic_numlock", "hid", "evdev"};
+
+// update_keypad_state() before the tables, raw-input VKeys with numlock off
+static int old_switch(const uint16_t key) {
+    uint8_t bitmap_index = 0;
+
+    switch(key) {
+        case 45:
+            bitmap_index = 0;
+        break;
+        case 109:
+            bitmap_index = 8;
+        break;
+        case 46:
+            bitmap_index = 4;
+        break;
+        case 35:
+            bitmap_index = 1;
+        break;
+        case 40:
+            bitmap_index = 5;
+        break;
+        case 34:
+            bitmap_index = 9;
+        break;
+        case 37:
+            bitmap_index = 2;
+        break;
+        case 12:
+            bitmap_index = 6;
+        break;
+        case 39:
+            bitmap_index = 10;
+        break;
+        case 36:
+            bitmap_index = 3;
+        break;
+        case 38:
+            bitmap_index = 7;
+        break;
+        case 33:
+            bitmap_index = 11;
+        break;
+        default:
+            return -1;
+    }
+
+    return bitmap_index;
+}
+
+// What the evdev backend translated event codes to before handing them to old_switch()
+static uint16_t old_evdev_to_vkey(const uint16_t code) {
+    switch(code) {
+        case KEY_KP0: return 45;
+        case KEY_KP1: return 35;
+        case KEY_KP2: return 40;
+        case KEY_KP3: return 34;
+        case KEY_KP4: return 37;
+        case KEY_KP5: return 12;
+        case KEY_KP6: return 39;
+        case KEY_KP7: return 36;
+        case KEY_KP8: return 38;
+        case KEY_KP9: return 33;
+        case KEY_KPDOT: return 46;
+        case KEY_KPMINUS: return 109;
+        default: return 0;
+    }
+}
+
+static int old_evdev(const uint16_t code) {
+    const uint16_t vkey = old_evdev_to_vkey(code);
+    return vkey == 0 ? -1 : old_switch(vkey);
+}
+
+// Every code, not only the ones below KEYMAP_SIZE, so the bounds check is covered too
+static int compare(const keymap_t* keymap, int (*old)(uint16_t)) {
+    int mismatches = 0;
+    for(int code = 0; code < CODE_COUNT; code++) {
+        const int expected = old(code);
+        const int mapped = keymap_lookup(keymap, code);
+        if(mapped != expected) {
+            if(mismatches == 0) {
+                fprintf(stderr, "%s: code %d maps to %d, the old switch to %d\n", keymap->name, code, mapped, expected);
+            }
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+// Exactly one code per keypad bit
+static bool covers_keypad(const keymap_t* keymap) {
+    int codes_per_bit[EAM_IO_KEYPAD_COUNT] = {0};
+    for(int code = 0; code < CODE_COUNT; code++) {
+        const int bit = keymap_lookup(keymap, code);
+        if(bit >= EAM_IO_KEYPAD_COUNT) {
+            return false;
+        }
+        if(bit >= 0) {
+            codes_per_bit[bit]++;
+        }
+    }
+
+    for(int bit = 0; bit < EAM_IO_KEYPAD_COUNT; bit++) {
+        if(codes_per_bit[bit] != 1) {
+            fprintf(stderr, "%s: %d codes map to keypad bit %d\n", keymap->name, codes_per_bit[bit], bit);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// A key event stream where a third of the codes are keypad keys, the rest other keys on the same device
+static uint16_t codes[1024];
+
+static double time_lookups(const keymap_t* keymap, int (*old)(uint16_t), uint64_t* checksum) {
+    const uint64_t start = clock_now_us();
+    for(int i = 0; i < BENCH_ITERATIONS; i++) {
+        const uint16_t code = codes[i & 1023];
+        *checksum += keymap != NULL ? keymap_lookup(keymap, code) : old(code);
+        __asm__ volatile("" : "+r"(*checksum));
+    }
+
+    return (double)(clock_now_us() - start) * 1000.0 / BENCH_ITERATIONS;
+}
+
+int main() {
+    bool passed = true;
+
+    const keymap_t* aic = keymap_find("aic");
+    const keymap_t* evdev = keymap_find("evdev");
+    const int aic_mismatches = aic != NULL ? compare(aic, old_switch) : -1;
+    const int evdev_mismatches = evdev != NULL ? compare(evdev, old_evdev) : -1;
+    passed = aic_mismatches == 0 && evdev_mismatches == 0;
+
+    printf("{\n  \"benchmark\": \"keymap\",\n  \"codes_checked\": %d,\n", CODE_COUNT);
+    printf("  \"aic_mismatches\": %d,\n  \"evdev_mismatches\": %d,\n  \"tables\": [", aic_mismatches, evdev_mismatches);
+    for(size_t i = 0; i < sizeof(keymap_names) / sizeof(keymap_names[0]); i++) {
+        const keymap_t* keymap = keymap_find(keymap_names[i]);
+        const bool covered = keymap != NULL && covers_keypad(keymap);
+        passed = passed && covered;
+        printf("%s\n    {\"keymap\": \"%s\", \"one_code_per_key\": %s}", i == 0 ? "" : ",", keymap_names[i], covered ? "true" : "false");
+    }
+
+    srand(1);
+    for(int i = 0; i < 1024; i++) {
+        codes[i] = i % 3 == 0 ? (uint16_t)(33 + rand() % 14) : (uint16_t)(rand() % 256);
+    }
+
+    uint64_t checksum = 0;
+    const double switch_ns = time_lookups(NULL, old_switch, &checksum);
+    const double table_ns = time_lookups(aic, NULL, &checksum);
+    printf("\n  ],\n  \"switch_ns_per_lookup\": %.2f,\n  \"table_ns_per_lookup\": %.2f,\n  \"checksum\": %llu\n}\n",
+        switch_ns, table_ns, (unsigned long long)checksum);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
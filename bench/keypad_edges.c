@@ -0,0 +1,165 @@
+// Types digits at a fixed rate with presses shorter than a frame, polls like a game at a fixed frame rate,
+// and checks that every press shows up as its own rising edge, in order. Prints one JSON object and exits
+// non-zero when a press is lost or reordered.
+//
+//   eamio_keypad_edges [keys per second] [polls per second] [seconds]
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define EDGES_MAX_PRESSES 100000
+#define EDGES_UNIT 0
+// Frames polled after the last press so its release makes it through
+#define EDGES_SETTLE_FRAMES 30
+
+uint16_t eam_io_get_keypad_state(uint8_t unit_no);
+bool eam_io_poll(uint8_t unit_no);
+void eam_io_set_loggers(log_formatter_t misc, log_formatter_t info, log_formatter_t warning, log_formatter_t fatal);
+
+// KEY_KP0-9, the stub keypad uses the evdev keymap
+static const uint16_t digit_codes[10] = {82, 79, 80, 81, 75, 76, 77, 71, 72, 73};
+static const uint8_t digit_bits[10] = {
+    EAM_IO_KEYPAD_0, EAM_IO_KEYPAD_1, EAM_IO_KEYPAD_2, EAM_IO_KEYPAD_3, EAM_IO_KEYPAD_4,
+    EAM_IO_KEYPAD_5, EAM_IO_KEYPAD_6, EAM_IO_KEYPAD_7, EAM_IO_KEYPAD_8, EAM_IO_KEYPAD_9,
+};
+
+
+static int key_rate = 20;
+static int poll_rate = 60;
+static int seconds = 10;
+
+static uint8_t typed[EDGES_MAX_PRESSES];
+static _Atomic int typed_count = 0;
+static _Atomic bool typing = false;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+static void sleep_until_us(const uint64_t deadline) {
+    const struct timespec until = {
+        .tv_sec = (time_t)(deadline / 1000000),
+        .tv_nsec = (long)(deadline % 1000000) * 1000,
+    };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0) {
+    }
+}
+
+// Stands in for the keypad thread: one press every 1/key_rate s, each held 1-12 ms, so most press
+// and release pairs land between two polls
+static void* type_digits(void* param) {
+    const int presses = key_rate * seconds;
+    const uint64_t period = 1000000 / (uint64_t)key_rate;
+    uint64_t next = clock_now_us();
+    unsigned int seed = 1;
+
+    for(int i = 0; i < presses && i < EDGES_MAX_PRESSES; i++) {
+        sleep_until_us(next);
+        const uint8_t digit = (uint8_t)(rand_r(&seed) % 10);
+        const uint64_t hold_us = 1000 + (uint64_t)(rand_r(&seed) % 11000);
+
+        typed[i] = digit;
+        atomic_store(&typed_count, i + 1);
+        update_keypad_state(EDGES_UNIT, digit_codes[digit], true);
+        sleep_until_us(clock_now_us() + hold_us);
+        update_keypad_state(EDGES_UNIT, digit_codes[digit], false);
+
+        next += period;
+    }
+
+    atomic_store(&typing, false);
+    return NULL;
+}
+
+int main(int argc, char** argv) {
+    if(argc > 1) {
+        key_rate = atoi(argv[1]);
+    }
+    if(argc > 2) {
+        poll_rate = atoi(argv[2]);
+    }
+    if(argc > 3) {
+        seconds = atoi(argv[3]);
+    }
+    if(key_rate <= 0 || key_rate > 80 || poll_rate <= 0 || seconds <= 0 || key_rate * seconds > EDGES_MAX_PRESSES) {
+        fprintf(stderr, "Usage: eamio_keypad_edges [keys per second, up to 80] [polls per second] [seconds]\n");
+        return EXIT_FAILURE;
+    }
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_start(NULL);
+
+    static aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 2000000,
+        },
+    };
+    const int init_thread = create_thread(run_init, &config, 0x4000, 0);
+    while(get_unit_count() == 0) {
+        clock_sleep_ms(1);
+    }
+
+    static uint8_t seen[EDGES_MAX_PRESSES];
+    int seen_count = 0;
+    int extra = 0;
+    uint16_t previous = 0;
+
+    pthread_t typist;
+    atomic_store(&typing, true);
+    pthread_create(&typist, NULL, type_digits, NULL);
+
+    const uint64_t period = 1000000 / (uint64_t)poll_rate;
+    uint64_t frame = clock_now_us();
+    int settle = EDGES_SETTLE_FRAMES;
+    while(atomic_load(&typing) || settle-- > 0) {
+        frame += period;
+        sleep_until_us(frame);
+
+        eam_io_poll(EDGES_UNIT);
+        const uint16_t state = eam_io_get_keypad_state(EDGES_UNIT);
+        const uint16_t rising = state & ~previous;
+        previous = state;
+
+        for(uint8_t digit = 0; digit < 10; digit++) {
+            if(!(rising & (1 << digit_bits[digit]))) {
+                continue;
+            }
+            if(seen_count < EDGES_MAX_PRESSES) {
+                seen[seen_count++] = digit;
+            }
+            else {
+                extra++;
+            }
+        }
+    }
+    pthread_join(typist, NULL);
+
+    // Walk both sequences side by side, the first difference is where a press went missing or moved
+    const int presses = atomic_load(&typed_count);
+    int matched = 0;
+    while(matched < presses && matched < seen_count && typed[matched] == seen[matched]) {
+        matched++;
+    }
+
+    const bool passed = matched == presses && seen_count == presses && extra == 0;
+    printf("{\n  \"check\": \"keypad_edges\",\n  \"keys_per_second\": %d,\n  \"polls_per_second\": %d,\n", key_rate, poll_rate);
+    printf("  \"presses\": %d,\n  \"rising_edges\": %d,\n  \"in_order\": %d,\n  \"passed\": %s\n}\n",
+        presses, seen_count + extra, matched, passed ? "true" : "false");
+
+    request_stop();
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    fini();
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,173 @@
+// Checks key-to-state latency end to end against a virtual AIC Pico (see uhid_reader.h). Lets the real
+// Linux platform layer find and open it, then presses and releases KP1 and times how long each edge
+// takes to show up in eam_io_get_keypad_state(), polling with eam_io_poll() in between like a game frame.
+// Then sends bursts of presses back to back, which the keypad reads several at a time, and checks that
+// every one of them still shows up. Prints one JSON object and exits non-zero when an edge never arrives.
+// Needs write access to /dev/uhid.
+//
+//   eamio_keypad_latency [evdev|direct] [presses]
+#include "bench_thread.h"
+#include "samples.h"
+#include "uhid_reader.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CHECK_PHYS "eamio-keypad-latency"
+#define CHECK_TIMEOUT_US 100000
+#define CHECK_MAX_SAMPLES 10000
+// Press and release pairs sent without waiting in between
+#define CHECK_BURST_PRESSES 8
+
+uint16_t eam_io_get_keypad_state(uint8_t unit_no);
+bool eam_io_poll(uint8_t unit_no);
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+// Polls and reads the keypad the way a game frame does, back to back, so the time is the whole
+// path to the view eam_io_poll() publishes and not a frame interval
+static uint64_t wait_for_key(const int unit, const bool pressed, const uint64_t sent) {
+    while(clock_now_us() - sent < CHECK_TIMEOUT_US) {
+        eam_io_poll(unit);
+        if(((eam_io_get_keypad_state(unit) >> EAM_IO_KEYPAD_1) & 1) == pressed) {
+            return clock_now_us() - sent;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+// Counts presses as eam_io_poll() hands the queued edges out one at a time, until all of them came
+// through and the key is up again
+static uint64_t wait_for_burst(const int unit, const uint64_t sent) {
+    int presses = 0;
+    bool was_pressed = false;
+    while(clock_now_us() - sent < CHECK_TIMEOUT_US) {
+        eam_io_poll(unit);
+        const bool pressed = (eam_io_get_keypad_state(unit) >> EAM_IO_KEYPAD_1) & 1;
+        presses += pressed && !was_pressed;
+        was_pressed = pressed;
+
+        if(presses == CHECK_BURST_PRESSES && !pressed) {
+            return clock_now_us() - sent;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+int main(int argc, char** argv) {
+    const bool direct = argc > 1 && strcmp(argv[1], "direct") == 0;
+    const int presses = argc > 2 ? atoi(argv[2]) : 500;
+    if(presses <= 0 || presses * 2 > CHECK_MAX_SAMPLES) {
+        fprintf(stderr, "presses must be between 1 and %d\n", CHECK_MAX_SAMPLES / 2);
+        return EXIT_FAILURE;
+    }
+
+    uhid_reader_t reader;
+    if(!uhid_reader_create(&reader, CHECK_PHYS)) {
+        fprintf(stderr, "Failed to create uhid devices, is /dev/uhid writable?\n");
+        return EXIT_FAILURE;
+    }
+
+    // udev needs a moment to create the nodes
+    clock_sleep_ms(500);
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_start(NULL);
+
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 2000000,
+        },
+        .keypad_direct = direct,
+    };
+    const int init_thread = create_thread(run_init, (void*)&config, 0x4000, 0);
+
+    const uint64_t init_start = clock_now_us();
+    while(get_unit_count() == 0 && clock_now_us() - init_start < 2000000) {
+        clock_sleep_ms(1);
+    }
+
+    // Other readers on the machine may come first
+    int unit = -1;
+    for(int i = 0; i < get_unit_count(); i++) {
+        if(strcmp(devices[i].location, CHECK_PHYS) == 0) {
+            unit = i;
+        }
+    }
+    if(unit < 0) {
+        fprintf(stderr, "The virtual reader was not found\n");
+        return EXIT_FAILURE;
+    }
+
+    // Give the keypad thread time to open its node
+    clock_sleep_ms(200);
+
+    static uint64_t samples[CHECK_MAX_SAMPLES];
+    int sample_count = 0;
+    int missed = 0;
+    for(int i = 0; i < presses * 2; i++) {
+        const bool pressed = i % 2 == 0;
+        const uint64_t sent = clock_now_us();
+        if(!uhid_reader_send_keys(&reader, pressed ? UHID_READER_USAGE_KP1 : 0)) {
+            fprintf(stderr, "Failed to send a keypad report\n");
+            return EXIT_FAILURE;
+        }
+
+        const uint64_t latency = wait_for_key(unit, pressed, sent);
+        if(latency == UINT64_MAX) {
+            missed++;
+        }
+        else {
+            samples[sample_count++] = latency;
+        }
+    }
+
+    static uint64_t burst_samples[CHECK_MAX_SAMPLES];
+    int burst_count = 0;
+    int burst_missed = 0;
+    for(int i = 0; i < presses / CHECK_BURST_PRESSES; i++) {
+        const uint64_t sent = clock_now_us();
+        for(int j = 0; j < CHECK_BURST_PRESSES; j++) {
+            if(!uhid_reader_send_keys(&reader, UHID_READER_USAGE_KP1) || !uhid_reader_send_keys(&reader, 0)) {
+                fprintf(stderr, "Failed to send a keypad report\n");
+                return EXIT_FAILURE;
+            }
+        }
+
+        const uint64_t latency = wait_for_burst(unit, sent);
+        if(latency == UINT64_MAX) {
+            burst_missed++;
+        }
+        else {
+            burst_samples[burst_count++] = latency;
+        }
+    }
+
+    printf("{\n  \"check\": \"keypad_latency\",\n  \"mode\": \"%s\",\n  \"edges\": %d,\n  \"missed\": %d,\n  ",
+        direct ? "direct" : "evdev", presses * 2, missed);
+    samples_print("edge_latency", "us", samples, sample_count);
+    printf(",\n  \"burst_presses\": %d,\n  \"bursts\": %d,\n  \"bursts_missed\": %d,\n  ",
+        CHECK_BURST_PRESSES, presses / CHECK_BURST_PRESSES, burst_missed);
+    samples_print("burst_latency", "us", burst_samples, burst_count);
+    printf("\n}\n");
+
+    // Shut down before the virtual devices go, so the readers don't see them detach
+    request_stop();
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    fini();
+    uhid_reader_destroy(&reader);
+    return missed == 0 && burst_missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,83 @@
+// Measures what the per-stage latency histograms cost per event: one latency_record() with elapsed times
+// that stay in one bucket and with times spread over the whole range, one clock_now_us(), and the three
+// records plus clock reads a card event pays on its way from the report to eam_io_read_card(). Also checks
+// every recorded event was counted. Prints one JSON object and exits non-zero when a count is off.
+#include "../src/latency.h"
+#include "../src/clock.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_ITERATIONS 20000000
+// Card stages a tap passes through, see latency_stage_t
+#define CARD_STAGES 3
+
+static latency_histogram_t histograms[LATENCY_STAGE_COUNT];
+// Log-distributed from 1 us to about 1 s, like the stages see between a busy frame and a slow reader
+static uint64_t spread[4096];
+
+static uint64_t counted(const latency_histogram_t* histogram) {
+    uint64_t total = 0;
+    for(int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        total += atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+    }
+
+    return total;
+}
+
+static double ns_per_iteration(const uint64_t start) {
+    return (double)(clock_now_us() - start) * 1000.0 / BENCH_ITERATIONS;
+}
+
+int main() {
+    srand(5);
+    for(int i = 0; i < 4096; i++) {
+        spread[i] = 1ull << (rand() % 20);
+        spread[i] += (uint64_t)rand() % spread[i];
+    }
+
+    uint64_t start = clock_now_us();
+    for(int i = 0; i < BENCH_ITERATIONS; i++) {
+        latency_record(&histograms[0], 42);
+    }
+    const double same_bucket_ns = ns_per_iteration(start);
+
+    start = clock_now_us();
+    for(int i = 0; i < BENCH_ITERATIONS; i++) {
+        latency_record(&histograms[1], spread[i & 4095]);
+    }
+    const double spread_ns = ns_per_iteration(start);
+
+    uint64_t sink = 0;
+    start = clock_now_us();
+    for(int i = 0; i < BENCH_ITERATIONS; i++) {
+        sink += clock_now_us();
+    }
+    const double clock_ns = ns_per_iteration(start);
+
+    // Each stage reads the clock once and records against the timestamp the stage before it left. The report's
+    // own timestamp is taken whether or not anything is recorded, so it is carried over instead of read.
+    latency_histogram_t* card_stages = &histograms[2];
+    start = clock_now_us();
+    uint64_t previous = start;
+    for(int i = 0; i < BENCH_ITERATIONS / CARD_STAGES; i++) {
+        for(int stage = 0; stage < CARD_STAGES; stage++) {
+            const uint64_t now = clock_now_us();
+            latency_record(card_stages, now - previous);
+            previous = now;
+        }
+    }
+    const double card_event_ns = ns_per_iteration(start) * CARD_STAGES;
+
+    const bool passed = counted(&histograms[0]) == BENCH_ITERATIONS
+        && counted(&histograms[1]) == BENCH_ITERATIONS
+        && counted(card_stages) == (uint64_t)(BENCH_ITERATIONS / CARD_STAGES) * CARD_STAGES;
+
+    printf("{\n  \"benchmark\": \"latency\",\n  \"iterations\": %d,\n  \"counts_match\": %s,\n", BENCH_ITERATIONS, passed ? "true" : "false");
+    printf("  \"record_same_bucket_ns\": %.2f,\n  \"record_spread_ns\": %.2f,\n  \"clock_now_us_ns\": %.2f,\n",
+        same_bucket_ns, spread_ns, clock_ns);
+    printf("  \"card_event_ns\": %.2f,\n  \"checksum\": %llu\n}\n", card_event_ns, (unsigned long long)sink);
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,161 @@
+// Runs eam_io_init()/eam_io_fini() back to back the way a host restarting the game mode would, and checks
+// that every cycle gives back all threads and handles it took. Every other cycle runs with the readers
+// producing, so shutdown is also timed with them busy. Prints one JSON object and exits non-zero when a
+// cycle doesn't become ready, or threads, stub handles or file descriptors are left over.
+//
+//   eamio_lifecycle [cycles]
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+// A cycle that isn't ready after this counts as a failure
+#define LIFECYCLE_READY_TIMEOUT_US 2000000
+#define LIFECYCLE_POLLS 10
+
+bool eam_io_init(thread_create_t thread_create, thread_join_t thread_join, thread_destroy_t thread_destroy);
+void eam_io_fini(void);
+bool eam_io_ext_ready(void);
+bool eam_io_poll(uint8_t unit_no);
+void eam_io_set_loggers(log_formatter_t misc, log_formatter_t info, log_formatter_t warning, log_formatter_t fatal);
+
+typedef struct timing {
+    uint64_t total_us;
+    uint64_t max_us;
+} timing_t;
+
+static int count_fds() {
+    DIR* directory = opendir("/proc/self/fd");
+    if(directory == NULL) {
+        return -1;
+    }
+
+    int count = 0;
+    while(readdir(directory) != NULL) {
+        count++;
+    }
+    closedir(directory);
+
+    // ., .. and the descriptor opendir() itself holds
+    return count - 3;
+}
+
+static long rss_kb() {
+    long pages = 0;
+    long resident = 0;
+    FILE* file = fopen("/proc/self/statm", "r");
+    if(file == NULL) {
+        return -1;
+    }
+
+    if(fscanf(file, "%ld %ld", &pages, &resident) != 2) {
+        resident = -1;
+    }
+    fclose(file);
+
+    return resident < 0 ? -1 : resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+static void timing_record(timing_t* timing, const uint64_t us) {
+    timing->total_us += us;
+    if(us > timing->max_us) {
+        timing->max_us = us;
+    }
+}
+
+static void timing_print(const char* name, const timing_t* timing, const int cycles, const bool last) {
+    printf("  \"%s\": {\"mean_us\": %.1f, \"max_us\": %llu}%s\n",
+        name, cycles > 0 ? (double)timing->total_us / cycles : 0.0, (unsigned long long)timing->max_us, last ? "" : ",");
+}
+
+int main(const int argc, char** argv) {
+    const int cycles = argc > 1 ? atoi(argv[1]) : 1000;
+    if(cycles < 1) {
+        fprintf(stderr, "usage: eamio_lifecycle [cycles]\n");
+        return EXIT_FAILURE;
+    }
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+
+    timing_t ready_timing = {0};
+    timing_t fini_timing = {0};
+    timing_t cycle_timing = {0};
+    int completed = 0;
+    int not_ready = 0;
+    int leaked_threads = 0;
+    int leaked_handles = 0;
+
+    const int fds_before = count_fds();
+    long rss_first_kb = 0;
+
+    for(int cycle = 0; cycle < cycles; cycle++) {
+        atomic_store(&stub_producing, cycle % 2 == 1);
+
+        const uint64_t start = clock_now_us();
+        if(!eam_io_init(bench_create_thread, bench_join_thread, bench_destroy_thread)) {
+            not_ready++;
+            break;
+        }
+
+        while(!eam_io_ext_ready() && clock_now_us() - start < LIFECYCLE_READY_TIMEOUT_US) {
+            clock_sleep_ms(0);
+        }
+        const uint64_t ready = clock_now_us();
+        if(!eam_io_ext_ready()) {
+            not_ready++;
+        }
+
+        for(int i = 0; i < LIFECYCLE_POLLS; i++) {
+            for(uint8_t unit = 0; unit < STUB_UNIT_COUNT; unit++) {
+                eam_io_poll(unit);
+            }
+        }
+
+        const uint64_t fini_start = clock_now_us();
+        eam_io_fini();
+        const uint64_t end = clock_now_us();
+
+        timing_record(&ready_timing, ready - start);
+        timing_record(&fini_timing, end - fini_start);
+        timing_record(&cycle_timing, end - start);
+        completed++;
+
+        // Checked after every cycle, a leak that is cleaned up by the next one is still a leak
+        if(bench_threads_alive() != 0) {
+            leaked_threads++;
+        }
+        if(atomic_load(&stub_open_handles) != 0) {
+            leaked_handles++;
+        }
+
+        // The first cycle allocates what the process keeps anyway, later growth is what counts
+        if(cycle == 0) {
+            rss_first_kb = rss_kb();
+        }
+    }
+    atomic_store(&stub_producing, false);
+
+    const int fds_after = count_fds();
+    const long rss_last_kb = rss_kb();
+
+    printf("{\n  \"benchmark\": \"eam_io_lifecycle\",\n  \"units\": %d,\n  \"cycles\": %d,\n", STUB_UNIT_COUNT, completed);
+    timing_print("init_to_ready", &ready_timing, completed, false);
+    timing_print("fini", &fini_timing, completed, false);
+    timing_print("cycle", &cycle_timing, completed, false);
+    printf("  \"cycles_not_ready\": %d,\n", not_ready);
+    printf("  \"cycles_leaking_threads\": %d,\n", leaked_threads);
+    printf("  \"cycles_leaking_handles\": %d,\n", leaked_handles);
+    printf("  \"threads_alive\": %d,\n", bench_threads_alive());
+    printf("  \"handles_open\": %d,\n", atomic_load(&stub_open_handles));
+    printf("  \"fds\": {\"before\": %d, \"after\": %d},\n", fds_before, fds_after);
+    printf("  \"rss_kb\": {\"after_first_cycle\": %ld, \"after_last_cycle\": %ld}\n}\n", rss_first_kb, rss_last_kb);
+
+    const bool passed = completed == cycles && not_ready == 0 && leaked_threads == 0 && leaked_handles == 0 && fds_after <= fds_before;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
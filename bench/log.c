@@ -0,0 +1,154 @@
+// Measures what logging costs the thread that logs, with the drain thread writing to /dev/null. Records
+// are written in bursts of half the ring with a pause for the drain in between, so the cost is that of a
+// stored record and not of a drop. Covers a hot-path event, a formatted line, a line below the runtime
+// level, an event from four threads at once, and the synchronous fprintf()+fflush() logging used to do
+// (to /dev/null as well, a console is slower still).
+// Prints one JSON object and exits non-zero when a record was dropped.
+#include "bench_thread.h"
+#include "samples.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BURSTS 100
+// Half the ring, so one burst never fills it
+#define BURST_RECORDS 512
+// Calls timed together, one call is close to the clock's resolution
+#define BATCH 64
+#define PRODUCERS 4
+// Longer than the drain's interval, so every burst finds the ring empty
+#define DRAIN_PAUSE_MS 15
+#define MAX_SAMPLES (BURSTS * BURST_RECORDS / BATCH)
+
+typedef enum phase_kind {
+    PHASE_EVENT,
+    PHASE_TEXT,
+    PHASE_FILTERED,
+    PHASE_FPRINTF,
+} phase_kind_t;
+
+typedef struct phase {
+    const char* name;
+    phase_kind_t kind;
+    int producers;
+    uint64_t samples[MAX_SAMPLES];
+    _Atomic int sample_count;
+    uint32_t dropped;
+} phase_t;
+
+static phase_t phases[] = {
+    {.name = "card_event", .kind = PHASE_EVENT, .producers = 1},
+    {.name = "text", .kind = PHASE_TEXT, .producers = 1},
+    {.name = "below_runtime_level", .kind = PHASE_FILTERED, .producers = 1},
+    {.name = "card_event_4_threads", .kind = PHASE_EVENT, .producers = PRODUCERS},
+    {.name = "sync_fprintf", .kind = PHASE_FPRINTF, .producers = 1},
+};
+
+static const uint8_t report[] = {0x01, 0xE0, 0x04, 0x01, 0x00, 0x12, 0x34, 0x56, 0x78};
+static FILE* null_file = NULL;
+static phase_t* current = NULL;
+static pthread_barrier_t burst_start;
+static pthread_barrier_t burst_end;
+
+static void log_one(const phase_kind_t kind, const int i) {
+    switch(kind) {
+        case PHASE_EVENT:
+            log_event(LOG_LEVEL_INFO, LOG_EVENT_CARD_REPORT, i & 1, sizeof(report), report, sizeof(report));
+            break;
+        case PHASE_TEXT:
+            log_info("Device %d: location %s, keymap %s\n", i & 1, "usb-0000:00:14.0-3", "evdev");
+            break;
+        case PHASE_FILTERED:
+            log_debug("Device %d: location %s, keymap %s\n", i & 1, "usb-0000:00:14.0-3", "evdev");
+            break;
+        case PHASE_FPRINTF:
+            fprintf(null_file, "Device %d: location %s, keymap %s\n", i & 1, "usb-0000:00:14.0-3", "evdev");
+            fflush(null_file);
+            break;
+    }
+}
+
+static void* produce(void* param) {
+    for(int burst = 0; burst < BURSTS; burst++) {
+        pthread_barrier_wait(&burst_start);
+
+        const int records = BURST_RECORDS / current->producers;
+        for(int batch = 0; batch < records / BATCH; batch++) {
+            const uint64_t start = clock_now_us();
+            for(int i = 0; i < BATCH; i++) {
+                log_one(current->kind, i);
+            }
+            const uint64_t elapsed_us = clock_now_us() - start;
+
+            const int sample = atomic_fetch_add(&current->sample_count, 1);
+            if(sample < MAX_SAMPLES) {
+                current->samples[sample] = elapsed_us * 1000 / BATCH;
+            }
+        }
+
+        pthread_barrier_wait(&burst_end);
+    }
+
+    return NULL;
+}
+
+static void run_phase(phase_t* phase) {
+    current = phase;
+    const uint32_t dropped_before = log_dropped();
+
+    pthread_barrier_init(&burst_start, NULL, phase->producers + 1);
+    pthread_barrier_init(&burst_end, NULL, phase->producers + 1);
+    pthread_t producers[PRODUCERS];
+    for(int i = 0; i < phase->producers; i++) {
+        pthread_create(&producers[i], NULL, produce, NULL);
+    }
+
+    for(int burst = 0; burst < BURSTS; burst++) {
+        pthread_barrier_wait(&burst_start);
+        pthread_barrier_wait(&burst_end);
+        clock_sleep_ms(DRAIN_PAUSE_MS);
+    }
+
+    for(int i = 0; i < phase->producers; i++) {
+        pthread_join(producers[i], NULL);
+    }
+    pthread_barrier_destroy(&burst_start);
+    pthread_barrier_destroy(&burst_end);
+
+    phase->dropped = log_dropped() - dropped_before;
+}
+
+int main() {
+    null_file = fopen("/dev/null", "w");
+    if(null_file == NULL) {
+        fprintf(stderr, "Failed to open /dev/null\n");
+        return EXIT_FAILURE;
+    }
+
+    bench_use_threads();
+    log_runtime_level = LOG_LEVEL_INFO;
+    log_start("/dev/null");
+
+    bool passed = true;
+    printf("{\n  \"benchmark\": \"log\",\n  \"records_per_phase\": %d,\n  \"phases\": [", BURSTS * BURST_RECORDS);
+    for(size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); p++) {
+        phase_t* phase = &phases[p];
+        run_phase(phase);
+        passed = passed && phase->dropped == 0;
+
+        printf("%s\n    {\"phase\": \"%s\", \"producers\": %d, \"dropped\": %u, ", p == 0 ? "" : ",", phase->name, phase->producers, phase->dropped);
+        samples_print("per_call", "ns", phase->samples, atomic_load(&phase->sample_count));
+        printf("}");
+    }
+    printf("\n  ]\n}\n");
+
+    log_stop();
+    fclose(null_file);
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,208 @@
+// Deterministic test of the card presence machine on a simulated clock. Each scenario feeds reports at
+// fixed microsecond timestamps and fires the timers exactly at their deadlines, the way the event-driven
+// reader loop does, then compares every publish and clear with when it is expected, to the microsecond.
+// Also times a report and a timer call. Prints one JSON object and exits non-zero when a scenario fails.
+#include "../src/presence.h"
+#include "../src/clock.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_STEPS 8
+#define BENCH_ITERATIONS 10000000
+
+#define CARD_REMOVED 0
+
+// A report of card `card` (a one byte ID, CARD_REMOVED once the field is empty) at `at_us`
+typedef struct step {
+    uint64_t at_us;
+    uint8_t card;
+} step_t;
+
+// What the game sees change and when
+typedef struct published {
+    uint64_t at_us;
+    presence_action_t action;
+    uint8_t card;
+} published_t;
+
+typedef struct scenario {
+    const char* name;
+    presence_config_t config;
+    step_t steps[MAX_STEPS];
+    int step_count;
+    published_t expected[MAX_STEPS];
+    int expected_count;
+} scenario_t;
+
+#define MS(ms) ((uint64_t)(ms) * 1000)
+
+static const presence_config_t default_config = {
+    .min_presence_us = MS(100),
+    .hold_us = MS(2000),
+    .cooldown_us = 0,
+    .retap_extends = true,
+};
+
+static const presence_config_t no_extend_config = {
+    .min_presence_us = MS(100),
+    .hold_us = MS(2000),
+    .cooldown_us = 0,
+    .retap_extends = false,
+};
+
+static const presence_config_t cooldown_config = {
+    .min_presence_us = MS(100),
+    .hold_us = MS(2000),
+    .cooldown_us = MS(500),
+    .retap_extends = true,
+};
+
+static const scenario_t scenarios[] = {
+    {
+        "tap_is_published_on_arrival", default_config,
+        {{1000, 'A'}}, 1,
+        {{1000, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {1000 + MS(2000), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 2,
+    },
+    {
+        // What used to wait out the whole Sleep(2000)
+        "other_card_replaces_held_card", default_config,
+        {{0, 'A'}, {MS(50), CARD_REMOVED}, {MS(300), 'B'}}, 3,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(100), PRESENCE_ACTION_PUBLISH_CLEAR, 0}, {MS(300), PRESENCE_ACTION_PUBLISH_CARD, 'B'},
+            {MS(2300), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 4,
+    },
+    {
+        "other_card_replaces_card_in_field", default_config,
+        {{0, 'A'}, {MS(300), 'B'}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(300), PRESENCE_ACTION_PUBLISH_CARD, 'B'}, {MS(2300), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 3,
+    },
+    {
+        "other_card_replaces_during_min_presence", default_config,
+        {{0, 'A'}, {10, 'B'}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {10, PRESENCE_ACTION_PUBLISH_CARD, 'B'}, {10 + MS(2000), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 3,
+    },
+    {
+        "short_tap_lasts_min_presence", default_config,
+        {{0, 'A'}, {MS(20), CARD_REMOVED}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(100), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 2,
+    },
+    {
+        "retap_extends_hold", default_config,
+        {{0, 'A'}, {MS(1500), 'A'}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(3500), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 2,
+    },
+    {
+        "retap_keeps_hold_when_not_extending", no_extend_config,
+        {{0, 'A'}, {MS(1500), 'A'}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(2000), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 2,
+    },
+    {
+        "cooldown_ignores_same_card", cooldown_config,
+        {{0, 'A'}, {MS(2100), 'A'}, {MS(2600), 'A'}}, 3,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(2000), PRESENCE_ACTION_PUBLISH_CLEAR, 0}, {MS(2600), PRESENCE_ACTION_PUBLISH_CARD, 'A'},
+            {MS(4600), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 4,
+    },
+    {
+        "cooldown_accepts_other_card", cooldown_config,
+        {{0, 'A'}, {MS(2100), 'B'}}, 2,
+        {{0, PRESENCE_ACTION_PUBLISH_CARD, 'A'}, {MS(2000), PRESENCE_ACTION_PUBLISH_CLEAR, 0}, {MS(2100), PRESENCE_ACTION_PUBLISH_CARD, 'B'},
+            {MS(4100), PRESENCE_ACTION_PUBLISH_CLEAR, 0}}, 4,
+    },
+};
+
+// IDs point into the report, so every card gets a buffer of its own here
+static uint8_t card_ids[256][CARD_ID_SIZE];
+
+static card_record_t make_card(const uint8_t card) {
+    card_record_t record = {0};
+    if(card != CARD_REMOVED) {
+        card_ids[card][CARD_ID_SIZE - 1] = card;
+        record.type = CARD_TYPE_ISO15693;
+        record.id = card_ids[card];
+    }
+
+    return record;
+}
+
+static void record(const presence_t* presence, const presence_action_t action, const uint64_t now, published_t* log, int* log_count) {
+    if(action == PRESENCE_ACTION_NONE || *log_count >= MAX_STEPS) {
+        return;
+    }
+
+    log[(*log_count)++] = (published_t){now, action, action == PRESENCE_ACTION_PUBLISH_CARD ? presence->card[PRESENCE_CARD_SIZE - 1] : 0};
+}
+
+// Fires every timer due up to `until`, each at its own deadline
+static void run_timers(presence_t* presence, const uint64_t until, published_t* log, int* log_count) {
+    while(presence_deadline(presence) <= until) {
+        const uint64_t deadline = presence_deadline(presence);
+        record(presence, presence_on_timer(presence, deadline), deadline, log, log_count);
+    }
+}
+
+static bool run_scenario(const scenario_t* scenario) {
+    presence_t presence;
+    presence_init(&presence, &scenario->config);
+
+    published_t log[MAX_STEPS];
+    int log_count = 0;
+    for(int i = 0; i < scenario->step_count; i++) {
+        const step_t* step = &scenario->steps[i];
+        run_timers(&presence, step->at_us, log, &log_count);
+
+        const card_record_t card = make_card(step->card);
+        record(&presence, presence_on_report(&presence, &card, step->at_us), step->at_us, log, &log_count);
+    }
+    run_timers(&presence, PRESENCE_NO_DEADLINE - 1, log, &log_count);
+
+    bool passed = log_count == scenario->expected_count;
+    for(int i = 0; i < log_count && i < scenario->expected_count; i++) {
+        const published_t* expected = &scenario->expected[i];
+        if(log[i].at_us != expected->at_us || log[i].action != expected->action || log[i].card != expected->card) {
+            fprintf(stderr, "%s: change %d was action %d card %c at %llu us, expected action %d card %c at %llu us\n",
+                scenario->name, i, log[i].action, log[i].card ? log[i].card : '-', (unsigned long long)log[i].at_us,
+                expected->action, expected->card ? expected->card : '-', (unsigned long long)expected->at_us);
+            passed = false;
+        }
+    }
+    if(log_count != scenario->expected_count) {
+        fprintf(stderr, "%s: %d changes, expected %d\n", scenario->name, log_count, scenario->expected_count);
+    }
+
+    return passed;
+}
+
+// Alternates two cards with gaps around the hold time, so every phase is crossed
+static double time_transitions() {
+    presence_t presence;
+    presence_init(&presence, &default_config);
+    const card_record_t cards[] = {make_card('A'), make_card(CARD_REMOVED), make_card('B'), make_card(CARD_REMOVED)};
+
+    uint64_t now = 0;
+    uint64_t actions = 0;
+    const uint64_t start = clock_now_us();
+    for(int i = 0; i < BENCH_ITERATIONS; i++) {
+        now += MS(i % 8 == 0 ? 2500 : 30);
+        actions += presence_on_timer(&presence, now);
+        actions += presence_on_report(&presence, &cards[i & 3], now);
+        __asm__ volatile("" : "+r"(actions));
+    }
+    const uint64_t elapsed_us = clock_now_us() - start;
+
+    return (double)elapsed_us * 1000.0 / BENCH_ITERATIONS;
+}
+
+int main() {
+    bool passed = true;
+
+    printf("{\n  \"benchmark\": \"presence\",\n  \"scenarios\": [");
+    for(size_t s = 0; s < sizeof(scenarios) / sizeof(scenarios[0]); s++) {
+        const bool scenario_passed = run_scenario(&scenarios[s]);
+        passed = passed && scenario_passed;
+        printf("%s\n    {\"scenario\": \"%s\", \"passed\": %s}", s == 0 ? "" : ",", scenarios[s].name, scenario_passed ? "true" : "false");
+    }
+    printf("\n  ],\n  \"ns_per_report_and_timer\": %.2f\n}\n", time_transitions());
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,168 @@
+// Stress test for the reader_state triple buffer. A producer thread fills the back slot in place and
+// publishes it the way the reader thread does after a HID read, clearing the state every so often, while
+// the main thread reads the front slot like eam_io_poll() does. Every report carries its sequence number
+// in each byte, so a read that mixes two reports is caught.
+//
+// Runs twice: once at HID rate with a 1 kHz consumer, timing how old the snapshot is when read, and once
+// with both sides spinning, timing reader_state_front(). Prints one JSON object and exits non-zero on any
+// torn or out-of-order read.
+//
+//   eamio_bench_reader_state [seconds per phase]
+#include "samples.h"
+#include "../src/reader_state.h"
+#include "../src/clock.h"
+
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Header of every report: sequence number, then when it was published
+#define REPORT_HEADER_SIZE 16
+#define CLEAR_EVERY 64
+// reader_state_front() calls timed together, one call is well below the clock's resolution
+#define READ_BATCH 256
+#define MAX_SAMPLES 1000000
+
+typedef struct phase {
+    const char* name;
+    bool hid_rate;
+    uint64_t published;
+    uint64_t reads;
+    uint64_t torn;
+    uint64_t backwards;
+    uint64_t samples[MAX_SAMPLES];
+    int sample_count;
+} phase_t;
+
+static reader_state_t state;
+static _Atomic bool producing = false;
+static _Atomic uint64_t published = 0;
+
+static void* produce(void* param) {
+    const bool hid_rate = *(const bool*)param;
+
+    uint64_t sequence = 0;
+    while(atomic_load_explicit(&producing, memory_order_relaxed)) {
+        sequence++;
+
+        if(sequence % CLEAR_EVERY == 0) {
+            reader_state_clear(&state);
+        }
+        else {
+            // Filled in place like a ReadFile/read() into the back slot
+            reader_snapshot_t* snapshot = reader_state_back(&state);
+            const uint64_t now = clock_now_us();
+            snapshot->length = REPORT_HEADER_SIZE + (uint32_t)(sequence % (READER_REPORT_SIZE - REPORT_HEADER_SIZE + 1));
+            memcpy(snapshot->report, &sequence, sizeof(sequence));
+            memcpy(snapshot->report + sizeof(sequence), &now, sizeof(now));
+            memset(snapshot->report + REPORT_HEADER_SIZE, (uint8_t)sequence, snapshot->length - REPORT_HEADER_SIZE);
+            reader_state_publish(&state);
+        }
+        atomic_store_explicit(&published, sequence, memory_order_relaxed);
+
+        // Full-speed HID delivers at most one interrupt report per millisecond
+        if(hid_rate) {
+            clock_sleep_ms(1);
+        }
+    }
+
+    return NULL;
+}
+
+// Checks one snapshot and returns its publish time, 0 for a cleared state
+static uint64_t check_snapshot(phase_t* phase, const reader_snapshot_t* snapshot, uint64_t* last_sequence) {
+    phase->reads++;
+    if(snapshot->length == 0) {
+        return 0;
+    }
+
+    uint64_t sequence;
+    uint64_t published_us;
+    memcpy(&sequence, snapshot->report, sizeof(sequence));
+    memcpy(&published_us, snapshot->report + sizeof(sequence), sizeof(published_us));
+
+    bool torn = snapshot->length != REPORT_HEADER_SIZE + sequence % (READER_REPORT_SIZE - REPORT_HEADER_SIZE + 1);
+    for(uint32_t i = REPORT_HEADER_SIZE; i < snapshot->length && !torn; i++) {
+        torn = snapshot->report[i] != (uint8_t)sequence;
+    }
+
+    if(torn) {
+        phase->torn++;
+        return 0;
+    }
+    if(sequence < *last_sequence) {
+        phase->backwards++;
+    }
+    *last_sequence = sequence;
+
+    return published_us;
+}
+
+static void run_phase(phase_t* phase, const uint32_t seconds) {
+    reader_state_init(&state);
+    atomic_store(&published, 0);
+    atomic_store(&producing, true);
+
+    pthread_t producer;
+    pthread_create(&producer, NULL, produce, &phase->hid_rate);
+
+    uint64_t last_sequence = 0;
+    const uint64_t start = clock_now_us();
+    while(clock_now_us() - start < seconds * 1000000ull) {
+        if(phase->hid_rate) {
+            // How long the newest report sat in the buffer before a 1 kHz poll picked it up
+            const uint64_t published_us = check_snapshot(phase, reader_state_front(&state), &last_sequence);
+            const uint64_t now = clock_now_us();
+            if(published_us != 0 && phase->sample_count < MAX_SAMPLES) {
+                phase->samples[phase->sample_count++] = now > published_us ? now - published_us : 0;
+            }
+            clock_sleep_ms(1);
+            continue;
+        }
+
+        const uint64_t batch_start = clock_now_us();
+        for(int i = 0; i < READ_BATCH; i++) {
+            check_snapshot(phase, reader_state_front(&state), &last_sequence);
+        }
+        if(phase->sample_count < MAX_SAMPLES) {
+            phase->samples[phase->sample_count++] = (clock_now_us() - batch_start) * 1000 / READ_BATCH;
+        }
+    }
+
+    atomic_store(&producing, false);
+    pthread_join(producer, NULL);
+    phase->published = atomic_load(&published);
+}
+
+static phase_t phases[] = {
+    {.name = "hid_rate", .hid_rate = true},
+    {.name = "flat_out", .hid_rate = false},
+};
+
+int main(int argc, char** argv) {
+    const int seconds = argc > 1 ? atoi(argv[1]) : 2;
+    if(seconds < 1) {
+        fprintf(stderr, "usage: eamio_bench_reader_state [seconds per phase]\n");
+        return EXIT_FAILURE;
+    }
+
+    bool passed = true;
+    printf("{\n  \"benchmark\": \"reader_state\",\n  \"seconds_per_phase\": %d,\n  \"phases\": [", seconds);
+
+    for(size_t p = 0; p < sizeof(phases) / sizeof(phases[0]); p++) {
+        phase_t* phase = &phases[p];
+        run_phase(phase, (uint32_t)seconds);
+        passed = passed && phase->torn == 0 && phase->backwards == 0;
+
+        printf("%s\n    {\"phase\": \"%s\", \"published\": %llu, \"reads\": %llu, \"torn_reads\": %llu, \"out_of_order_reads\": %llu, ",
+            p == 0 ? "" : ",", phase->name, (unsigned long long)phase->published, (unsigned long long)phase->reads,
+            (unsigned long long)phase->torn, (unsigned long long)phase->backwards);
+        samples_print(phase->hid_rate ? "snapshot_age" : "read_cost", phase->hid_rate ? "us" : "ns", phase->samples, phase->sample_count);
+        printf("}");
+    }
+
+    printf("\n  ]\n}\n");
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,68 @@
+// Measures ns/report of report_parser_decode() for each kind of report a CardIO interface sends,
+// and how long setting a parser up from a descriptor takes. Prints one JSON object to stdout.
+#include "../src/report_parser.h"
+#include "../src/clock.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define BENCH_ITERATIONS 20000000
+#define BENCH_SETUP_ITERATIONS 200000
+
+// Report 1 carries an ISO15693 UID, report 2 a FeliCa IDm, 8 bytes each in a vendor collection
+static const uint8_t cardio_descriptor[] = {
+    0x06, 0xCA, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    0x85, 0x01, 0x09, 0x41, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x08, 0x81, 0x02,
+    0x85, 0x02, 0x09, 0x42, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x08, 0x81, 0x02,
+    0xC0,
+};
+
+typedef struct bench_report {
+    const char* name;
+    uint8_t data[64];
+    uint32_t length;
+} bench_report_t;
+
+static const bench_report_t reports[] = {
+    {"iso15693", {0x01, 0xE0, 0x04, 0x01, 0x00, 0x12, 0x34, 0x56, 0x78}, 9},
+    {"felica", {0x02, 0x01, 0x2E, 0x4C, 0xD8, 0x12, 0x34, 0x56, 0x78}, 9},
+    // What Windows hands back, padded to the longest input report
+    {"iso15693_padded", {0x01, 0xE0, 0x04, 0x01, 0x00, 0x12, 0x34, 0x56, 0x78}, 64},
+    {"removed", {0x01}, 9},
+    {"malformed_short", {0x01, 0xE0, 0x04}, 3},
+    {"malformed_unknown_id", {0x7F, 0xE0, 0x04, 0x01, 0x00, 0x12, 0x34, 0x56, 0x78}, 9},
+    {"malformed_id_0", {0x00, 0xE0, 0x04, 0x01, 0x00, 0x12, 0x34, 0x56, 0x78}, 9},
+};
+
+int main() {
+    report_layout_t layout;
+    report_parser_t parser;
+
+    uint64_t start = clock_now_us();
+    int set_up = 0;
+    for(int i = 0; i < BENCH_SETUP_ITERATIONS; i++) {
+        set_up += report_descriptor_parse(cardio_descriptor, sizeof(cardio_descriptor), &layout) && report_parser_init(&parser, &layout);
+    }
+    const uint64_t setup_us = clock_now_us() - start;
+
+    printf("{\n  \"benchmark\": \"report_parser\",\n  \"iterations\": %d,\n", BENCH_ITERATIONS);
+    printf("  \"setup_ns\": %.2f,\n  \"results\": [", set_up == BENCH_SETUP_ITERATIONS ? (double)setup_us * 1000.0 / BENCH_SETUP_ITERATIONS : -1.0);
+
+    for(size_t r = 0; r < sizeof(reports) / sizeof(reports[0]); r++) {
+        // Fold every result into a checksum, so the decode can't be hoisted out of the loop
+        uint64_t checksum = 0;
+        card_record_t card;
+        start = clock_now_us();
+        for(int i = 0; i < BENCH_ITERATIONS; i++) {
+            checksum += report_parser_decode(&parser, reports[r].data, reports[r].length, &card) + card.type;
+            __asm__ volatile("" : "+r"(checksum));
+        }
+        const uint64_t elapsed_us = clock_now_us() - start;
+
+        printf("%s\n    {\"report\": \"%s\", \"ns_per_report\": %.2f, \"checksum\": %llu}", r == 0 ? "" : ",",
+            reports[r].name, (double)elapsed_us * 1000.0 / BENCH_ITERATIONS, (unsigned long long)checksum);
+    }
+
+    printf("\n  ]\n}\n");
+    return 0;
+}
@@ -0,0 +1,32 @@
+#include "samples.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+static int compare_samples(const void* a, const void* b) {
+    const uint64_t left = *(const uint64_t*)a;
+    const uint64_t right = *(const uint64_t*)b;
+    return (left > right) - (left < right);
+}
+
+void samples_sort(uint64_t* samples, const int count) {
+    qsort(samples, count, sizeof(samples[0]), compare_samples);
+}
+
+uint64_t samples_percentile(const uint64_t* sorted, const int count, const int per_mille) {
+    if(count <= 0) {
+        return 0;
+    }
+
+    return sorted[(int64_t)count * per_mille / 1000];
+}
+
+void samples_print(const char* name, const char* unit, uint64_t* samples, const int count) {
+    samples_sort(samples, count);
+    printf("\"%s\": {\"count\": %d, \"p50_%s\": %llu, \"p99_%s\": %llu, \"p999_%s\": %llu, \"max_%s\": %llu}",
+        name, count,
+        unit, (unsigned long long)samples_percentile(samples, count, 500),
+        unit, (unsigned long long)samples_percentile(samples, count, 990),
+        unit, (unsigned long long)samples_percentile(samples, count, 999),
+        unit, (unsigned long long)(count > 0 ? samples[count - 1] : 0));
+}
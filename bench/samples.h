@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Sorts samples in place, ascending, for samples_percentile()
+void samples_sort(uint64_t* samples, int count);
+// Value at per_mille of the sorted samples (500 is the median, 999 the p999), 0 without samples
+uint64_t samples_percentile(const uint64_t* sorted, int count, int per_mille);
+// Sorts the samples and prints "name": {"count", "p50_<unit>", "p99_<unit>", "p999_<unit>", "max_<unit>"}
+// without a trailing comma or newline, for the JSON the benches print
+void samples_print(const char* name, const char* unit, uint64_t* samples, int count);
@@ -0,0 +1,114 @@
+// Compares cold and warm startup of the device table on the real Linux platform layer, doing what init()
+// does before any reader is opened. Cold is full enumeration through sysfs followed by saving the cache,
+// warm is loading and checking the cache, stale is a cache whose first reader moved, which costs the
+// check and then the full enumeration. Uses whatever readers the machine has, eamio_virtual_reader can
+// provide one. Prints one JSON object and exits non-zero when no reader is found or the cache loads a
+// table different from the enumerated one. Build it at two EAMIO_LOG_LEVEL settings to see what the
+// enumeration's trace and debug lines cost at startup.
+//
+//   eamio_bench_startup [iterations]
+#include "samples.h"
+#include "../src/clock.h"
+#include "../src/device.h"
+#include "../src/device_cache.h"
+#include "../src/log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+// The AIC Pico aic.c looks for
+#define VID 0xCAFF
+#define PID 0x400E
+#define CARDIO_MI 0
+#define KEYPAD_MI 1
+#define MAX_ITERATIONS 10000
+
+static uint64_t cold[MAX_ITERATIONS];
+static uint64_t warm[MAX_ITERATIONS];
+static uint64_t stale[MAX_ITERATIONS];
+
+// load_devices() in aic.c, with the cache always on
+static device_t* load_devices(const char* cache_path, int* count) {
+    device_t* cached = device_cache_load(cache_path, VID, PID, CARDIO_MI, KEYPAD_MI, count);
+    if(cached != NULL) {
+        return cached;
+    }
+
+    device_t* found = get_devices(VID, PID, CARDIO_MI, KEYPAD_MI, count);
+    if(*count > 0) {
+        device_cache_save(cache_path, found, *count);
+    }
+
+    return found;
+}
+
+// Times one load_devices() and checks it came up with the enumerated table
+static uint64_t time_load(const char* cache_path, const device_t* expected, const int expected_count, int* mismatches) {
+    int count;
+    const uint64_t start = clock_now_us();
+    device_t* loaded = load_devices(cache_path, &count);
+    const uint64_t elapsed = clock_now_us() - start;
+
+    if(count != expected_count || memcmp(loaded, expected, count * sizeof(device_t)) != 0) {
+        (*mismatches)++;
+    }
+    free(loaded);
+
+    return elapsed;
+}
+
+int main(int argc, char** argv) {
+    const int iterations = argc > 1 ? atoi(argv[1]) : 200;
+    if(iterations < 1 || iterations > MAX_ITERATIONS) {
+        fprintf(stderr, "usage: eamio_bench_startup [iterations, 1-%d]\n", MAX_ITERATIONS);
+        return EXIT_FAILURE;
+    }
+
+    int device_count;
+    device_t* devices = get_devices(VID, PID, CARDIO_MI, KEYPAD_MI, &device_count);
+    if(device_count == 0) {
+        fprintf(stderr, "No reader found, plug one in or start eamio_virtual_reader\n");
+        free(devices);
+        return EXIT_FAILURE;
+    }
+
+    char cache_path[] = "/tmp/eamio-startup-XXXXXX";
+    const int cache_fd = mkstemp(cache_path);
+    if(cache_fd < 0) {
+        fprintf(stderr, "Failed to create the cache file\n");
+        free(devices);
+        return EXIT_FAILURE;
+    }
+    close(cache_fd);
+
+    // Moved to a node that doesn't exist, the first check fails
+    device_t* moved = malloc(device_count * sizeof(device_t));
+    memcpy(moved, devices, device_count * sizeof(device_t));
+    snprintf(moved[0].cardio_path, sizeof(moved[0].cardio_path), "/dev/hidraw-eamio-moved");
+
+    int mismatches = 0;
+    for(int i = 0; i < iterations; i++) {
+        unlink(cache_path);
+        cold[i] = time_load(cache_path, devices, device_count, &mismatches);
+        warm[i] = time_load(cache_path, devices, device_count, &mismatches);
+
+        device_cache_save(cache_path, moved, device_count);
+        stale[i] = time_load(cache_path, devices, device_count, &mismatches);
+    }
+
+    printf("{\n  \"benchmark\": \"startup\",\n  \"log_compile_level\": %d,\n  \"readers\": %d,\n  \"iterations\": %d,\n  \"mismatches\": %d,\n  ",
+        LOG_COMPILE_LEVEL, device_count, iterations, mismatches);
+    samples_print("cold", "us", cold, iterations);
+    printf(",\n  ");
+    samples_print("warm", "us", warm, iterations);
+    printf(",\n  ");
+    samples_print("stale", "us", stale, iterations);
+    printf("\n}\n");
+
+    unlink(cache_path);
+    free(moved);
+    free(devices);
+    return mismatches == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,86 @@
+// Stands in for src/linux/{device,keypad,hotplug}.c. Linked with stub_platform.c for benches without any
+// I/O, or with src/linux/io.c for ones that read real descriptors the bench writes to.
+#include "stub_platform.h"
+#include "../src/device.h"
+#include "../src/keypad.h"
+#include "../src/hotplug.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+_Atomic int stub_open_handles = 0;
+int stub_device_count = STUB_UNIT_COUNT;
+const char* stub_cardio_path_format = "stub-cardio-%d";
+
+device_t* get_devices(int vid, int pid, int cardio_mi, int keypad_mi, int* device_count) {
+    device_t* devices = calloc(stub_device_count, sizeof(device_t));
+    for(int i = 0; i < stub_device_count; i++) {
+        snprintf(devices[i].location, sizeof(devices[i].location), "stub-%d", i);
+        snprintf(devices[i].cardio_path, sizeof(devices[i].cardio_path), stub_cardio_path_format, i);
+    }
+
+    *device_count = stub_device_count;
+    return devices;
+}
+
+int match_device(const device_t* devices, int device_count, const char* path, int vid, int pid, int mi) {
+    return -1;
+}
+
+bool match_keypad(const device_t* device, int vid, int pid, int mi) {
+    return false;
+}
+
+// The real keypad and hotplug each hold a thread and OS handles while running, counted as one handle here
+static bool keypad_running = false;
+static bool hotplug_running = false;
+
+bool keypad_start() {
+    keypad_running = true;
+    atomic_fetch_add(&stub_open_handles, 1);
+    return true;
+}
+
+void keypad_stop() {
+    if(keypad_running) {
+        keypad_running = false;
+        atomic_fetch_sub(&stub_open_handles, 1);
+    }
+}
+
+bool keypad_register(io_loop_t* loop) {
+    return true;
+}
+
+void keypad_unregister(io_loop_t* loop) {
+}
+
+void keypad_set_direct(const bool enabled) {
+}
+
+const char* keypad_default_keymap() {
+    return "evdev";
+}
+
+void keypad_service() {
+}
+
+uint64_t keypad_deadline() {
+    return TRANSPORT_NO_DEADLINE;
+}
+
+void keypad_arrival(const int index, const char* path) {
+}
+
+bool hotplug_start(hotplug_arrival_t on_arrival) {
+    hotplug_running = true;
+    atomic_fetch_add(&stub_open_handles, 1);
+    return true;
+}
+
+void hotplug_stop() {
+    if(hotplug_running) {
+        hotplug_running = false;
+        atomic_fetch_sub(&stub_open_handles, 1);
+    }
+}
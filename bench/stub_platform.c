@@ -0,0 +1,129 @@
+// Stands in for src/linux/io.c, so the benches run without hardware. Readers are fed synthetic reports
+// as fast as they read while stub_producing is set, and idle otherwise.
+#include "stub_platform.h"
+#include "../src/transport.h"
+#include "../src/clock.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+_Atomic bool stub_producing = false;
+_Atomic uint64_t stub_reports = 0;
+
+struct transport {
+    uint8_t* buffer;
+    uint32_t size;
+    uint32_t sequence;
+};
+
+struct transport_cancel {
+    _Atomic bool raised;
+};
+
+struct io_loop {
+    _Atomic bool woken;
+};
+
+transport_t* transport_open(const char* path) {
+    atomic_fetch_add(&stub_open_handles, 1);
+    return calloc(1, sizeof(transport_t));
+}
+
+void transport_close(transport_t* transport) {
+    if(transport != NULL) {
+        atomic_fetch_sub(&stub_open_handles, 1);
+    }
+    free(transport);
+}
+
+transport_result_t transport_begin_read(transport_t* transport, uint8_t* buffer, const uint32_t size) {
+    transport->buffer = buffer;
+    transport->size = size;
+    return TRANSPORT_OK;
+}
+
+transport_result_t transport_wait(transport_t* transport, transport_cancel_t* cancel, const uint32_t timeout_ms) {
+    if(cancel != NULL && atomic_load(&cancel->raised)) {
+        return TRANSPORT_CANCELLED;
+    }
+
+    if(atomic_load_explicit(&stub_producing, memory_order_relaxed)) {
+        return TRANSPORT_OK;
+    }
+
+    // Short sleeps stand in for a wait a raised cancel would end
+    clock_sleep_ms(timeout_ms < 1 ? timeout_ms : 1);
+    return TRANSPORT_PENDING;
+}
+
+transport_result_t transport_complete_read(transport_t* transport, uint32_t* length) {
+    // A new card every report, so every read turns into a publish
+    transport->sequence++;
+    memset(transport->buffer, 0, transport->size);
+    transport->buffer[0] = 1;
+    memcpy(transport->buffer + 1, &transport->sequence, sizeof(transport->sequence));
+
+    atomic_fetch_add_explicit(&stub_reports, 1, memory_order_relaxed);
+    *length = 9;
+    return TRANSPORT_OK;
+}
+
+bool transport_ready(const transport_t* transport) {
+    return atomic_load_explicit(&stub_producing, memory_order_relaxed);
+}
+
+// The reports above are ISO15693 ones, declared the way a CardIO interface declares them
+bool transport_get_report_layout(transport_t* transport, report_layout_t* layout) {
+    *layout = (report_layout_t){.numbered = true};
+    report_layout_add(layout, 1, CARD_ID_SIZE * 8);
+    report_layout_add(layout, 2, CARD_ID_SIZE * 8);
+    return true;
+}
+
+transport_cancel_t* transport_cancel_create() {
+    atomic_fetch_add(&stub_open_handles, 1);
+    return calloc(1, sizeof(transport_cancel_t));
+}
+
+void transport_cancel(transport_cancel_t* cancel) {
+    atomic_store(&cancel->raised, true);
+}
+
+void transport_cancel_destroy(transport_cancel_t* cancel) {
+    if(cancel != NULL) {
+        atomic_fetch_sub(&stub_open_handles, 1);
+    }
+    free(cancel);
+}
+
+io_loop_t* io_loop_create() {
+    atomic_fetch_add(&stub_open_handles, 1);
+    return calloc(1, sizeof(io_loop_t));
+}
+
+bool io_loop_add(io_loop_t* loop, transport_t* transport) {
+    return true;
+}
+
+void io_loop_remove(io_loop_t* loop, transport_t* transport) {
+}
+
+void io_loop_wait(io_loop_t* loop, const uint64_t deadline_us) {
+    for(int i = 0; i < 10 && !atomic_load_explicit(&stub_producing, memory_order_relaxed); i++) {
+        if(atomic_exchange(&loop->woken, false)) {
+            return;
+        }
+        clock_sleep_ms(1);
+    }
+}
+
+void io_loop_wake(io_loop_t* loop) {
+    atomic_store(&loop->woken, true);
+}
+
+void io_loop_destroy(io_loop_t* loop) {
+    if(loop != NULL) {
+        atomic_fetch_sub(&stub_open_handles, 1);
+    }
+    free(loop);
+}
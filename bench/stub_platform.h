@@ -0,0 +1,18 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#define STUB_UNIT_COUNT 2
+
+// While set, every stub reader completes a read with a new card as soon as it asks for one
+extern _Atomic bool stub_producing;
+// Reports handed out to stub readers so far
+extern _Atomic uint64_t stub_reports;
+// Transports, loops, cancel signals and the keypad and hotplug watchers currently open
+extern _Atomic int stub_open_handles;
+// How many readers get_devices() finds, STUB_UNIT_COUNT unless a bench changes it before init()
+extern int stub_device_count;
+// printf format of each reader's CardIO path, given the unit index
+extern const char* stub_cardio_path_format;
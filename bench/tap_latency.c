@@ -0,0 +1,183 @@
+// Times taps and key presses end to end against a virtual AIC Pico (see uhid_reader.h) and the real Linux
+// platform layer. A tap is timed from its CardIO report going into uhid until eam_io_read_card() returns
+// its ID after an eam_io_poll(), a press from its keypad report until eam_io_get_keypad_state() shows the
+// edge. Every tap is a new card ID, which the presence machine publishes as soon as it arrives.
+// Prints p50/p99/p999 per kind and how many round trips per second went through, and exits non-zero
+// when a tap or an edge never shows up. Needs write access to /dev/uhid.
+//
+//   eamio_tap_latency [taps] [evdev|direct]
+#include "bench_thread.h"
+#include "samples.h"
+#include "uhid_reader.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TAP_PHYS "eamio-tap-latency"
+#define TAP_TIMEOUT_US 100000
+#define TAP_MAX_SAMPLES 100000
+
+uint8_t eam_io_read_card(uint8_t unit_no, uint8_t* card_id, uint8_t nbytes);
+uint16_t eam_io_get_keypad_state(uint8_t unit_no);
+bool eam_io_poll(uint8_t unit_no);
+
+typedef struct phase {
+    uint64_t samples[TAP_MAX_SAMPLES];
+    int count;
+    int missed;
+    uint64_t elapsed_us;
+} phase_t;
+
+static phase_t taps;
+static phase_t keys;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+// Polls back to back like a game frame would if it had no frame to wait for
+static uint64_t wait_for_card(const int unit, const uint8_t* id, const uint64_t sent) {
+    uint8_t card[CARD_ID_SIZE];
+    while(clock_now_us() - sent < TAP_TIMEOUT_US) {
+        eam_io_poll(unit);
+        if(eam_io_read_card(unit, card, sizeof(card)) != 0 && memcmp(card, id, CARD_ID_SIZE) == 0) {
+            return clock_now_us() - sent;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+static uint64_t wait_for_key(const int unit, const bool pressed, const uint64_t sent) {
+    while(clock_now_us() - sent < TAP_TIMEOUT_US) {
+        eam_io_poll(unit);
+        if(((eam_io_get_keypad_state(unit) >> EAM_IO_KEYPAD_1) & 1) == pressed) {
+            return clock_now_us() - sent;
+        }
+    }
+
+    return UINT64_MAX;
+}
+
+static void phase_record(phase_t* phase, const uint64_t latency) {
+    if(latency == UINT64_MAX) {
+        phase->missed++;
+    }
+    else {
+        phase->samples[phase->count++] = latency;
+    }
+}
+
+static void phase_print(const char* name, phase_t* phase, const bool last) {
+    printf("  ");
+    samples_print(name, "us", phase->samples, phase->count);
+    printf(",\n  \"%s_missed\": %d,\n  \"%s_per_s\": %.0f%s\n",
+        name, phase->missed, name, phase->elapsed_us > 0 ? phase->count * 1e6 / (double)phase->elapsed_us : 0.0, last ? "" : ",");
+}
+
+static int find_unit() {
+    const uint64_t start = clock_now_us();
+    while(get_unit_count() == 0 && clock_now_us() - start < 2000000) {
+        clock_sleep_ms(1);
+    }
+
+    // Other readers on the machine may come first
+    for(int i = 0; i < get_unit_count(); i++) {
+        if(strcmp(devices[i].location, TAP_PHYS) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+int main(int argc, char** argv) {
+    const int tap_count = argc > 1 ? atoi(argv[1]) : 1000;
+    const bool direct = argc > 2 && strcmp(argv[2], "direct") == 0;
+    if(tap_count <= 0 || tap_count * 2 > TAP_MAX_SAMPLES) {
+        fprintf(stderr, "taps must be between 1 and %d\n", TAP_MAX_SAMPLES / 2);
+        return EXIT_FAILURE;
+    }
+
+    uhid_reader_t reader;
+    if(!uhid_reader_create(&reader, TAP_PHYS)) {
+        fprintf(stderr, "Failed to create uhid devices, is /dev/uhid writable?\n");
+        return EXIT_FAILURE;
+    }
+
+    // udev needs a moment to create the nodes
+    clock_sleep_ms(500);
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_start(NULL);
+
+    // Cards stay until replaced, so every tap is published on arrival and none is dropped in between
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 60000000,
+        },
+        .keypad_direct = direct,
+    };
+    const int init_thread = create_thread(run_init, (void*)&config, 0x4000, 0);
+
+    const int unit = find_unit();
+    if(unit < 0) {
+        fprintf(stderr, "The virtual reader was not found\n");
+        request_stop();
+        join_thread(init_thread, NULL);
+        destroy_thread(init_thread);
+        fini();
+        uhid_reader_destroy(&reader);
+        return EXIT_FAILURE;
+    }
+
+    // Give the keypad time to be opened
+    clock_sleep_ms(200);
+
+    bool sent_all = true;
+    uint64_t start = clock_now_us();
+    for(int i = 0; i < tap_count && sent_all; i++) {
+        uint8_t id[CARD_ID_SIZE] = {0xE0, 0x04};
+        const uint32_t serial = (uint32_t)i + 1;
+        memcpy(id + 4, &serial, sizeof(serial));
+
+        const uint64_t sent = clock_now_us();
+        sent_all = uhid_reader_send_card(&reader, i % 2 == 0 ? CARD_TYPE_ISO15693 : CARD_TYPE_FELICA, id);
+        phase_record(&taps, wait_for_card(unit, id, sent));
+    }
+    taps.elapsed_us = clock_now_us() - start;
+
+    start = clock_now_us();
+    for(int i = 0; i < tap_count * 2 && sent_all; i++) {
+        const bool pressed = i % 2 == 0;
+        const uint64_t sent = clock_now_us();
+        sent_all = uhid_reader_send_keys(&reader, pressed ? UHID_READER_USAGE_KP1 : 0);
+        phase_record(&keys, wait_for_key(unit, pressed, sent));
+    }
+    keys.elapsed_us = clock_now_us() - start;
+
+    printf("{\n  \"benchmark\": \"tap_latency\",\n  \"keypad\": \"%s\",\n", direct ? "direct" : "evdev");
+    phase_print("taps", &taps, false);
+    phase_print("key_edges", &keys, true);
+    printf("}\n");
+
+    // Shut down before the virtual device goes, so the reader doesn't see it detach
+    request_stop();
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    fini();
+    uhid_reader_destroy(&reader);
+
+    if(!sent_all) {
+        fprintf(stderr, "Failed to send a report\n");
+    }
+    return sent_all && taps.missed == 0 && keys.missed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,258 @@
+// Fires taps of new cards 10 ms apart, each a 4 ms presence, against a game polling at 60 Hz, and checks
+// that every tap shows up through the card event queue, in order. Runs on the real Linux I/O code with the
+// reader's CardIO path a FIFO the bench writes reports into, and the library's default presence timing.
+// The game phase taps in bursts, since eam_io_poll() takes one event per frame and a queue only holds so
+// many. The drain phase taps without pause and empties the queue in batches through
+// eam_io_ext_drain_card_events() at the same 60 Hz. Prints one JSON object and exits non-zero when a tap
+// is lost or reordered.
+//
+//   eamio_tap_queue [bursts] [taps per burst] [drain seconds]
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/card_queue.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TAP_SPACING_US 10000
+#define TAP_PRESENCE_US 4000
+#define FRAME_US 16667
+// Game frames without a card before a burst counts as over
+#define SETTLE_FRAMES 30
+#define MAX_TAPS 100000
+// ISO15693 report ID the CardIO parser assumes when the FIFO has no descriptor to read
+#define REPORT_ISO15693 1
+
+int eam_io_ext_drain_card_events(uint8_t unit_no, card_event_t* events, int max_events);
+
+typedef struct phase {
+    const char* name;
+    int taps;
+    int seen;
+    int lost;
+    int reordered;
+    int max_batch;
+} phase_t;
+
+static int writer = -1;
+static uint32_t serial = 0;
+static int burst_taps = 0;
+static _Atomic bool tapping = false;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+static void sleep_until_us(const uint64_t deadline) {
+    const struct timespec until = {
+        .tv_sec = (time_t)(deadline / 1000000),
+        .tv_nsec = (long)(deadline % 1000000) * 1000,
+    };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0) {
+    }
+}
+
+// A FIFO hands two waiting reports to one read(), which hidraw never does, so each waits for the last to be taken
+static bool write_report(const uint32_t id) {
+    int pending;
+    while(ioctl(writer, FIONREAD, &pending) == 0 && pending > 0) {
+        sched_yield();
+    }
+
+    uint8_t report[1 + CARD_ID_SIZE] = {REPORT_ISO15693};
+    if(id != 0) {
+        report[1] = 0xE0;
+        report[2] = 0x04;
+        memcpy(report + 5, &id, sizeof(id));
+    }
+
+    return write(writer, report, sizeof(report)) == sizeof(report);
+}
+
+// The serial a card event carries, 0 for anything else
+static uint32_t event_serial(const uint8_t* card_id) {
+    uint32_t id;
+    memcpy(&id, card_id + 4, sizeof(id));
+    return card_id[0] == 0xE0 && card_id[1] == 0x04 ? id : 0;
+}
+
+// Stands in for the reader: burst_taps new cards on the 10 ms grid, each taken away again after 4 ms
+static void* tap(void* param) {
+    uint64_t next = clock_now_us();
+    for(int i = 0; i < burst_taps; i++) {
+        sleep_until_us(next);
+        write_report(++serial);
+        sleep_until_us(next + TAP_PRESENCE_US);
+        write_report(0);
+        next += TAP_SPACING_US;
+    }
+
+    atomic_store(&tapping, false);
+    return NULL;
+}
+
+static void start_tapping(pthread_t* thread, const int taps) {
+    burst_taps = taps;
+    atomic_store(&tapping, true);
+    pthread_create(thread, NULL, tap, NULL);
+}
+
+// Counts an arriving serial against the one expected next
+static void expect(phase_t* phase, const uint32_t arrived, uint32_t* expected) {
+    if(arrived == 0) {
+        return;
+    }
+
+    phase->seen++;
+    if(arrived < *expected) {
+        phase->reordered++;
+        return;
+    }
+
+    phase->lost += (int)(arrived - *expected);
+    *expected = arrived + 1;
+}
+
+// The game: one eam_io_poll() per frame, a tap is what eam_io_read_card() returns that it didn't last frame
+static void run_game(phase_t* phase, const int bursts, const int taps) {
+    uint8_t card[CARD_ID_SIZE];
+    uint32_t last = 0;
+    uint32_t expected = serial + 1;
+
+    for(int burst = 0; burst < bursts; burst++) {
+        pthread_t thread;
+        start_tapping(&thread, taps);
+
+        int idle_frames = 0;
+        uint64_t frame = clock_now_us();
+        while(atomic_load(&tapping) || idle_frames < SETTLE_FRAMES) {
+            frame += FRAME_US;
+            sleep_until_us(frame);
+
+            eam_io_poll(0);
+            const uint32_t current = eam_io_read_card(0, card, sizeof(card)) != 0 ? event_serial(card) : 0;
+            if(current != 0 && current != last) {
+                expect(phase, current, &expected);
+            }
+            idle_frames = current == 0 ? idle_frames + 1 : 0;
+            last = current;
+        }
+        pthread_join(thread, NULL);
+        phase->taps += taps;
+    }
+
+    phase->lost += (int)(serial + 1 - expected);
+}
+
+// A tool: every frame takes whatever is queued
+static void run_drain(phase_t* phase, const int taps) {
+    card_event_t events[CARD_QUEUE_SIZE];
+    uint32_t expected = serial + 1;
+    pthread_t thread;
+    start_tapping(&thread, taps);
+
+    int idle_frames = 0;
+    uint64_t frame = clock_now_us();
+    while(atomic_load(&tapping) || idle_frames < SETTLE_FRAMES) {
+        frame += FRAME_US;
+        sleep_until_us(frame);
+
+        const int count = eam_io_ext_drain_card_events(0, events, CARD_QUEUE_SIZE);
+        for(int i = 0; i < count; i++) {
+            if(events[i].type == CARD_EVENT_PRESENT) {
+                expect(phase, event_serial(events[i].card + 1), &expected);
+            }
+        }
+        phase->max_batch = count > phase->max_batch ? count : phase->max_batch;
+        idle_frames = count == 0 ? idle_frames + 1 : 0;
+    }
+    pthread_join(thread, NULL);
+
+    phase->taps = taps;
+    phase->lost += (int)(serial + 1 - expected);
+}
+
+int main(int argc, char** argv) {
+    const int bursts = argc > 1 ? atoi(argv[1]) : 4;
+    const int taps = argc > 2 ? atoi(argv[2]) : 40;
+    const int drain_seconds = argc > 3 ? atoi(argv[3]) : 5;
+    const int drain_taps = drain_seconds * (1000000 / TAP_SPACING_US);
+    if(bursts < 1 || taps < 1 || bursts * taps > MAX_TAPS || drain_seconds < 1 || drain_taps > MAX_TAPS) {
+        fprintf(stderr, "usage: eamio_tap_queue [bursts] [taps per burst] [drain seconds], at most %d taps each\n", MAX_TAPS);
+        return EXIT_FAILURE;
+    }
+
+    char directory[] = "/tmp/eamio-tap-queue-XXXXXX";
+    if(mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Failed to create a directory for the FIFO\n");
+        return EXIT_FAILURE;
+    }
+
+    char path[sizeof(directory) + 16];
+    snprintf(path, sizeof(path), "%s/reader", directory);
+    if(mkfifo(path, 0600) != 0 || (writer = open(path, O_RDWR | O_NONBLOCK)) < 0) {
+        fprintf(stderr, "Failed to create %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    stub_device_count = 1;
+    stub_cardio_path_format = path;
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_start(NULL);
+
+    // What eamio.conf defaults to, back to back taps replace each other before their removal counts
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = 100000,
+            .hold_us = 2000000,
+            .retap_extends = true,
+        },
+    };
+    const int init_thread = create_thread(run_init, (void*)&config, 0x4000, 0);
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+
+    phase_t game = {.name = "game_poll"};
+    phase_t drain = {.name = "ext_drain"};
+    const bool found = get_unit_count() == 1;
+    if(found) {
+        run_game(&game, bursts, taps);
+        run_drain(&drain, drain_taps);
+    }
+    else {
+        fprintf(stderr, "The reader was not found\n");
+    }
+
+    request_stop();
+    fini();
+    log_stop();
+    close(writer);
+    unlink(path);
+    rmdir(directory);
+
+    printf("{\n  \"benchmark\": \"tap_queue\",\n  \"tap_spacing_ms\": %d,\n  \"poll_hz\": 60,\n  \"phases\": [", TAP_SPACING_US / 1000);
+    const phase_t* phases[] = {&game, &drain};
+    for(int i = 0; i < 2; i++) {
+        printf("%s\n    {\"phase\": \"%s\", \"taps\": %d, \"seen\": %d, \"lost\": %d, \"reordered\": %d, \"max_batch\": %d}",
+            i == 0 ? "" : ",", phases[i]->name, phases[i]->taps, phases[i]->seen, phases[i]->lost, phases[i]->reordered, phases[i]->max_batch);
+    }
+    printf("\n  ]\n}\n");
+
+    const bool passed = found && game.seen == game.taps && game.lost == 0 && game.reordered == 0
+        && drain.seen == drain.taps && drain.lost == 0 && drain.reordered == 0;
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
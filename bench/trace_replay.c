@@ -0,0 +1,311 @@
+// Round trip and throughput of the record-and-replay trace. Records a session of taps on two readers
+// (FIFOs the bench writes CardIO reports into, on the real Linux I/O code) and key presses, checks the
+// file holds every report and key in order, replays it at recorded speed and requires the same card
+// events per unit as the live session. Then writes a large synthetic trace and replays it as fast as
+// possible, reporting the records/s and card events the replay logs. Prints one JSON object and exits
+// non-zero when the file, the replayed events or the fast replay's card events are off.
+//
+//   eamio_trace_replay [taps] [fast taps]
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/card_queue.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/trace.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <fcntl.h>
+#include <sched.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define READERS 2
+#define TAP_SPACING_MS 10
+#define TAP_PRESENCE_MS 4
+#define MAX_TAPS 10000
+#define MAX_FAST_TAPS 10000000
+#define DRAIN_MS 5
+// ISO15693 report ID the CardIO parser assumes when the FIFO has no descriptor to read
+#define REPORT_ISO15693 1
+// KP0 in the evdev keymap the stub keypad defaults to
+#define KEY_CODE 82
+
+int eam_io_ext_drain_card_events(uint8_t unit_no, card_event_t* events, int max_events);
+
+// Card events as (type, serial) per unit, in the order drained
+typedef struct event_log {
+    uint32_t events[READERS][MAX_TAPS * 2];
+    int counts[READERS];
+} event_log_t;
+
+static event_log_t live;
+static event_log_t replayed;
+static int writers[READERS];
+
+// Filled in from the fast replay's own log lines
+static _Atomic bool replay_done = false;
+static unsigned long long replay_records = 0;
+static unsigned long long replay_us = 0;
+static unsigned long long replay_card_events = 0;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+static void capture_log(const char* module, const char* fmt, ...) {
+    char line[256];
+    va_list args;
+    va_start(args, fmt);
+    vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+
+    const char* text = strstr(line, "Replay");
+    if(text == NULL) {
+        return;
+    }
+    if(sscanf(text, "Replayed %llu records in %llu us", &replay_records, &replay_us) == 2) {
+        return;
+    }
+    if(sscanf(text, "Replay produced %llu card events", &replay_card_events) == 1) {
+        atomic_store(&replay_done, true);
+    }
+}
+
+// A FIFO hands two waiting reports to one read(), which hidraw never does, so each waits for the last to be taken
+static void write_report(const int unit, const uint32_t serial) {
+    int pending;
+    while(ioctl(writers[unit], FIONREAD, &pending) == 0 && pending > 0) {
+        sched_yield();
+    }
+
+    uint8_t report[1 + CARD_ID_SIZE] = {REPORT_ISO15693};
+    if(serial != 0) {
+        report[1] = 0xE0;
+        report[2] = 0x04;
+        memcpy(report + 5, &serial, sizeof(serial));
+    }
+    write(writers[unit], report, sizeof(report));
+}
+
+static void drain(event_log_t* log) {
+    card_event_t events[CARD_QUEUE_SIZE];
+    for(int unit = 0; unit < READERS; unit++) {
+        const int count = eam_io_ext_drain_card_events(unit, events, CARD_QUEUE_SIZE);
+        for(int i = 0; i < count && log->counts[unit] < MAX_TAPS * 2; i++) {
+            uint32_t serial;
+            memcpy(&serial, events[i].card + 5, sizeof(serial));
+            log->events[unit][log->counts[unit]++] = (uint32_t)events[i].type << 24 | (serial & 0xFFFFFF);
+        }
+    }
+}
+
+static int drained(const event_log_t* log) {
+    int total = 0;
+    for(int unit = 0; unit < READERS; unit++) {
+        total += log->counts[unit];
+    }
+
+    return total;
+}
+
+static bool start(aic_config_t* config) {
+    const int init_thread = create_thread(run_init, config, 0x4000, 0);
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    return get_unit_count() == READERS;
+}
+
+// Taps alternate between the readers, every tap on reader 0 also presses and releases KP0
+static bool record_session(aic_config_t* config, const int taps) {
+    if(!start(config)) {
+        fini();
+        return false;
+    }
+
+    for(int i = 0; i < taps; i++) {
+        const int unit = i % READERS;
+        write_report(unit, (uint32_t)i + 1);
+        if(unit == 0) {
+            update_keypad_state(0, KEY_CODE, true);
+        }
+        clock_sleep_ms(TAP_PRESENCE_MS);
+        write_report(unit, 0);
+        if(unit == 0) {
+            update_keypad_state(0, KEY_CODE, false);
+        }
+        clock_sleep_ms(TAP_SPACING_MS - TAP_PRESENCE_MS);
+        drain(&live);
+    }
+
+    // Until the last removal went through
+    for(int i = 0; i < 200 && drained(&live) < taps * 2; i++) {
+        clock_sleep_ms(DRAIN_MS);
+        drain(&live);
+    }
+
+    request_stop();
+    fini();
+    return true;
+}
+
+// Every report and key the session produced is in the file, in order
+static bool check_file(const char* path, const int taps, int* card_reports, int* keys) {
+    trace_reader_t reader;
+    if(!trace_open(&reader, path)) {
+        return false;
+    }
+
+    trace_record_t record;
+    const uint8_t* payload;
+    uint64_t previous = 0;
+    bool ordered = reader.unit_count == READERS;
+    while(trace_next(&reader, &record, &payload)) {
+        ordered = ordered && record.timestamp_us >= previous && record.unit < READERS;
+        previous = record.timestamp_us;
+        *card_reports += record.type == TRACE_CARD_REPORT;
+        *keys += record.type == TRACE_KEY;
+    }
+    trace_close(&reader);
+
+    return ordered && *card_reports == taps * 2 && *keys == (taps + 1) / 2 * 2;
+}
+
+static bool replay_session(aic_config_t* config, const int expected) {
+    if(!start(config)) {
+        fini();
+        return false;
+    }
+
+    const uint64_t started = clock_now_us();
+    while(drained(&replayed) < expected && clock_now_us() - started < (uint64_t)expected * TAP_SPACING_MS * 1000 + 2000000) {
+        clock_sleep_ms(DRAIN_MS);
+        drain(&replayed);
+    }
+
+    request_stop();
+    fini();
+    return true;
+}
+
+// A new card on each reader in turn every millisecond, taken away half a millisecond later, and a key per tap
+static void write_fast_trace(const char* path, const int taps) {
+    trace_start(path, READERS);
+    uint8_t report[1 + CARD_ID_SIZE] = {REPORT_ISO15693, 0xE0, 0x04};
+    const uint8_t removed[1 + CARD_ID_SIZE] = {REPORT_ISO15693};
+    for(int i = 0; i < taps; i++) {
+        const uint64_t now = (uint64_t)i * 1000;
+        const uint32_t serial = (uint32_t)i + 1;
+        memcpy(report + 5, &serial, sizeof(serial));
+
+        trace_card_report(i % READERS, now, report, sizeof(report));
+        trace_key(i % READERS, now, KEY_CODE, true);
+        trace_card_report(i % READERS, now + 500, removed, sizeof(removed));
+        trace_key(i % READERS, now + 500, KEY_CODE, false);
+    }
+    trace_stop();
+}
+
+int main(int argc, char** argv) {
+    const int taps = argc > 1 ? atoi(argv[1]) : 200;
+    const int fast_taps = argc > 2 ? atoi(argv[2]) : 250000;
+    if(taps < 1 || taps > MAX_TAPS || fast_taps < 1 || fast_taps > MAX_FAST_TAPS) {
+        fprintf(stderr, "usage: eamio_trace_replay [taps, 1-%d] [fast taps, 1-%d]\n", MAX_TAPS, MAX_FAST_TAPS);
+        return EXIT_FAILURE;
+    }
+
+    char directory[] = "/tmp/eamio-trace-XXXXXX";
+    if(mkdtemp(directory) == NULL) {
+        fprintf(stderr, "Failed to create a directory for the traces\n");
+        return EXIT_FAILURE;
+    }
+
+    char path_format[sizeof(directory) + 16];
+    char trace_path[sizeof(directory) + 16];
+    char fast_path[sizeof(directory) + 16];
+    snprintf(path_format, sizeof(path_format), "%s/reader-%%d", directory);
+    snprintf(trace_path, sizeof(trace_path), "%s/session", directory);
+    snprintf(fast_path, sizeof(fast_path), "%s/fast", directory);
+    for(int i = 0; i < READERS; i++) {
+        char path[sizeof(path_format) + 8];
+        snprintf(path, sizeof(path), path_format, i);
+        if(mkfifo(path, 0600) != 0 || (writers[i] = open(path, O_RDWR | O_NONBLOCK)) < 0) {
+            fprintf(stderr, "Failed to create %s\n", path);
+            return EXIT_FAILURE;
+        }
+    }
+
+    stub_device_count = READERS;
+    stub_cardio_path_format = path_format;
+    eam_io_set_loggers(bench_discard_log, capture_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+    log_runtime_level = LOG_LEVEL_INFO;
+    log_start(NULL);
+
+    // Every tap is a present and a removed event
+    aic_config_t config = {
+        .presence = {
+            .retap_extends = true,
+        },
+        .trace_record_path = trace_path,
+    };
+    const bool recorded = record_session(&config, taps);
+
+    int card_reports = 0;
+    int keys = 0;
+    const bool file_complete = recorded && check_file(trace_path, taps, &card_reports, &keys);
+
+    config.trace_record_path = NULL;
+    config.trace_replay_path = trace_path;
+    const bool replayed_ok = file_complete && replay_session(&config, drained(&live));
+    bool events_match = replayed_ok;
+    for(int unit = 0; unit < READERS && events_match; unit++) {
+        events_match = live.counts[unit] == replayed.counts[unit]
+            && memcmp(live.events[unit], replayed.events[unit], live.counts[unit] * sizeof(uint32_t)) == 0;
+    }
+
+    uint64_t writing_us = clock_now_us();
+    write_fast_trace(fast_path, fast_taps);
+    writing_us = clock_now_us() - writing_us;
+    struct stat fast_stat = {0};
+    stat(fast_path, &fast_stat);
+
+    config.trace_replay_path = fast_path;
+    config.trace_replay_fast = true;
+    const bool fast_started = start(&config);
+    const uint64_t started = clock_now_us();
+    while(fast_started && !atomic_load(&replay_done) && clock_now_us() - started < 60000000) {
+        clock_sleep_ms(10);
+    }
+    request_stop();
+    fini();
+    const bool fast_ok = atomic_load(&replay_done) && replay_card_events == (unsigned long long)fast_taps * 2;
+
+    log_stop();
+    for(int i = 0; i < READERS; i++) {
+        char path[sizeof(path_format) + 8];
+        snprintf(path, sizeof(path), path_format, i);
+        close(writers[i]);
+        unlink(path);
+    }
+    unlink(trace_path);
+    unlink(fast_path);
+    rmdir(directory);
+
+    printf("{\n  \"benchmark\": \"trace_replay\",\n  \"taps\": %d,\n  \"card_reports_recorded\": %d,\n  \"keys_recorded\": %d,\n  \"file_complete\": %s,\n",
+        taps, card_reports, keys, file_complete ? "true" : "false");
+    printf("  \"live_card_events\": %d,\n  \"replayed_card_events\": %d,\n  \"events_match\": %s,\n",
+        drained(&live), drained(&replayed), events_match ? "true" : "false");
+    printf("  \"fast_records\": %llu,\n  \"fast_trace_bytes\": %lld,\n  \"fast_write_records_per_s\": %.0f,\n",
+        replay_records, (long long)fast_stat.st_size, writing_us > 0 ? fast_taps * 4 * 1e6 / (double)writing_us : 0.0);
+    printf("  \"fast_replay_records_per_s\": %.0f,\n  \"fast_card_events\": %llu,\n  \"fast_card_events_expected\": %d\n}\n",
+        replay_us > 0 ? replay_records * 1e6 / (double)replay_us : 0.0, replay_card_events, fast_taps * 2);
+
+    return file_complete && events_match && fast_ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,93 @@
+#include "uhid_reader.h"
+#include "../src/report_parser.h"
+
+#include <fcntl.h>
+#include <linux/uhid.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+// Report IDs in cardio_descriptor, each report carries the 8 byte ID
+#define REPORT_ISO15693 1
+#define REPORT_FELICA 2
+
+static const uint8_t cardio_descriptor[] = {
+    0x06, 0xCA, 0xFF, 0x09, 0x01, 0xA1, 0x01,
+    0x85, 0x01, 0x09, 0x41, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x08, 0x81, 0x02,
+    0x85, 0x02, 0x09, 0x42, 0x15, 0x00, 0x26, 0xFF, 0x00, 0x75, 0x08, 0x95, 0x08, 0x81, 0x02,
+    0xC0,
+};
+
+// Boot keyboard: modifiers, reserved, 6 usages
+static const uint8_t keypad_descriptor[] = {
+    0x05, 0x01, 0x09, 0x06, 0xA1, 0x01,
+    0x05, 0x07, 0x19, 0xE0, 0x29, 0xE7, 0x15, 0x00, 0x25, 0x01, 0x75, 0x01, 0x95, 0x08, 0x81, 0x02,
+    0x95, 0x01, 0x75, 0x08, 0x81, 0x01,
+    0x95, 0x06, 0x75, 0x08, 0x15, 0x00, 0x25, 0x65, 0x05, 0x07, 0x19, 0x00, 0x29, 0x65, 0x81, 0x00,
+    0xC0,
+};
+
+static int create_interface(const char* name, const char* phys, const int interface, const uint8_t* descriptor, const size_t descriptor_size) {
+    const int fd = open("/dev/uhid", O_RDWR | O_CLOEXEC);
+    if(fd < 0) {
+        return -1;
+    }
+
+    struct uhid_event event = {.type = UHID_CREATE2};
+    snprintf((char*)event.u.create2.name, sizeof(event.u.create2.name), "%s", name);
+    const int phys_length = snprintf((char*)event.u.create2.phys, sizeof(event.u.create2.phys), "%s/input%d", phys, interface);
+    if(phys_length < 0 || (size_t)phys_length >= sizeof(event.u.create2.phys)) {
+        close(fd);
+        return -1;
+    }
+    memcpy(event.u.create2.rd_data, descriptor, descriptor_size);
+    event.u.create2.rd_size = (uint16_t)descriptor_size;
+    event.u.create2.bus = BUS_USB;
+    event.u.create2.vendor = 0xCAFF;
+    event.u.create2.product = 0x400E;
+
+    if(write(fd, &event, sizeof(event)) != sizeof(event)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+bool uhid_reader_create(uhid_reader_t* reader, const char* phys) {
+    reader->cardio_fd = create_interface("eamio virtual CardIO", phys, 0, cardio_descriptor, sizeof(cardio_descriptor));
+    reader->keypad_fd = create_interface("eamio virtual keypad", phys, 1, keypad_descriptor, sizeof(keypad_descriptor));
+    if(reader->cardio_fd < 0 || reader->keypad_fd < 0) {
+        uhid_reader_destroy(reader);
+        return false;
+    }
+
+    return true;
+}
+
+void uhid_reader_destroy(uhid_reader_t* reader) {
+    if(reader->cardio_fd >= 0) {
+        close(reader->cardio_fd);
+        reader->cardio_fd = -1;
+    }
+
+    if(reader->keypad_fd >= 0) {
+        close(reader->keypad_fd);
+        reader->keypad_fd = -1;
+    }
+}
+
+bool uhid_reader_send_card(const uhid_reader_t* reader, const uint8_t type, const uint8_t* id) {
+    struct uhid_event event = {.type = UHID_INPUT2};
+    event.u.input2.size = 1 + CARD_ID_SIZE;
+    event.u.input2.data[0] = type == CARD_TYPE_FELICA ? REPORT_FELICA : REPORT_ISO15693;
+    memcpy(event.u.input2.data + 1, id, CARD_ID_SIZE);
+    return write(reader->cardio_fd, &event, sizeof(event)) == sizeof(event);
+}
+
+bool uhid_reader_send_keys(const uhid_reader_t* reader, const uint8_t usage) {
+    struct uhid_event event = {.type = UHID_INPUT2};
+    event.u.input2.size = 8;
+    event.u.input2.data[2] = usage;
+    return write(reader->keypad_fd, &event, sizeof(event)) == sizeof(event);
+}
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// HID usage of KP1 in the boot keyboard report the virtual keypad sends
+#define UHID_READER_USAGE_KP1 0x59
+
+// A virtual AIC Pico made through /dev/uhid: the CardIO interface on MI_00 and the boot keyboard
+// keypad on MI_01, both under HID_PHYS "<phys>/inputN" with the real VID/PID, so get_devices()
+// groups them into one unit with location phys. Needs write access to /dev/uhid.
+typedef struct uhid_reader {
+    int cardio_fd;
+    int keypad_fd;
+} uhid_reader_t;
+
+bool uhid_reader_create(uhid_reader_t* reader, const char* phys);
+// Closing the uhid descriptors unplugs both interfaces
+void uhid_reader_destroy(uhid_reader_t* reader);
+// type is CARD_TYPE_ISO15693 or CARD_TYPE_FELICA. An all-zero id is how the reader reports the field empty.
+bool uhid_reader_send_card(const uhid_reader_t* reader, uint8_t type, const uint8_t* id);
+// Holds usage down alone, 0 releases everything
+bool uhid_reader_send_keys(const uhid_reader_t* reader, uint8_t usage);
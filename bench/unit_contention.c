@@ -0,0 +1,216 @@
+// Checks that stations don't slow each other down through shared cache lines. Every stub reader publishes
+// as fast as it reads, and each station gets a game thread polling its unit and a keypad thread pressing
+// its keys. Station 0 is timed alone, then all stations at once, and the per-station rate of both is
+// reported. As a control the same threads bump counters packed next to each other and counters a cache
+// line apart, which shows what false sharing costs on the machine. Only means something with a core per
+// thread, so with fewer online CPUs than two per station it reports itself skipped and exits zero.
+// Prints one JSON object and exits non-zero when a station never sees a card.
+//
+//   eamio_bench_unit_contention [stations]
+#include "bench_thread.h"
+#include "stub_platform.h"
+#include "../src/aic.h"
+#include "../src/clock.h"
+#include "../src/library.h"
+#include "../src/log.h"
+#include "../src/bemanitools/eamio.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define MAX_STATIONS 16
+#define PHASE_MS 1000
+#define CACHE_LINE_SIZE 64
+// play() and press()
+#define THREADS_PER_STATION 2
+// KP0 in the evdev keymap the stub keypad defaults to
+#define KEY_CODE 82
+
+typedef struct station {
+    _Alignas(CACHE_LINE_SIZE) int unit;
+    uint64_t polls;
+    uint64_t cards;
+} station_t;
+
+typedef struct packed_counter {
+    _Atomic uint64_t value;
+} packed_counter_t;
+
+typedef struct padded_counter {
+    _Alignas(CACHE_LINE_SIZE) _Atomic uint64_t value;
+} padded_counter_t;
+
+static station_t stations[MAX_STATIONS];
+static packed_counter_t packed[MAX_STATIONS];
+static padded_counter_t padded[MAX_STATIONS];
+static _Atomic bool running = false;
+
+static int run_init(void* param) {
+    return init(param);
+}
+
+// What the game does for its unit every frame, only without waiting for the next frame
+static void* play(void* param) {
+    station_t* station = param;
+    uint8_t card[CARD_ID_SIZE];
+    while(atomic_load_explicit(&running, memory_order_relaxed)) {
+        eam_io_poll(station->unit);
+        station->cards += eam_io_read_card(station->unit, card, sizeof(card)) != 0;
+        eam_io_get_keypad_state(station->unit);
+        station->polls++;
+    }
+
+    return NULL;
+}
+
+// Stands in for the keypad's input path, the only writer of the unit's key state
+static void* press(void* param) {
+    const station_t* station = param;
+    bool pressed = false;
+    while(atomic_load_explicit(&running, memory_order_relaxed)) {
+        pressed = !pressed;
+        update_keypad_state(station->unit, KEY_CODE, pressed);
+    }
+
+    return NULL;
+}
+
+// Polls per second per station with the first count stations running
+static double run_stations(const int count) {
+    pthread_t players[MAX_STATIONS];
+    pthread_t pressers[MAX_STATIONS];
+    for(int i = 0; i < count; i++) {
+        stations[i].polls = 0;
+    }
+
+    atomic_store(&running, true);
+    for(int i = 0; i < count; i++) {
+        pthread_create(&players[i], NULL, play, &stations[i]);
+        pthread_create(&pressers[i], NULL, press, &stations[i]);
+    }
+    clock_sleep_ms(PHASE_MS);
+    atomic_store(&running, false);
+
+    uint64_t polls = 0;
+    for(int i = 0; i < count; i++) {
+        pthread_join(players[i], NULL);
+        pthread_join(pressers[i], NULL);
+        polls += stations[i].polls;
+    }
+
+    return (double)polls * 1000.0 / PHASE_MS / count;
+}
+
+static void* bump_packed(void* param) {
+    packed_counter_t* counter = param;
+    while(atomic_load_explicit(&running, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+static void* bump_padded(void* param) {
+    padded_counter_t* counter = param;
+    while(atomic_load_explicit(&running, memory_order_relaxed)) {
+        atomic_fetch_add_explicit(&counter->value, 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+// Increments per second per thread, one thread per counter
+static double run_counters(const int count, const bool pad) {
+    pthread_t threads[MAX_STATIONS];
+    atomic_store(&running, true);
+    for(int i = 0; i < count; i++) {
+        if(pad) {
+            atomic_store(&padded[i].value, 0);
+            pthread_create(&threads[i], NULL, bump_padded, &padded[i]);
+        }
+        else {
+            atomic_store(&packed[i].value, 0);
+            pthread_create(&threads[i], NULL, bump_packed, &packed[i]);
+        }
+    }
+    clock_sleep_ms(PHASE_MS);
+    atomic_store(&running, false);
+
+    uint64_t increments = 0;
+    for(int i = 0; i < count; i++) {
+        pthread_join(threads[i], NULL);
+        increments += pad ? atomic_load(&padded[i].value) : atomic_load(&packed[i].value);
+    }
+
+    return (double)increments * 1000.0 / PHASE_MS / count;
+}
+
+int main(int argc, char** argv) {
+    const int count = argc > 1 ? atoi(argv[1]) : 4;
+    if(count < 2 || count > MAX_STATIONS) {
+        fprintf(stderr, "usage: eamio_bench_unit_contention [stations, 2-%d]\n", MAX_STATIONS);
+        return EXIT_FAILURE;
+    }
+
+    // A game and a keypad thread per station, with fewer cores they take turns and nothing is contended
+    const long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if(cpus < THREADS_PER_STATION * count) {
+        fprintf(stderr, "Skipped: %d stations need %d online CPUs, this machine has %ld\n", count, THREADS_PER_STATION * count, cpus);
+        printf("{\n  \"benchmark\": \"unit_contention\",\n  \"stations\": %d,\n  \"cpus\": %ld,\n  \"skipped\": true\n}\n", count, cpus);
+        return EXIT_SUCCESS;
+    }
+
+    eam_io_set_loggers(bench_discard_log, bench_discard_log, bench_discard_log, bench_discard_log);
+    bench_use_threads();
+
+    // Queue overflow warnings would otherwise dominate
+    log_runtime_level = LOG_LEVEL_ERROR;
+    log_start(NULL);
+
+    stub_device_count = count;
+    static aic_config_t config = {
+        .presence = {
+            .retap_extends = true,
+        },
+    };
+    const int init_thread = create_thread(run_init, &config, 0x4000, 0);
+    join_thread(init_thread, NULL);
+    destroy_thread(init_thread);
+    if(get_unit_count() != count) {
+        fprintf(stderr, "Expected %d units, found %d\n", count, get_unit_count());
+        fini();
+        log_stop();
+        return EXIT_FAILURE;
+    }
+
+    for(int i = 0; i < count; i++) {
+        stations[i].unit = i;
+    }
+
+    atomic_store(&stub_producing, true);
+    const double alone = run_stations(1);
+    const double together = run_stations(count);
+    atomic_store(&stub_producing, false);
+
+    bool passed = true;
+    for(int i = 0; i < count; i++) {
+        passed = passed && stations[i].cards > 0;
+    }
+
+    request_stop();
+    fini();
+    log_stop();
+
+    const double packed_rate = run_counters(count, false);
+    const double padded_rate = run_counters(count, true);
+
+    printf("{\n  \"benchmark\": \"unit_contention\",\n  \"stations\": %d,\n  \"cpus\": %ld,\n  \"skipped\": false,\n", count, cpus);
+    printf("  \"polls_per_s_alone\": %.0f,\n  \"polls_per_s_per_station_together\": %.0f,\n  \"together_vs_alone\": %.3f,\n",
+        alone, together, alone > 0 ? together / alone : 0.0);
+    printf("  \"control_packed_increments_per_s\": %.0f,\n  \"control_padded_increments_per_s\": %.0f,\n  \"every_station_saw_cards\": %s\n}\n",
+        packed_rate, padded_rate, passed ? "true" : "false");
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
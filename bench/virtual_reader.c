@@ -0,0 +1,117 @@
+// Plugs a virtual AIC Pico in through uhid (see uhid_reader.h) and plays a script from stdin against
+// it, one command per line:
+//
+//   card iso|felica <16 hex digits>   a card enters the field
+//   empty                             the field is empty again
+//   key <usage, hex>                  holds one keypad usage down alone, key 0 lets go
+//   sleep <ms>
+//   unplug, plug                      removes or recreates both interfaces
+//
+// Blank lines and lines starting with # are skipped. Each command is echoed to stderr with the
+// clock_now_us() it was sent at. The reader is unplugged once stdin ends.
+//
+//   eamio_virtual_reader [phys]
+#include "uhid_reader.h"
+#include "../src/clock.h"
+#include "../src/report_parser.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define VIRTUAL_READER_PHYS "eamio-virtual-reader"
+
+static bool parse_id(const char* hex, uint8_t* id) {
+    if(strlen(hex) != CARD_ID_SIZE * 2) {
+        return false;
+    }
+
+    for(int i = 0; i < CARD_ID_SIZE; i++) {
+        unsigned int byte;
+        if(sscanf(hex + i * 2, "%2x", &byte) != 1) {
+            return false;
+        }
+        id[i] = (uint8_t)byte;
+    }
+
+    return true;
+}
+
+static bool run_command(uhid_reader_t* reader, const char* phys, char* line) {
+    char* command = strtok(line, " \t\r\n");
+    if(command == NULL || command[0] == '#') {
+        return true;
+    }
+    char* argument = strtok(NULL, " \t\r\n");
+    char* second = strtok(NULL, " \t\r\n");
+
+    if(strcmp(command, "card") == 0) {
+        uint8_t id[CARD_ID_SIZE];
+        if(argument == NULL || second == NULL || !parse_id(second, id)) {
+            return false;
+        }
+        return uhid_reader_send_card(reader, strcmp(argument, "felica") == 0 ? CARD_TYPE_FELICA : CARD_TYPE_ISO15693, id);
+    }
+
+    if(strcmp(command, "empty") == 0) {
+        const uint8_t id[CARD_ID_SIZE] = {0};
+        return uhid_reader_send_card(reader, CARD_TYPE_ISO15693, id);
+    }
+
+    if(strcmp(command, "key") == 0) {
+        return argument != NULL && uhid_reader_send_keys(reader, (uint8_t)strtoul(argument, NULL, 16));
+    }
+
+    if(strcmp(command, "sleep") == 0) {
+        if(argument == NULL) {
+            return false;
+        }
+        clock_sleep_ms((uint32_t)strtoul(argument, NULL, 10));
+        return true;
+    }
+
+    if(strcmp(command, "unplug") == 0) {
+        uhid_reader_destroy(reader);
+        return true;
+    }
+
+    if(strcmp(command, "plug") == 0) {
+        return reader->cardio_fd >= 0 || uhid_reader_create(reader, phys);
+    }
+
+    return false;
+}
+
+int main(int argc, char** argv) {
+    const char* phys = argc > 1 ? argv[1] : VIRTUAL_READER_PHYS;
+
+    uhid_reader_t reader;
+    if(!uhid_reader_create(&reader, phys)) {
+        fprintf(stderr, "Failed to create uhid devices, is /dev/uhid writable?\n");
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "%llu plugged in as %s\n", (unsigned long long)clock_now_us(), phys);
+
+    char line[256];
+    int line_number = 0;
+    while(fgets(line, sizeof(line), stdin) != NULL) {
+        line_number++;
+
+        char echo[sizeof(line)];
+        memcpy(echo, line, sizeof(line));
+        echo[strcspn(echo, "\r\n")] = '\0';
+
+        const uint64_t sent = clock_now_us();
+        if(!run_command(&reader, phys, line)) {
+            fprintf(stderr, "Line %d: can't run \"%s\"\n", line_number, echo);
+            uhid_reader_destroy(&reader);
+            return EXIT_FAILURE;
+        }
+        if(echo[0] != '\0' && echo[0] != '#') {
+            fprintf(stderr, "%llu %s\n", (unsigned long long)sent, echo);
+        }
+    }
+
+    uhid_reader_destroy(&reader);
+    return EXIT_SUCCESS;
+}
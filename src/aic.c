@@ -1,410 +1,853 @@
+#include "aic.h"
 #include "device.h"
-#include "bemanitools/glue.h"
+#include "device_cache.h"
+#include "reader_state.h"
+#include "card_queue.h"
+#include "key_queue.h"
+#include "latency.h"
+#include "presence.h"
+#include "report_parser.h"
+#include "transport.h"
+#include "hotplug.h"
+#include "trace.h"
+#include "keypad.h"
+#include "keymap.h"
+#include "clock.h"
+#include "library.h"
+#include "log.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdbool.h>
 #include <stdint.h>
-#include <windows.h>
-#include <hidsdi.h>
-#include <hidpi.h>
-#include <setupapi.h>
-#include <initguid.h>
-#include <devpkey.h>
-
-#define KBD_DEVICE_USAGE_KEYBOARD 0x00010006
-#define KBD_DEVICE_USAGE_KEYPAD 0x00010007
+#include <stdatomic.h>
 
 static const int VID = 0xCAFF;
 static const int PID = 0x400E;
 static const int CARDIO_MI = 0;
 static const int KEYPAD_MI = 1;
-
-static HWND window = NULL;
-static uint16_t* keypad_states;
-static uint8_t reader_1_bytes[9];
-static bool reader_1_inserted = false;
-static uint8_t reader_2_bytes[9];
-static bool reader_2_inserted = false;
-static WNDPROC orig_proc = NULL;
+#define CACHE_LINE_SIZE 64
+// Longest a real-time replay sleeps before checking whether it should stop
+#define REPLAY_SLEEP_SLICE_MS 50
+
+// Everything one unit owns. Units are written by different threads, so each starts on its own cache line.
+typedef struct reader_unit {
+    _Alignas(CACHE_LINE_SIZE) int index;
+    transport_t* transport;
+    // Set up from the CardIO interface's report descriptor every time it is opened
+    report_parser_t parser;
+    _Atomic uint32_t malformed_reports;
+    presence_t presence;
+    reader_state_t state;
+    // Owned by a reader thread or the I/O loop, cleared once the device is gone
+    _Atomic bool attached;
+    // Reader thread in thread mode, -1 otherwise. Hotplug joins it before starting the next one, fini() joins the last.
+    int thread;
+    // Set by hotplug for the I/O loop, which does the reopening itself
+    _Atomic bool reattach_pending;
+    const keymap_t* keymap;
+    // Written by the keypad's input path: the level, every edge in order, and presses the queue had no room for
+    _Atomic uint16_t keypad_state;
+    _Atomic uint16_t keypad_latched;
+    key_queue_t keys;
+    // Every tap and removal in order, so taps shorter than the game's poll interval still show up
+    card_queue_t events;
+    // Only touched by the game's own eam_io_* calls
+    uint8_t sensor_state;
+    // Last event eam_io_poll() took off the queue, what the game currently sees
+    card_event_t latched;
+    uint64_t latched_at;
+    bool latched_read;
+    // What get_keypad_state() reports until the next eam_io_poll()
+    uint16_t keypad_view;
+    latency_histogram_t latency[LATENCY_STAGE_COUNT];
+} reader_unit_t;
+
+static void* unit_memory = NULL;
+static reader_unit_t* reader_units = NULL;
+// The readiness flag: published once every unit is set up and cleared first thing on shutdown,
+// the exports see no units while it is zero
+static _Atomic int unit_count = 0;
+static presence_config_t presence_config;
+static _Atomic(io_loop_t*) active_loop = NULL;
+static trace_reader_t replay_reader;
+// Set by request_stop(), init() and every thread it started return once they see it
+static _Atomic bool stopping = false;
+// Breaks reader threads out of transport_wait() on shutdown
+static transport_cancel_t* stop_signal = NULL;
+// run_io_loop() or replay_trace(), whichever init() started
+static int io_thread = -1;
 
 device_t* devices;
 int device_count = 0;
-log_formatter_t misc_logger;
+
+int get_unit_count() {
+    return atomic_load(&unit_count);
+}
 
 uint16_t get_keypad_state(int device_index) {
-    if(device_index >= device_count) {
+    if(device_index < 0 || device_index >= atomic_load(&unit_count)) {
         return 0;
     }
 
-    return keypad_states[device_index];
+    return reader_units[device_index].keypad_view;
+}
+
+static void set_keypad_bit(reader_unit_t* unit, const int bitmap_index, const bool pressed) {
+    // Each keypad has a single writer, so a plain load and store is enough
+    const uint16_t state = atomic_load_explicit(&unit->keypad_state, memory_order_relaxed);
+    const uint16_t new_state = (state & ~(1 << bitmap_index)) | (pressed << bitmap_index);
+    if(new_state == state) {
+        return;
+    }
+
+    // Level first, so a poll that finds the queue empty never follows the level to a state the queue has yet to reach
+    atomic_store_explicit(&unit->keypad_state, new_state, memory_order_release);
+
+    const key_event_t event = {
+        .timestamp_us = clock_now_us(),
+        .bit = (uint8_t)bitmap_index,
+        .pressed = pressed,
+    };
+    if(!key_queue_push(&unit->keys, &event) && pressed) {
+        // The game is a whole queue behind. The order is lost, but the press still shows for one poll.
+        atomic_fetch_or_explicit(&unit->keypad_latched, (uint16_t)(1 << bitmap_index), memory_order_release);
+    }
+}
+
+void update_keypad_state(int keypad_index, uint16_t key, bool pressed) {
+    if(keypad_index < 0 || keypad_index >= atomic_load(&unit_count)) {
+        return;
+    }
+
+    trace_key(keypad_index, clock_now_us(), key, pressed);
+
+    reader_unit_t* unit = &reader_units[keypad_index];
+    const int bitmap_index = keymap_lookup(unit->keymap, key);
+    if(bitmap_index < 0) {
+        return;
+    }
+
+    set_keypad_bit(unit, bitmap_index, pressed);
 }
 
-void update_keypad_state(int keypad_index, USHORT key, USHORT flags) {
-    uint8_t bitmap_index = 0;
-
-    switch(key) {
-        case 45:
-            bitmap_index = 0;
-        break;
-        case 109:
-            bitmap_index = 8;
-        break;
-        case 46:
-            bitmap_index = 4;
-        break;
-        case 35:
-            bitmap_index = 1;
-        break;
-        case 40:
-            bitmap_index = 5;
-        break;
-        case 34:
-            bitmap_index = 9;
-        break;
-        case 37:
-            bitmap_index = 2;
-        break;
-        case 12:
-            bitmap_index = 6;
-        break;
-        case 39:
-            bitmap_index = 10;
-        break;
-        case 36:
-            bitmap_index = 3;
-        break;
-        case 38:
-            bitmap_index = 7;
-        break;
-        case 33:
-            bitmap_index = 11;
-        break;
+void release_keypad(int keypad_index) {
+    if(keypad_index < 0 || keypad_index >= atomic_load(&unit_count)) {
+        return;
+    }
+
+    reader_unit_t* unit = &reader_units[keypad_index];
+    const uint16_t state = atomic_load_explicit(&unit->keypad_state, memory_order_relaxed);
+    for(int i = 0; i < 16; i++) {
+        if(state & (1 << i)) {
+            set_keypad_bit(unit, i, false);
+        }
+    }
+}
+
+// Applies queued key edges in order, but holds back any edge that would undo one this poll already
+// applied, so every press is down for at least one poll and every release up for at least one
+void poll_keypad(uint8_t unit_no) {
+    if(unit_no >= atomic_load(&unit_count)) {
+        return;
+    }
+
+    reader_unit_t* unit = &reader_units[unit_no];
+    uint16_t view = unit->keypad_view;
+    key_event_t event;
+
+    if(!key_queue_peek(&unit->keys, &event)) {
+        // Nothing queued, follow the level. It also undoes presses that only made it into the latch.
+        view = atomic_load_explicit(&unit->keypad_state, memory_order_acquire);
+    }
+    else {
+        const uint64_t now = clock_now_us();
+        uint16_t changed = 0;
+        do {
+            const uint16_t bit = (uint16_t)(1 << event.bit);
+            if(changed & bit) {
+                break;
+            }
+
+            view = event.pressed ? view | bit : view & ~bit;
+            changed |= bit;
+            if(event.pressed) {
+                latency_record(&unit->latency[LATENCY_KEYPAD_POLL], now - event.timestamp_us);
+            }
+            key_queue_skip(&unit->keys);
+        } while(key_queue_peek(&unit->keys, &event));
+    }
+
+    if(atomic_load_explicit(&unit->keypad_latched, memory_order_relaxed) != 0) {
+        view |= atomic_exchange_explicit(&unit->keypad_latched, 0, memory_order_acquire);
+    }
+
+    unit->keypad_view = view;
+}
+
+uint8_t get_sensor_state(uint8_t unit_no) {
+    if(unit_no >= atomic_load(&unit_count)) {
+        return 0;
+    }
+
+    return reader_units[unit_no].sensor_state;
+}
+
+void set_sensor_state(uint8_t unit_no, uint8_t state) {
+    if(unit_no >= atomic_load(&unit_count)) {
+        return;
+    }
+
+    reader_units[unit_no].sensor_state = state;
+}
+
+static void queue_card_event(reader_unit_t* unit, const card_event_type_t type, const uint64_t now) {
+    card_event_t event = {
+        .timestamp_us = now,
+        .type = type,
+    };
+    if(type == CARD_EVENT_PRESENT) {
+        memcpy(event.card, unit->presence.card, PRESENCE_CARD_SIZE);
+    }
+
+    if(!card_queue_push(&unit->events, &event)) {
+        log_warn("Card event queue for unit %d is full, dropping event\n", unit->index);
+    }
+}
+
+// The event is queued before the level is published, see poll_reader()
+static void apply_presence_action(reader_unit_t* unit, const presence_action_t action, const uint64_t now) {
+    switch(action) {
+        case PRESENCE_ACTION_PUBLISH_CARD:
+            queue_card_event(unit, CARD_EVENT_PRESENT, now);
+            reader_state_publish(&unit->state);
+            break;
+        case PRESENCE_ACTION_PUBLISH_CLEAR:
+            queue_card_event(unit, CARD_EVENT_REMOVED, now);
+            reader_state_clear(&unit->state);
+            break;
         default:
             return;
     }
 
-    uint8_t depressed = flags & RI_KEY_BREAK ? 0 : 1;
-    keypad_states[keypad_index] = (keypad_states[keypad_index] & ~(1 << bitmap_index)) | (depressed << bitmap_index);
-    printf("Keypad state: %d\n", keypad_states[keypad_index]);
+    // Replaying as fast as possible runs ahead of the clock, there is no latency to speak of then
+    const uint64_t published = clock_now_us();
+    if(published >= now) {
+        latency_record(&unit->latency[LATENCY_CARD_PUBLISH], published - now);
+    }
 }
 
-bool get_parent_device_id(const char* device_name, char* parent_id, size_t parent_id_size) {
-    HDEVINFO device_info_set = SetupDiGetClassDevs(NULL, device_name, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
-    if (device_info_set == INVALID_HANDLE_VALUE) {
-        printf("SetupDiGetClassDevs failed, error: %d\n", GetLastError());
+static bool begin_read(reader_unit_t* unit) {
+    reader_snapshot_t* snapshot = reader_state_back(&unit->state);
+    if(transport_begin_read(unit->transport, snapshot->report, sizeof(snapshot->report)) != TRANSPORT_OK) {
+        log_event(LOG_LEVEL_WARN, LOG_EVENT_READ_FAILED, unit->index, 0, NULL, 0);
         return false;
     }
 
-    SP_DEVINFO_DATA device_info_data = {0};
-    device_info_data.cbSize = sizeof(SP_DEVINFO_DATA);
+    return true;
+}
+
+// The report sits in the unit's back snapshot, put there by a read or by a replayed trace
+static void handle_report(reader_unit_t* unit, const uint64_t now) {
+    const reader_snapshot_t* snapshot = reader_state_back(&unit->state);
+    trace_card_report(unit->index, now, snapshot->report, snapshot->length);
+    log_event(LOG_LEVEL_DEBUG, LOG_EVENT_CARD_REPORT, unit->index, (int32_t)snapshot->length, snapshot->report, snapshot->length);
+
+    card_record_t card;
+    switch(report_parser_decode(&unit->parser, snapshot->report, snapshot->length, &card)) {
+        case REPORT_CARD:
+        case REPORT_NO_CARD:
+            apply_presence_action(unit, presence_on_report(&unit->presence, &card, now), now);
+            break;
+        case REPORT_MALFORMED:
+            // Only the reader's thread counts, the atomic is for dump_latency() reading along
+            if(atomic_fetch_add_explicit(&unit->malformed_reports, 1, memory_order_relaxed) == 0) {
+                log_warn("Device %d sent a malformed report (%u bytes, report ID %u), ignoring it and any more\n",
+                    unit->index, snapshot->length, snapshot->length > 0 ? snapshot->report[0] : 0);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// Returns false once the device is gone
+static bool complete_read(reader_unit_t* unit, const uint64_t now) {
+    uint32_t bytes_read = 0;
+    const transport_result_t result = transport_complete_read(unit->transport, &bytes_read);
+    if(result != TRANSPORT_OK) {
+        if(result == TRANSPORT_ERROR) {
+            log_event(LOG_LEVEL_WARN, LOG_EVENT_READ_FAILED, unit->index, 0, NULL, 0);
+            return false;
+        }
+        return true;
+    }
+
+    reader_state_back(&unit->state)->length = bytes_read;
+    handle_report(unit, now);
+    return true;
+}
+
+static uint64_t next_presence_deadline() {
+    uint64_t deadline = PRESENCE_NO_DEADLINE;
+    for(int i = 0; i < device_count; i++) {
+        const uint64_t unit_deadline = presence_deadline(&reader_units[i].presence);
+        if(unit_deadline < deadline) {
+            deadline = unit_deadline;
+        }
+    }
+
+    return deadline;
+}
+
+static uint32_t presence_timeout_ms(const reader_unit_t* unit, const uint64_t now) {
+    const uint64_t deadline = presence_deadline(&unit->presence);
+    if(deadline == PRESENCE_NO_DEADLINE) {
+        return TRANSPORT_INFINITE;
+    }
+
+    if(deadline <= now) {
+        return 0;
+    }
+
+    return (uint32_t)((deadline - now + 999) / 1000);
+}
 
-    if (!SetupDiEnumDeviceInfo(device_info_set, 0, &device_info_data)) {
-        printf("SetupDiEnumDeviceInfo failed, error: %d\n", GetLastError());
-        SetupDiDestroyDeviceInfoList(device_info_set);
+static bool open_reader(reader_unit_t* unit) {
+    unit->transport = transport_open(devices[unit->index].cardio_path);
+    if(unit->transport == NULL) {
+        log_error("Failed to open device %d\n", unit->index);
         return false;
     }
 
-    DEVPROPTYPE property_type;
-    if (!SetupDiGetDevicePropertyW(
-            device_info_set,
-            &device_info_data,
-            &DEVPKEY_Device_Parent,
-            &property_type,
-            (PBYTE)parent_id,
-            (DWORD)parent_id_size,
-            NULL,
-            0)) {
-        printf("SetupDiGetDeviceProperty failed, error: %d\n", GetLastError());
-        SetupDiDestroyDeviceInfoList(device_info_set);
+    report_layout_t layout;
+    if(!transport_get_report_layout(unit->transport, &layout) || !report_parser_init(&unit->parser, &layout)) {
+        log_warn("Device %d does not declare the usual CardIO reports, assuming them anyway\n", unit->index);
+        report_parser_init_cardio(&unit->parser);
+    }
+
+    if(!begin_read(unit)) {
+        transport_close(unit->transport);
+        unit->transport = NULL;
         return false;
     }
 
-    SetupDiDestroyDeviceInfoList(device_info_set);
     return true;
 }
 
-DWORD WINAPI scan(const LPVOID param) {
-    const int device_id = (int)param;
+// Drops a card that was on the reader when it went away, so the game does not see it stuck
+static void detach_reader(reader_unit_t* unit) {
+    log_warn("Device %d detached, waiting for it to come back\n", unit->index);
 
-    HANDLE file = CreateFile(
-        devices[device_id].cardio_path,
-        GENERIC_READ | GENERIC_WRITE,
-        FILE_SHARE_READ | FILE_SHARE_WRITE,
-        NULL,
-        OPEN_EXISTING,
-        0,
-        NULL
-    );
+    transport_close(unit->transport);
+    unit->transport = NULL;
+    presence_init(&unit->presence, &presence_config);
+    queue_card_event(unit, CARD_EVENT_REMOVED, clock_now_us());
+    reader_state_clear(&unit->state);
 
-    if(file == INVALID_HANDLE_VALUE) {
-        printf("Failed to open device %d, error: %d\n", device_id, GetLastError());
+    atomic_store(&unit->attached, false);
+}
+
+int scan(void* param) {
+    reader_unit_t* unit = &reader_units[(intptr_t)param];
+
+    if(!open_reader(unit)) {
+        atomic_store(&unit->attached, false);
+        return EXIT_FAILURE;
     }
 
+    // The read stays queued the whole time, so a new tap is picked up while the old one is still held
     while(true) {
-        uint8_t buffer[100] = {0};
-        DWORD bytesRead;
-        if(!ReadFile(file, buffer, sizeof(buffer), &bytesRead, NULL)) {
-            printf("Failed to read from device %d, error: %d\n", device_id, GetLastError());
+        const transport_result_t wait = transport_wait(unit->transport, stop_signal, presence_timeout_ms(unit, clock_now_us()));
+        const uint64_t now = clock_now_us();
+
+        if(wait == TRANSPORT_CANCELLED) {
+            // Shutting down rather than detached, so no removal is queued
+            transport_close(unit->transport);
+            unit->transport = NULL;
+            return EXIT_SUCCESS;
         }
 
-        printf("Device %d [%d bytes]: Card type: %d\n", device_id, bytesRead, buffer[0]);
-        for(auto j = 0; j < bytesRead; j++) {
-            if(device_id == 0) {
-                reader_1_bytes[j] = buffer[j];
-                reader_1_inserted = true;
-            }
-            else {
-                reader_2_bytes[j] = buffer[j];
-                reader_2_inserted = true;
-            }
-            printf("%02X", buffer[j]);
+        if(wait == TRANSPORT_ERROR) {
+            log_error("Failed to wait on device %d\n", unit->index);
+            break;
         }
-        putchar('\n');
 
-        Sleep(2000);
-        if(device_id == 0) {
-            memset(reader_1_bytes, 0, sizeof(reader_1_bytes));
-            reader_1_inserted = false;
-        }
-        else {
-            memset(reader_2_bytes, 0, sizeof(reader_2_bytes));
-            reader_2_inserted = false;
+        if(wait == TRANSPORT_OK && (!complete_read(unit, now) || !begin_read(unit))) {
+            break;
         }
+
+        apply_presence_action(unit, presence_on_timer(&unit->presence, now), now);
     }
 
-    return EXIT_SUCCESS;
+    // Hotplug starts a new thread for this unit once the device is back
+    detach_reader(unit);
+    return EXIT_FAILURE;
 }
 
-void ProcessRawInput(LPARAM lParam) {
-    RAWINPUT rawInput;
-    UINT dwSize;
-    char* device_name = NULL;
-
-    GetRawInputData((HRAWINPUT)lParam, RID_INPUT, NULL, &dwSize, sizeof(RAWINPUTHEADER));
-    BYTE* lpb = (BYTE*)malloc(dwSize);
+// Runs on the hotplug thread. Only the unit the interface belongs to is touched, the others keep reading.
+static void on_interface_arrival(const char* path) {
+    const int keypad_index = match_device(devices, device_count, path, VID, PID, KEYPAD_MI);
+    if(keypad_index >= 0 && keypad_index < atomic_load(&unit_count)) {
+        keypad_arrival(keypad_index, path);
+        return;
+    }
 
-    if (lpb == NULL) {
-        printf("Memory allocation failed\n");
-        goto END;
+    const int index = match_device(devices, device_count, path, VID, PID, CARDIO_MI);
+    if(index < 0 || index >= atomic_load(&unit_count)) {
+        return;
     }
 
-    if (GetRawInputData((HRAWINPUT)lParam, RID_INPUT, lpb, &dwSize, sizeof(RAWINPUTHEADER)) != dwSize) {
-        printf("GetRawInputData size mismatch\n");
-        goto END;
+    reader_unit_t* unit = &reader_units[index];
+    if(atomic_load(&unit->attached) || atomic_load(&unit->reattach_pending)) {
+        return;
     }
 
-    const RAWINPUT* raw = (RAWINPUT*)lpb;
+    // The node can come back under a different name, the unit slot stays the same
+    snprintf(devices[index].cardio_path, sizeof(devices[index].cardio_path), "%s", path);
+    log_info("Device %d arrived at %s, reattaching\n", index, path);
 
-    if (raw->header.dwType != RIM_TYPEKEYBOARD) {
-        goto END;
+    io_loop_t* loop = atomic_load(&active_loop);
+    if(loop != NULL) {
+        atomic_store(&unit->reattach_pending, true);
+        io_loop_wake(loop);
+        return;
     }
 
-    UINT name_size;
-    GetRawInputDeviceInfoA(raw->header.hDevice, RIDI_DEVICENAME, NULL, &name_size);
-    device_name = malloc(name_size);
-
-    if (!GetRawInputDeviceInfoA(raw->header.hDevice, RIDI_DEVICENAME, device_name, &name_size) > 0) {
-        goto END;
+    if(!atomic_exchange(&unit->attached, true)) {
+        // Clearing attached was the last thing the old thread did, so this join is short
+        if(unit->thread >= 0) {
+            int result;
+            join_thread(unit->thread, &result);
+            destroy_thread(unit->thread);
+        }
+        unit->thread = create_thread(scan, (void*)(intptr_t)index, 0x4000, 0);
     }
+}
+
+// Runs every reader, the keypad and all presence timers on the calling thread. The loop is
+// created by init() and destroyed by fini(), hotplug wakes it from its own thread.
+int run_io_loop(void* param) {
+    io_loop_t* loop = param;
 
-    int device_index = -1;
     for(int i = 0; i < device_count; i++) {
-        PCHAR keypad_match = strstr(device_name, devices[i].keypad_identifier);
-        if(keypad_match == NULL) {
-            continue;
+        if(open_reader(&reader_units[i])) {
+            io_loop_add(loop, reader_units[i].transport);
+            atomic_store(&reader_units[i].attached, true);
         }
-
-        device_index = i;
     }
 
-    if(device_index == -1) {
-        goto END;
-    }
+    keypad_register(loop);
+
+    // fini() sets stopping before it wakes the loop, so the wakeup is never missed
+    while(!atomic_load(&stopping)) {
+        const uint64_t presence_due = next_presence_deadline();
+        const uint64_t keypad_due = keypad_deadline();
+        io_loop_wait(loop, keypad_due < presence_due ? keypad_due : presence_due);
+        const uint64_t now = clock_now_us();
+
+        keypad_service();
+
+        for(int i = 0; i < device_count; i++) {
+            reader_unit_t* unit = &reader_units[i];
+            if(atomic_load(&unit->reattach_pending) && unit->transport == NULL) {
+                if(open_reader(unit)) {
+                    io_loop_add(loop, unit->transport);
+                    atomic_store(&unit->attached, true);
+                }
+                atomic_store(&unit->reattach_pending, false);
+            }
 
-    if (raw->header.dwType == RIM_TYPEKEYBOARD) {
-        update_keypad_state(device_index, raw->data.keyboard.VKey, raw->data.keyboard.Flags);
-    }
+            if(unit->transport == NULL) {
+                continue;
+            }
+
+            // Several readers can complete in one wakeup, so check all of them
+            if(transport_ready(unit->transport) && (!complete_read(unit, now) || !begin_read(unit))) {
+                io_loop_remove(loop, unit->transport);
+                detach_reader(unit);
+                continue;
+            }
 
-    END:
-    if(device_name) {
-        free(device_name);
+            apply_presence_action(unit, presence_on_timer(&unit->presence, now), now);
+        }
     }
-    if(lpb) {
-        free(lpb);
+
+    keypad_unregister(loop);
+    for(int i = 0; i < device_count; i++) {
+        reader_unit_t* unit = &reader_units[i];
+        if(unit->transport != NULL) {
+            io_loop_remove(loop, unit->transport);
+            transport_close(unit->transport);
+            unit->transport = NULL;
+        }
     }
+
+    return EXIT_SUCCESS;
 }
 
-LRESULT CALLBACK HiddenWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
-    if (uMsg == WM_INPUT) {
-        ProcessRawInput(lParam);
+// Fires every presence timer due up to the replayed time. Unless replaying as fast as possible,
+// sleeps until each of them and then until the replayed time itself.
+static void replay_advance(const uint64_t until, const bool fast) {
+    while(!atomic_load(&stopping)) {
+        const uint64_t deadline = next_presence_deadline();
+        const uint64_t next = deadline < until ? deadline : until;
+        if(next == PRESENCE_NO_DEADLINE) {
+            return;
+        }
+
+        // In slices, so a long gap in the trace doesn't hold up shutting down
+        const uint64_t now = clock_now_us();
+        if(!fast && next > now) {
+            const uint64_t wait_ms = (next - now + 999) / 1000;
+            clock_sleep_ms(wait_ms < REPLAY_SLEEP_SLICE_MS ? (uint32_t)wait_ms : REPLAY_SLEEP_SLICE_MS);
+            if(clock_now_us() < next) {
+                continue;
+            }
+        }
+
+        if(deadline > until) {
+            return;
+        }
+
+        for(int i = 0; i < device_count; i++) {
+            apply_presence_action(&reader_units[i], presence_on_timer(&reader_units[i].presence, deadline), deadline);
+        }
     }
+}
 
-    if(orig_proc) {
-        return orig_proc(hwnd, uMsg, wParam, lParam);
+// Nobody polls fast enough to keep up with a fast replay, so it takes the card events off the queues itself
+static uint64_t replay_drain() {
+    uint64_t drained = 0;
+    card_event_t events[CARD_QUEUE_SIZE];
+    for(int i = 0; i < device_count; i++) {
+        drained += card_queue_drain(&reader_units[i].events, events, CARD_QUEUE_SIZE);
     }
 
-    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+    return drained;
 }
 
-DWORD WINAPI setup_keypad(LPVOID param) {
-    window = FindWindow(
-        "msg-thread",
-        NULL
-    );
-
-    if(!window) {
-        WNDCLASS wc = {0};
-        wc.lpfnWndProc = HiddenWndProc;
-        wc.hInstance = GetModuleHandle(NULL);
-        wc.lpszClassName = "aic-key-input";
-
-        if(!RegisterClass(&wc)) {
-            printf("Failed to register window class\n");
-            return EXIT_FAILURE;
+// Feeds a recorded trace through the same presence and keypad logic the readers use, either at the
+// speed it was recorded at or as fast as possible
+static int replay_trace(void* param) {
+    const bool fast = (bool)(intptr_t)param;
+    trace_record_t record;
+    const uint8_t* payload;
+    uint64_t records = 0;
+    uint64_t card_events = 0;
+    uint64_t previous = 0;
+
+    const uint64_t start = clock_now_us();
+    // Replayed time on the clock_now_us() timeline, the trace's own timestamps only give the spacing
+    uint64_t now = start;
+
+    while(!atomic_load(&stopping) && trace_next(&replay_reader, &record, &payload)) {
+        // Sessions appended to one file each run on their own clock, the gap between them is dropped
+        if(records > 0 && record.timestamp_us > previous) {
+            now += record.timestamp_us - previous;
         }
+        previous = record.timestamp_us;
+        records++;
 
-        window = CreateWindow(
-            wc.lpszClassName,
-            "aic-key-input-window",
-            WS_MINIMIZE,
-            CW_USEDEFAULT, 0,
-            CW_USEDEFAULT, 0,
-            HWND_MESSAGE,
-            NULL,
-            wc.hInstance,
-            NULL
-        );
-    }
-    else {
-        HINSTANCE geninput_dll = GetModuleHandle("geninput.dll");
-        if(!geninput_dll) {
-            MessageBox(window, "Failed to get geninput.dll handle", "Error", MB_OK);
-            return EXIT_FAILURE;
-        }
+        replay_advance(now, fast);
 
-        // Get thread id from window
-        DWORD thread_id = GetWindowThreadProcessId(window, NULL);
-        if(!thread_id) {
-            MessageBox(window, "Failed to get thread id", "Error", MB_OK);
+        if(record.unit >= device_count) {
+            continue;
         }
 
-        if(!SetWindowsHookEx(
-            WH_GETMESSAGE,
-            (HOOKPROC)HiddenWndProc,
-            geninput_dll,
-            thread_id
-        )) {
-            MessageBox(window, "Failed to set hook", "Error", MB_OK);
-            return EXIT_FAILURE;
+        reader_unit_t* unit = &reader_units[record.unit];
+        switch(record.type) {
+            case TRACE_CARD_REPORT: {
+                reader_snapshot_t* snapshot = reader_state_back(&unit->state);
+                memcpy(snapshot->report, payload, record.length);
+                snapshot->length = record.length;
+                handle_report(unit, now);
+                break;
+            }
+            case TRACE_KEY:
+                update_keypad_state(record.unit, (uint16_t)record.value, record.value >> 16 & 1);
+                break;
+            default:
+                break;
         }
 
-        WNDCLASSEX wcex;
-        wcex.cbSize = sizeof(WNDCLASSEX);
-        if(!GetClassInfoEx(geninput_dll, "msg-thread", &wcex)) {
-            MessageBox(window, "Failed to get class info", "Error", MB_OK);
-            return EXIT_FAILURE;
+        if(fast) {
+            card_events += replay_drain();
         }
+    }
 
-        orig_proc = wcex.lpfnWndProc;
-        SetWindowLongPtr(window, GWLP_WNDPROC, (LONG_PTR)HiddenWndProc);
-        if (!orig_proc) {
-            MessageBox(window, "Failed to set window procedure", "Error", MB_OK);
-            return EXIT_FAILURE;
-        }
+    // Let a card that was still held at the end of the trace run out
+    replay_advance(PRESENCE_NO_DEADLINE, fast);
+    if(fast) {
+        card_events += replay_drain();
     }
 
-    // if(!window) {
-    //     printf("Failed to create window\n");
-    //     exit(EXIT_FAILURE);
-    //     return EXIT_FAILURE;
-    // }
+    const uint64_t elapsed = clock_now_us() - start;
+    log_info("Replayed %llu records in %llu us (%.0f records/s)\n",
+        (unsigned long long)records, (unsigned long long)elapsed, elapsed > 0 ? (double)records * 1e6 / (double)elapsed : 0.0);
+    if(fast) {
+        log_info("Replay produced %llu card events\n", (unsigned long long)card_events);
+    }
 
-    RAWINPUTDEVICE filter[2];
-    filter[0].usUsagePage = KBD_DEVICE_USAGE_KEYBOARD >> 16;
-    filter[0].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYBOARD;
-    filter[0].dwFlags = RIDEV_INPUTSINK;
-    filter[0].hwndTarget = window;
+    return EXIT_SUCCESS;
+}
 
-    filter[1].usUsagePage = KBD_DEVICE_USAGE_KEYPAD >> 16;
-    filter[1].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYPAD;
-    filter[1].dwFlags = RIDEV_INPUTSINK;
-    filter[1].hwndTarget = window;
+static device_t* load_devices(const char* cache_path, int* count) {
+    const bool use_cache = cache_path != NULL && cache_path[0] != '\0';
+    const uint64_t start = clock_now_us();
 
-    if(!RegisterRawInputDevices(filter, 2, sizeof(filter[0]))) {
-        printf("Failed to register raw input devices\n");
-        return EXIT_FAILURE;
+    if(use_cache) {
+        device_t* cached = device_cache_load(cache_path, VID, PID, CARDIO_MI, KEYPAD_MI, count);
+        if(cached != NULL) {
+            log_info("Device table loaded from %s in %llu us\n", cache_path, (unsigned long long)(clock_now_us() - start));
+            return cached;
+        }
     }
 
-    MSG msg;
-    while(GetMessage(&msg, NULL, 0, 0)) {
-        TranslateMessage(&msg);
-        DispatchMessage(&msg);
+    device_t* found = get_devices(VID, PID, CARDIO_MI, KEYPAD_MI, count);
+    if(use_cache && *count > 0) {
+        device_cache_save(cache_path, found, *count);
     }
 
-    return EXIT_SUCCESS;
+    log_info("Device table enumerated in %llu us\n", (unsigned long long)(clock_now_us() - start));
+    return found;
 }
 
-int init() {
+int init(const aic_config_t* config) {
+    const uint64_t start = clock_now_us();
     device_count = 0;
-    devices = get_devices(VID, PID, CARDIO_MI, &device_count);
+    const bool replay = config->trace_replay_path != NULL && config->trace_replay_path[0] != '\0';
+    if(replay) {
+        // The trace decides how many units there are, no reader is opened
+        if(!trace_open(&replay_reader, config->trace_replay_path)) {
+            return 0;
+        }
+        device_count = replay_reader.unit_count;
+        devices = calloc(device_count, sizeof(device_t));
+        for(int i = 0; i < device_count; i++) {
+            snprintf(devices[i].location, sizeof(devices[i].location), "replay of %s", config->trace_replay_path);
+        }
+    }
+    else {
+        devices = load_devices(config->device_cache_path, &device_count);
+    }
 
     if(device_count == 0) {
-        printf("No devices found\n");
+        log_warn("No devices found\n");
         return 0;
     }
 
-    keypad_states = malloc(device_count * sizeof(uint16_t));
+    // fini() is already waiting for this thread, nothing more needs starting
+    if(atomic_load(&stopping)) {
+        return 0;
+    }
+
+    // Whole units are a multiple of the cache line, so only the start of the array needs aligning
+    unit_memory = calloc(1, device_count * sizeof(reader_unit_t) + CACHE_LINE_SIZE);
+    reader_units = (reader_unit_t*)(((uintptr_t)unit_memory + CACHE_LINE_SIZE - 1) & ~(uintptr_t)(CACHE_LINE_SIZE - 1));
+
+    // Decides which keymap is the default
+    keypad_set_direct(config->keypad_direct);
+
+    presence_config = config->presence;
     for(int i = 0; i < device_count; i++) {
-        keypad_states[i] = 0;
+        reader_unit_t* unit = &reader_units[i];
+        unit->index = i;
+        unit->thread = -1;
+        unit->sensor_state = 0x03;
+        // Replaced once the reader is opened, replay never opens it and keeps this one
+        report_parser_init_cardio(&unit->parser);
+        presence_init(&unit->presence, &presence_config);
+        reader_state_init(&unit->state);
+
+        // Units past the end of the configured list use the last entry
+        const char* keymap_name = keypad_default_keymap();
+        if(config->keymap_count > 0) {
+            keymap_name = config->keymaps[i < config->keymap_count ? i : config->keymap_count - 1];
+        }
+
+        unit->keymap = keymap_find(keymap_name);
+        if(unit->keymap == NULL) {
+            log_warn("Unknown keymap %s for unit %d, using %s\n", keymap_name, i, keypad_default_keymap());
+            unit->keymap = keymap_find(keypad_default_keymap());
+        }
     }
+    atomic_store(&unit_count, device_count);
 
-    printf("Devices found: %d\n", device_count);
+    log_info("Devices found: %d\n", device_count);
     for(int i = 0; i < device_count; i++) {
-        keypad_states[i] = 0;
+        log_info("Device %d: location %s, keymap %s\n", i, devices[i].location, reader_units[i].keymap->name);
+        log_info("CardIO device path: %s\n", devices[i].cardio_path);
+        log_info("Keypad device path: %s\n", devices[i].keypad_identifier);
+    }
+
+    if(replay) {
+        io_thread = create_thread(replay_trace, (void*)(intptr_t)config->trace_replay_fast, 0x4000, 0);
+        return 0;
+    }
 
-        printf("Device %d:\n", i);
-        printf("Location: %s\n", devices[i].location);
+    if(config->trace_record_path != NULL && config->trace_record_path[0] != '\0') {
+        trace_start(config->trace_record_path, device_count);
+    }
 
-        printf("CardIO device path: %s\n", devices[i].cardio_path);
-        printf("Keypad device path: %s\n", devices[i].keypad_identifier);
+    if(config->single_thread_io) {
+        io_loop_t* loop = io_loop_create();
+        if(loop == NULL) {
+            return 0;
+        }
 
-        putchar('\n');
+        atomic_store(&active_loop, loop);
+        io_thread = create_thread(run_io_loop, loop, 0x4000, 0);
     }
+    else {
+        // Without it fini() could not get the readers out of their waits
+        stop_signal = transport_cancel_create();
+        if(stop_signal == NULL) {
+            return 0;
+        }
 
-    HANDLE cardio_threads[2];
-    for(int i = 0; i < device_count; i++) {
-        cardio_threads[i] = CreateThread(
-            NULL,
-            0,
-            scan,
-            (LPVOID)i,
-            0,
-            NULL
-        );
-    }
-
-    HANDLE keypad_thread = CreateThread(
-        NULL,
-        0,
-        setup_keypad,
-        NULL,
-        0,
-        NULL
-    );
+        for(int i = 0; i < device_count; i++) {
+            atomic_store(&reader_units[i].attached, true);
+            reader_units[i].thread = create_thread(scan, (void*)(intptr_t)i, 0x4000, 0);
+        }
 
-    for(int i = 0; i < device_count; i++) {
-        WaitForSingleObject(cardio_threads[i], INFINITE);
+        keypad_start();
     }
 
+    hotplug_start(on_interface_arrival);
+
+    log_info("I/O started in %llu us\n", (unsigned long long)(clock_now_us() - start));
     return 0;
 }
 
+void request_stop() {
+    atomic_store(&unit_count, 0);
+    atomic_store(&stopping, true);
+}
+
+void fini() {
+    // init() may have published the units after request_stop() cleared them
+    atomic_store(&unit_count, 0);
+    atomic_store(&stopping, true);
+
+    // Nothing can start a reader thread or wake the loop after this
+    hotplug_stop();
+
+    io_loop_t* loop = atomic_load(&active_loop);
+    if(loop != NULL) {
+        io_loop_wake(loop);
+    }
+    if(stop_signal != NULL) {
+        transport_cancel(stop_signal);
+    }
+    keypad_stop();
+
+    int result;
+    if(io_thread >= 0) {
+        join_thread(io_thread, &result);
+        destroy_thread(io_thread);
+        io_thread = -1;
+    }
+
+    // No units when init() stopped between loading the devices and setting them up
+    for(int i = 0; reader_units != NULL && i < device_count; i++) {
+        if(reader_units[i].thread >= 0) {
+            join_thread(reader_units[i].thread, &result);
+            destroy_thread(reader_units[i].thread);
+        }
+    }
+
+    // Every thread that could use any of this is gone now
+    io_loop_destroy(loop);
+    atomic_store(&active_loop, NULL);
+    transport_cancel_destroy(stop_signal);
+    stop_signal = NULL;
+    trace_stop();
+    trace_close(&replay_reader);
+
+    free(unit_memory);
+    unit_memory = NULL;
+    reader_units = NULL;
+    free(devices);
+    devices = NULL;
+    device_count = 0;
+
+    atomic_store(&stopping, false);
+}
+
+void poll_reader(uint8_t unit_no) {
+    if(unit_no >= atomic_load(&unit_count)) {
+        return;
+    }
+
+    // One event per poll, so every tap is seen by at least one poll and its removal by a later one
+    reader_unit_t* unit = &reader_units[unit_no];
+    if(card_queue_pop(&unit->events, &unit->latched)) {
+        unit->latched_at = clock_now_us();
+        unit->latched_read = false;
+        latency_record(&unit->latency[LATENCY_CARD_POLL], unit->latched_at - unit->latched.timestamp_us);
+        return;
+    }
+
+    // Nothing queued. Fall back on the published level, so an event dropped on overflow can't leave a card stuck.
+    const reader_snapshot_t* snapshot = reader_state_front(&unit->state);
+    const bool present = snapshot->length != 0;
+    if(present == (unit->latched.type == CARD_EVENT_PRESENT)) {
+        return;
+    }
+
+    memset(&unit->latched, 0, sizeof(unit->latched));
+    unit->latched.timestamp_us = clock_now_us();
+    unit->latched.type = present ? CARD_EVENT_PRESENT : CARD_EVENT_REMOVED;
+    if(present && snapshot->length >= PRESENCE_CARD_SIZE) {
+        memcpy(unit->latched.card, snapshot->report, PRESENCE_CARD_SIZE);
+    }
+}
+
+int drain_card_events(uint8_t unit_no, card_event_t* events, int max_events) {
+    if(unit_no >= atomic_load(&unit_count) || max_events <= 0) {
+        return 0;
+    }
+
+    return card_queue_drain(&reader_units[unit_no].events, events, max_events);
+}
+
 uint8_t get_reader_bytes(uint8_t unit_no, uint8_t* input) {
-    uint8_t* reader_bytes = unit_no == 0 ? reader_1_bytes : reader_2_bytes;
-    memcpy(input, reader_bytes + 1, 8);
-    return reader_bytes[0];
+    if(unit_no >= atomic_load(&unit_count) || reader_units[unit_no].latched.type != CARD_EVENT_PRESENT) {
+        memset(input, 0, 8);
+        return 0;
+    }
+
+    reader_unit_t* unit = &reader_units[unit_no];
+    if(!unit->latched_read) {
+        unit->latched_read = true;
+        latency_record(&unit->latency[LATENCY_CARD_READ], clock_now_us() - unit->latched_at);
+    }
+
+    const card_event_t* latched = &unit->latched;
+    memcpy(input, latched->card + 1, 8);
+    return latched->card[0];
 }
 
 bool get_reader_state(uint8_t unit_no) {
-    return unit_no == 0 ? reader_1_inserted : reader_2_inserted;
+    if(unit_no >= atomic_load(&unit_count)) {
+        return false;
+    }
+
+    return reader_units[unit_no].latched.type == CARD_EVENT_PRESENT;
+}
+
+void dump_latency() {
+    const int count = atomic_load(&unit_count);
+    for(int i = 0; i < count; i++) {
+        for(int stage = 0; stage < LATENCY_STAGE_COUNT; stage++) {
+            latency_dump(&reader_units[i].latency[stage], i, (latency_stage_t)stage);
+        }
+
+        const uint32_t malformed = atomic_load_explicit(&reader_units[i].malformed_reports, memory_order_relaxed);
+        if(malformed > 0) {
+            log_info("Unit %d: %u malformed reports rejected\n", i, malformed);
+        }
+    }
 }
\ No newline at end of file
@@ -3,7 +3,54 @@
 #include <stdint.h>
 #include <stdbool.h>
 
-void init();
+#include "device.h"
+#include "presence.h"
+#include "card_queue.h"
+
+typedef struct aic_config {
+    presence_config_t presence;
+    bool single_thread_io;
+    // Read the keypad from its own HID interface, see keypad_set_direct()
+    bool keypad_direct;
+    // Keymap name per unit, see keymap.c
+    const char** keymaps;
+    int keymap_count;
+    // Where the resolved device table is kept between launches, NULL or empty to always enumerate
+    const char* device_cache_path;
+    // Raw reports and key events are appended here when set, see trace.h
+    const char* trace_record_path;
+    // When set, no reader is opened and this trace is played back instead
+    const char* trace_replay_path;
+    // Replay as fast as possible instead of at the recorded speed
+    bool trace_replay_fast;
+} aic_config_t;
+
+extern device_t* devices;
+extern int device_count;
+
+// Finds and sets up every unit, starts the I/O threads and returns
+int init(const aic_config_t* config);
+// Makes init() stop at its next stage and the exports see no units, returns right away
+void request_stop();
+// Stops and joins every thread init() started and frees what it set up, so init() can run again.
+// Only once init() has returned, and never while eam_io_* calls are still running on other threads.
+void fini();
+// Zero until init() has set every unit up and again from request_stop() on, the readiness flag
+int get_unit_count();
+// As of the last poll_keypad()
 uint16_t get_keypad_state(int device_index);
+void update_keypad_state(int keypad_index, uint16_t key, bool pressed);
+// Lets go of every key the unit's keypad holds, for when it went away. Same thread as update_keypad_state().
+void release_keypad(int keypad_index);
+uint8_t get_sensor_state(uint8_t unit_no);
+void set_sensor_state(uint8_t unit_no, uint8_t state);
+// Moves the unit on to its next card event, called once per eam_io_poll()
+void poll_reader(uint8_t unit_no);
+// Moves the unit's keypad on by one step of queued key edges, called once per eam_io_poll()
+void poll_keypad(uint8_t unit_no);
+// Takes raw events off the same queue poll_reader() reads, for tools that don't go through eam_io_poll()
+int drain_card_events(uint8_t unit_no, card_event_t* events, int max_events);
 uint8_t get_reader_bytes(uint8_t unit_no, uint8_t* input);
-bool get_reader_state(uint8_t unit_no);
\ No newline at end of file
+bool get_reader_state(uint8_t unit_no);
+// Logs every unit's per-stage latency percentiles and how many reports it rejected
+void dump_latency();
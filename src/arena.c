@@ -0,0 +1,69 @@
+#include "arena.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define ARENA_BLOCK_SIZE 16384
+#define ARENA_ALIGNMENT 16
+
+struct arena_block {
+    arena_block_t* next;
+    size_t size;
+    size_t used;
+    _Alignas(ARENA_ALIGNMENT) uint8_t data[];
+};
+
+void* arena_alloc(arena_t* arena, const size_t size) {
+    const size_t aligned_size = (size + ARENA_ALIGNMENT - 1) & ~(size_t)(ARENA_ALIGNMENT - 1);
+
+    arena_block_t* block = arena->head;
+    if(block == NULL || block->size - block->used < aligned_size) {
+        // Oversized requests get a block of their own
+        const size_t block_size = aligned_size > ARENA_BLOCK_SIZE ? aligned_size : ARENA_BLOCK_SIZE;
+        block = malloc(sizeof(arena_block_t) + block_size);
+        if(block == NULL) {
+            return NULL;
+        }
+
+        block->size = block_size;
+        block->used = 0;
+        block->next = arena->head;
+        arena->head = block;
+    }
+
+    void* memory = block->data + block->used;
+    block->used += aligned_size;
+    memset(memory, 0, size);
+
+    return memory;
+}
+
+void* arena_copy(arena_t* arena, const void* data, const size_t size) {
+    void* memory = arena_alloc(arena, size);
+    if(memory != NULL) {
+        memcpy(memory, data, size);
+    }
+
+    return memory;
+}
+
+void* arena_grow(arena_t* arena, void* data, const size_t old_size, const size_t new_size) {
+    void* memory = arena_alloc(arena, new_size);
+    if(memory != NULL && data != NULL) {
+        memcpy(memory, data, old_size < new_size ? old_size : new_size);
+    }
+
+    return memory;
+}
+
+void arena_free(arena_t* arena) {
+    arena_block_t* block = arena->head;
+    while(block != NULL) {
+        arena_block_t* next = block->next;
+        free(block);
+        block = next;
+    }
+
+    arena->head = NULL;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+
+// Bump allocator for short-lived scratch data: many small allocations, one arena_free() at the end
+typedef struct arena_block arena_block_t;
+
+typedef struct arena {
+    arena_block_t* head;
+} arena_t;
+
+// Zeroed memory that lives until arena_free()
+void* arena_alloc(arena_t* arena, size_t size);
+void* arena_copy(arena_t* arena, const void* data, size_t size);
+// Grows an array living in the arena, the old copy is only reclaimed by arena_free()
+void* arena_grow(arena_t* arena, void* data, size_t old_size, size_t new_size);
+void arena_free(arena_t* arena);
@@ -0,0 +1,15 @@
+#include "card_queue.h"
+
+bool card_queue_push(card_queue_t* queue, const card_event_t* event) {
+    return spsc_ring_push(&queue->ring, queue->events, CARD_QUEUE_SIZE, sizeof(card_event_t), event);
+}
+
+bool card_queue_pop(card_queue_t* queue, card_event_t* event) {
+    return card_queue_drain(queue, event, 1) == 1;
+}
+
+int card_queue_drain(card_queue_t* queue, card_event_t* events, const int max_events) {
+    const int count = spsc_ring_peek(&queue->ring, queue->events, CARD_QUEUE_SIZE, sizeof(card_event_t), events, max_events);
+    spsc_ring_skip(&queue->ring, count);
+    return count;
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "presence.h"
+#include "spsc_ring.h"
+
+// Must be a power of two
+#define CARD_QUEUE_SIZE 64
+
+typedef enum card_event_type {
+    CARD_EVENT_PRESENT = 1,
+    CARD_EVENT_REMOVED = 2,
+} card_event_type_t;
+
+typedef struct card_event {
+    // clock_now_us() of the report or timer that caused it
+    uint64_t timestamp_us;
+    uint8_t type;
+    // Card type byte followed by the 8 byte ID, zero for CARD_EVENT_REMOVED
+    uint8_t card[PRESENCE_CARD_SIZE];
+} card_event_t;
+
+// Single producer (the unit's reader) and single consumer (the game or a tool draining it)
+typedef struct card_queue {
+    spsc_ring_t ring;
+    card_event_t events[CARD_QUEUE_SIZE];
+} card_queue_t;
+
+// Returns false and drops the event when the consumer has fallen a whole queue behind
+bool card_queue_push(card_queue_t* queue, const card_event_t* event);
+bool card_queue_pop(card_queue_t* queue, card_event_t* event);
+int card_queue_drain(card_queue_t* queue, card_event_t* events, int max_events);
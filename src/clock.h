@@ -0,0 +1,6 @@
+#pragma once
+
+#include <stdint.h>
+
+uint64_t clock_now_us();
+void clock_sleep_ms(uint32_t milliseconds);
@@ -0,0 +1,113 @@
+#include "device_cache.h"
+#include "transport.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define DEVICE_CACHE_MAGIC 0x44434941 // "AICD"
+#define DEVICE_CACHE_VERSION 2
+// Nobody has more readers than this, anything above means the file is garbage
+#define DEVICE_CACHE_MAX_DEVICES 16
+
+// Followed by device_count raw device_t records. record_size catches layout changes between builds and platforms.
+typedef struct device_cache_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t device_count;
+} device_cache_header_t;
+
+static bool validate_cached_device(const device_t* devices, const int device_count, const int index, const int vid, const int pid, const int cardio_mi, const int keypad_mi) {
+    // Opening is what would fail first if the reader moved or went away
+    transport_t* transport = transport_open(devices[index].cardio_path);
+    if(transport == NULL) {
+        return false;
+    }
+    transport_close(transport);
+
+    // hidraw numbers get reused, so also make sure the node still belongs to the same reader
+    if(match_device(devices, device_count, devices[index].cardio_path, vid, pid, cardio_mi) != index) {
+        return false;
+    }
+
+    // The keypad is re-enumerated on its own, a stale identifier would leave the unit without one
+    return devices[index].keypad_identifier[0] == '\0' || match_keypad(&devices[index], vid, pid, keypad_mi);
+}
+
+device_t* device_cache_load(const char* path, const int vid, const int pid, const int cardio_mi, const int keypad_mi, int* device_count) {
+    *device_count = 0;
+
+    FILE* file = fopen(path, "rb");
+    if(file == NULL) {
+        return NULL;
+    }
+
+    device_cache_header_t header;
+    if(fread(&header, sizeof(header), 1, file) != 1
+        || header.magic != DEVICE_CACHE_MAGIC
+        || header.version != DEVICE_CACHE_VERSION
+        || header.record_size != sizeof(device_t)
+        || header.device_count == 0
+        || header.device_count > DEVICE_CACHE_MAX_DEVICES) {
+        log_info("Device cache %s is not usable, enumerating\n", path);
+        fclose(file);
+        return NULL;
+    }
+
+    device_t* devices = malloc(header.device_count * sizeof(device_t));
+    const size_t records_read = fread(devices, sizeof(device_t), header.device_count, file);
+    fclose(file);
+
+    if(records_read != header.device_count) {
+        log_info("Device cache %s is truncated, enumerating\n", path);
+        free(devices);
+        return NULL;
+    }
+
+    for(uint32_t i = 0; i < header.device_count; i++) {
+        // Records are copied straight from disk, don't trust the terminators
+        devices[i].location[sizeof(devices[i].location) - 1] = '\0';
+        devices[i].cardio_path[sizeof(devices[i].cardio_path) - 1] = '\0';
+        devices[i].keypad_identifier[sizeof(devices[i].keypad_identifier) - 1] = '\0';
+
+        if(!validate_cached_device(devices, (int)header.device_count, (int)i, vid, pid, cardio_mi, keypad_mi)) {
+            log_info("Cached device %u at %s is gone, enumerating\n", i, devices[i].location);
+            free(devices);
+            return NULL;
+        }
+    }
+
+    *device_count = (int)header.device_count;
+    return devices;
+}
+
+void device_cache_save(const char* path, const device_t* devices, const int device_count) {
+    if(device_count <= 0 || device_count > DEVICE_CACHE_MAX_DEVICES) {
+        return;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if(file == NULL) {
+        log_warn("Failed to write device cache %s\n", path);
+        return;
+    }
+
+    const device_cache_header_t header = {
+        .magic = DEVICE_CACHE_MAGIC,
+        .version = DEVICE_CACHE_VERSION,
+        .record_size = sizeof(device_t),
+        .device_count = (uint32_t)device_count,
+    };
+
+    const bool written = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(devices, sizeof(device_t), device_count, file) == (size_t)device_count;
+    fclose(file);
+
+    if(!written) {
+        log_warn("Failed to write device cache %s\n", path);
+        remove(path);
+    }
+}
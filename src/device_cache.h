@@ -0,0 +1,8 @@
+#pragma once
+
+#include "device.h"
+
+// Loads a device table saved by device_cache_save(). Returns NULL when the file is missing, was written
+// by another build, or any cached CardIO or keypad interface no longer belongs to the same reader.
+device_t* device_cache_load(const char* path, int vid, int pid, int cardio_mi, int keypad_mi, int* device_count);
+void device_cache_save(const char* path, const device_t* devices, int device_count);
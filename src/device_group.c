@@ -0,0 +1,126 @@
+#include "device_group.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// One physical reader while grouping, copied into a device_t once complete
+typedef struct device_group {
+    const char* location;
+    const char* cardio_path;
+    const char* keypad_identifier;
+} device_group_t;
+
+// Open addressed map from a location to its group, keys point into the caller's strings
+typedef struct group_index_entry {
+    const char* key;
+    size_t key_size;
+    uint32_t hash;
+    int group;
+} group_index_entry_t;
+
+typedef struct group_index {
+    group_index_entry_t* entries;
+    int capacity;
+} group_index_t;
+
+// FNV-1a
+static uint32_t hash_key(const char* key, const size_t key_size) {
+    uint32_t hash = 2166136261u;
+    for(size_t i = 0; i < key_size; i++) {
+        hash = (hash ^ (uint8_t)key[i]) * 16777619u;
+    }
+
+    return hash;
+}
+
+static void group_index_init(arena_t* arena, group_index_t* index, const int expected_count) {
+    // At most half full, so probes stay short and the table never has to grow
+    int capacity = 16;
+    while(capacity < expected_count * 2) {
+        capacity *= 2;
+    }
+
+    index->entries = arena_alloc(arena, capacity * sizeof(group_index_entry_t));
+    index->capacity = capacity;
+}
+
+// The key's entry, or the empty slot it would go in
+static group_index_entry_t* group_index_slot(const group_index_t* index, const char* key, const size_t key_size, const uint32_t hash) {
+    const uint32_t mask = (uint32_t)index->capacity - 1;
+
+    for(uint32_t slot = hash & mask;; slot = (slot + 1) & mask) {
+        group_index_entry_t* entry = &index->entries[slot];
+        if(entry->key == NULL) {
+            return entry;
+        }
+
+        if(entry->hash == hash && entry->key_size == key_size && memcmp(entry->key, key, key_size) == 0) {
+            return entry;
+        }
+    }
+}
+
+device_t* group_devices(arena_t* arena, const parsed_device_t* parsed_devices, const int parsed_device_count, int* device_count) {
+    *device_count = 0;
+
+    device_group_t* groups = arena_alloc(arena, (parsed_device_count > 0 ? parsed_device_count : 1) * sizeof(device_group_t));
+    int group_count = 0;
+    group_index_t locations = {0};
+    group_index_init(arena, &locations, parsed_device_count);
+
+    for(int i = 0; i < parsed_device_count; i++) {
+        const parsed_device_t* parsed_device = &parsed_devices[i];
+        if(parsed_device->location == NULL) {
+            continue;
+        }
+
+        const size_t location_size = strlen(parsed_device->location);
+        const uint32_t hash = hash_key(parsed_device->location, location_size);
+        group_index_entry_t* entry = group_index_slot(&locations, parsed_device->location, location_size, hash);
+        if(entry->key == NULL) {
+            entry->key = parsed_device->location;
+            entry->key_size = location_size;
+            entry->hash = hash;
+            entry->group = group_count++;
+            groups[entry->group].location = parsed_device->location;
+        }
+
+        device_group_t* group = &groups[entry->group];
+        if(parsed_device->cardio_path != NULL) {
+            group->cardio_path = parsed_device->cardio_path;
+        }
+        if(parsed_device->keypad_identifier != NULL) {
+            group->keypad_identifier = parsed_device->keypad_identifier;
+        }
+    }
+
+    // A keypad without its CardIO interface is no reader to open
+    int kept_count = 0;
+    for(int i = 0; i < group_count; i++) {
+        kept_count += groups[i].cardio_path != NULL;
+    }
+    if(kept_count == 0) {
+        return NULL;
+    }
+
+    // The only allocation that outlives enumeration
+    device_t* devices = calloc(kept_count, sizeof(device_t));
+    device_t* device = devices;
+    for(int i = 0; i < group_count; i++) {
+        if(groups[i].cardio_path == NULL) {
+            continue;
+        }
+
+        snprintf(device->location, sizeof(device->location), "%s", groups[i].location);
+        snprintf(device->cardio_path, sizeof(device->cardio_path), "%s", groups[i].cardio_path);
+        if(groups[i].keypad_identifier != NULL) {
+            snprintf(device->keypad_identifier, sizeof(device->keypad_identifier), "%s", groups[i].keypad_identifier);
+        }
+        device++;
+    }
+
+    *device_count = kept_count;
+    return devices;
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include "device.h"
+#include "arena.h"
+
+// One HID interface as found during enumeration. The strings belong to the caller, usually in its
+// enumeration arena, and only have to last until group_devices() returns.
+typedef struct parsed_device {
+    // Shared by every interface of one physical reader, NULL when the platform couldn't tell
+    const char* location;
+    const char* cardio_path;
+    const char* keypad_identifier;
+} parsed_device_t;
+
+// Groups interfaces by location into one device_t per physical reader, in the order the readers were
+// first seen. Interfaces without a location are skipped, and so are groups without a CardIO path, only
+// those are counted in device_count. Scratch space comes from arena, only the returned table is malloc'd.
+// NULL when no group has a CardIO path.
+device_t* group_devices(arena_t* arena, const parsed_device_t* parsed_devices, int parsed_device_count, int* device_count);
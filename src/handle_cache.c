@@ -0,0 +1,62 @@
+#include "handle_cache.h"
+
+#include <string.h>
+
+// Keep probe sequences short, a full cache is simply dropped and refilled on the next misses
+#define HANDLE_CACHE_MAX_FILL (HANDLE_CACHE_SIZE * 3 / 4)
+
+static uint32_t slot_for(const uintptr_t handle) {
+    // Handles are pointer-like, the low bits carry little information
+    const uint64_t hash = (uint64_t)(handle >> 2) * 0x9E3779B97F4A7C15ull;
+    return (uint32_t)(hash >> 32) & (HANDLE_CACHE_SIZE - 1);
+}
+
+void handle_cache_clear(handle_cache_t* cache) {
+    memset(cache->entries, 0, sizeof(cache->entries));
+    cache->count = 0;
+}
+
+bool handle_cache_lookup(const handle_cache_t* cache, const uintptr_t handle, int* unit) {
+    if(handle == 0) {
+        return false;
+    }
+
+    uint32_t slot = slot_for(handle);
+    for(int i = 0; i < HANDLE_CACHE_SIZE; i++) {
+        const handle_cache_entry_t* entry = &cache->entries[slot];
+        if(entry->handle == handle) {
+            *unit = entry->unit;
+            return true;
+        }
+
+        if(entry->handle == 0) {
+            return false;
+        }
+
+        slot = (slot + 1) & (HANDLE_CACHE_SIZE - 1);
+    }
+
+    return false;
+}
+
+void handle_cache_insert(handle_cache_t* cache, const uintptr_t handle, const int unit) {
+    if(handle == 0) {
+        return;
+    }
+
+    if(cache->count >= HANDLE_CACHE_MAX_FILL) {
+        handle_cache_clear(cache);
+    }
+
+    uint32_t slot = slot_for(handle);
+    while(cache->entries[slot].handle != 0 && cache->entries[slot].handle != handle) {
+        slot = (slot + 1) & (HANDLE_CACHE_SIZE - 1);
+    }
+
+    if(cache->entries[slot].handle == 0) {
+        cache->count++;
+    }
+
+    cache->entries[slot].handle = handle;
+    cache->entries[slot].unit = unit;
+}
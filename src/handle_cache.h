@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define HANDLE_CACHE_SIZE 64
+#define HANDLE_CACHE_NO_UNIT -1
+
+typedef struct handle_cache_entry {
+    uintptr_t handle;
+    int unit;
+} handle_cache_entry_t;
+
+// Open-addressed map from an OS input device handle to the unit it belongs to, or
+// HANDLE_CACHE_NO_UNIT for devices that are not ours. Handle 0 is reserved for empty slots.
+typedef struct handle_cache {
+    handle_cache_entry_t entries[HANDLE_CACHE_SIZE];
+    int count;
+} handle_cache_t;
+
+void handle_cache_clear(handle_cache_t* cache);
+bool handle_cache_lookup(const handle_cache_t* cache, uintptr_t handle, int* unit);
+void handle_cache_insert(handle_cache_t* cache, uintptr_t handle, int unit);
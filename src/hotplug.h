@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdbool.h>
+
+// Called with the interface path of every HID interface that shows up after startup
+typedef void (*hotplug_arrival_t)(const char* path);
+
+// Watches for HID interfaces being plugged in, calls back from a platform thread
+bool hotplug_start(hotplug_arrival_t on_arrival);
+// Stops watching and returns once no callback is running, does nothing when not started
+void hotplug_stop();
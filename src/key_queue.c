@@ -0,0 +1,13 @@
+#include "key_queue.h"
+
+bool key_queue_push(key_queue_t* queue, const key_event_t* event) {
+    return spsc_ring_push(&queue->ring, queue->events, KEY_QUEUE_SIZE, sizeof(key_event_t), event);
+}
+
+bool key_queue_peek(key_queue_t* queue, key_event_t* event) {
+    return spsc_ring_peek(&queue->ring, queue->events, KEY_QUEUE_SIZE, sizeof(key_event_t), event, 1) == 1;
+}
+
+void key_queue_skip(key_queue_t* queue) {
+    spsc_ring_skip(&queue->ring, 1);
+}
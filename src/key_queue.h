@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#include "spsc_ring.h"
+
+// Must be a power of two
+#define KEY_QUEUE_SIZE 64
+
+typedef struct key_event {
+    // clock_now_us() when the keypad reported it
+    uint64_t timestamp_us;
+    // EAM_IO_KEYPAD_* bit
+    uint8_t bit;
+    bool pressed;
+} key_event_t;
+
+// Single producer (the keypad's input path) and single consumer (the game's eam_io_poll())
+typedef struct key_queue {
+    spsc_ring_t ring;
+    key_event_t events[KEY_QUEUE_SIZE];
+} key_queue_t;
+
+// Returns false and drops the event when the consumer has fallen a whole queue behind
+bool key_queue_push(key_queue_t* queue, const key_event_t* event);
+// Looks at the oldest event without taking it, the consumer decides whether this poll can apply it
+bool key_queue_peek(key_queue_t* queue, key_event_t* event);
+void key_queue_skip(key_queue_t* queue);
@@ -0,0 +1,92 @@
+#include "keymap.h"
+#include "bemanitools/eamio.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#define KEY(code, scan_code) [code] = (scan_code) + 1
+
+static const keymap_t keymaps[] = {
+    // AIC Pico firmware seen through raw input, numlock off
+    {
+        .name = "aic",
+        .bits = {
+            KEY(45, EAM_IO_KEYPAD_0),
+            KEY(35, EAM_IO_KEYPAD_1),
+            KEY(40, EAM_IO_KEYPAD_2),
+            KEY(34, EAM_IO_KEYPAD_3),
+            KEY(37, EAM_IO_KEYPAD_4),
+            KEY(12, EAM_IO_KEYPAD_5),
+            KEY(39, EAM_IO_KEYPAD_6),
+            KEY(36, EAM_IO_KEYPAD_7),
+            KEY(38, EAM_IO_KEYPAD_8),
+            KEY(33, EAM_IO_KEYPAD_9),
+            KEY(46, EAM_IO_KEYPAD_00),
+            KEY(109, EAM_IO_KEYPAD_DECIMAL),
+        },
+    },
+    // Same firmware with numlock on, VK_NUMPAD0-9, VK_DECIMAL and VK_SUBTRACT
+    {
+        .name = "aic_numlock",
+        .bits = {
+            KEY(0x60, EAM_IO_KEYPAD_0),
+            KEY(0x61, EAM_IO_KEYPAD_1),
+            KEY(0x62, EAM_IO_KEYPAD_2),
+            KEY(0x63, EAM_IO_KEYPAD_3),
+            KEY(0x64, EAM_IO_KEYPAD_4),
+            KEY(0x65, EAM_IO_KEYPAD_5),
+            KEY(0x66, EAM_IO_KEYPAD_6),
+            KEY(0x67, EAM_IO_KEYPAD_7),
+            KEY(0x68, EAM_IO_KEYPAD_8),
+            KEY(0x69, EAM_IO_KEYPAD_9),
+            KEY(0x6E, EAM_IO_KEYPAD_00),
+            KEY(0x6D, EAM_IO_KEYPAD_DECIMAL),
+        },
+    },
+    // HID keyboard page usages, as sent on the wire
+    {
+        .name = "hid",
+        .bits = {
+            KEY(0x62, EAM_IO_KEYPAD_0),
+            KEY(0x59, EAM_IO_KEYPAD_1),
+            KEY(0x5A, EAM_IO_KEYPAD_2),
+            KEY(0x5B, EAM_IO_KEYPAD_3),
+            KEY(0x5C, EAM_IO_KEYPAD_4),
+            KEY(0x5D, EAM_IO_KEYPAD_5),
+            KEY(0x5E, EAM_IO_KEYPAD_6),
+            KEY(0x5F, EAM_IO_KEYPAD_7),
+            KEY(0x60, EAM_IO_KEYPAD_8),
+            KEY(0x61, EAM_IO_KEYPAD_9),
+            KEY(0x63, EAM_IO_KEYPAD_00),
+            KEY(0x56, EAM_IO_KEYPAD_DECIMAL),
+        },
+    },
+    // Linux input event codes, KEY_KP0-9, KEY_KPDOT and KEY_KPMINUS
+    {
+        .name = "evdev",
+        .bits = {
+            KEY(82, EAM_IO_KEYPAD_0),
+            KEY(79, EAM_IO_KEYPAD_1),
+            KEY(80, EAM_IO_KEYPAD_2),
+            KEY(81, EAM_IO_KEYPAD_3),
+            KEY(75, EAM_IO_KEYPAD_4),
+            KEY(76, EAM_IO_KEYPAD_5),
+            KEY(77, EAM_IO_KEYPAD_6),
+            KEY(71, EAM_IO_KEYPAD_7),
+            KEY(72, EAM_IO_KEYPAD_8),
+            KEY(73, EAM_IO_KEYPAD_9),
+            KEY(83, EAM_IO_KEYPAD_00),
+            KEY(74, EAM_IO_KEYPAD_DECIMAL),
+        },
+    },
+};
+
+const keymap_t* keymap_find(const char* name) {
+    for(size_t i = 0; i < sizeof(keymaps) / sizeof(keymaps[0]); i++) {
+        if(strcmp(keymaps[i].name, name) == 0) {
+            return &keymaps[i];
+        }
+    }
+
+    return NULL;
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stdint.h>
+
+#define KEYMAP_SIZE 256
+
+// Key code -> keypad bitmap index, stored as index + 1 so unset entries read as unmapped
+typedef struct keymap {
+    const char* name;
+    uint8_t bits[KEYMAP_SIZE];
+} keymap_t;
+
+const keymap_t* keymap_find(const char* name);
+
+static inline int keymap_lookup(const keymap_t* keymap, const uint16_t code) {
+    if(code >= KEYMAP_SIZE) {
+        return -1;
+    }
+
+    return keymap->bits[code] - 1;
+}
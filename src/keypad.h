@@ -0,0 +1,24 @@
+#pragma once
+
+#include "transport.h"
+
+#include <stdbool.h>
+
+// Starts a thread that delivers keypad input to update_keypad_state() on its own
+bool keypad_start();
+// Stops what keypad_start() started and returns once its thread has exited, does nothing when not started
+void keypad_stop();
+// Hooks keypad input up to an I/O loop running on the calling thread
+bool keypad_register(io_loop_t* loop);
+// Undoes keypad_register(), on the same thread. Also cleans up after a keypad_register() that failed.
+void keypad_unregister(io_loop_t* loop);
+// Reads the keypad's own HID interface instead of the platform's keyboard input, call before anything else here
+void keypad_set_direct(bool enabled);
+// Name of the keymap matching the key codes this backend reports
+const char* keypad_default_keymap();
+// Called after every io_loop_wait() to handle keypad input that became ready
+void keypad_service();
+// When keypad_service() has to run again without being woken, pass to io_loop_wait(). TRANSPORT_NO_DEADLINE when never.
+uint64_t keypad_deadline();
+// Called from the hotplug thread when the keypad interface of unit index shows up at path again
+void keypad_arrival(int index, const char* path);
@@ -0,0 +1,82 @@
+#include "latency.h"
+#include "log.h"
+
+static const char* stage_names[LATENCY_STAGE_COUNT] = {
+    "card report -> publish",
+    "card publish -> poll",
+    "card poll -> read",
+    "keypad press queued -> poll",
+};
+
+static int bucket_index(const uint64_t value) {
+    if(value < LATENCY_LINEAR_LIMIT) {
+        return (int)value;
+    }
+
+    // Position of the highest set bit, at least 4 here. A fixed binary search, MSVC has no portable clz.
+    int exponent = 0;
+    uint64_t remaining = value;
+    for(int shift = 32; shift > 0; shift /= 2) {
+        if(remaining >> shift) {
+            remaining >>= shift;
+            exponent += shift;
+        }
+    }
+
+    const int sub_bucket = (int)(value >> (exponent - 3)) & (LATENCY_SUB_BUCKETS - 1);
+    return LATENCY_LINEAR_LIMIT + (exponent - 4) * LATENCY_SUB_BUCKETS + sub_bucket;
+}
+
+// Largest value that lands in the bucket, percentiles are reported as this bound
+static uint64_t bucket_upper_bound(const int index) {
+    if(index < LATENCY_LINEAR_LIMIT) {
+        return (uint64_t)index;
+    }
+
+    const int exponent = (index - LATENCY_LINEAR_LIMIT) / LATENCY_SUB_BUCKETS + 4;
+    const uint64_t sub_bucket = (uint64_t)((index - LATENCY_LINEAR_LIMIT) % LATENCY_SUB_BUCKETS);
+    const uint64_t width = 1ull << (exponent - 3);
+    return (1ull << exponent) + (sub_bucket + 1) * width - 1;
+}
+
+void latency_record(latency_histogram_t* histogram, const uint64_t elapsed_us) {
+    _Atomic uint32_t* bucket = &histogram->buckets[bucket_index(elapsed_us)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1, memory_order_relaxed);
+
+    if(elapsed_us > atomic_load_explicit(&histogram->max_us, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram->max_us, elapsed_us, memory_order_relaxed);
+    }
+}
+
+void latency_dump(const latency_histogram_t* histogram, const int unit, const latency_stage_t stage) {
+    uint32_t counts[LATENCY_BUCKET_COUNT];
+    uint64_t total = 0;
+    for(int i = 0; i < LATENCY_BUCKET_COUNT; i++) {
+        counts[i] = atomic_load_explicit(&histogram->buckets[i], memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if(total == 0) {
+        return;
+    }
+
+    const uint64_t targets[3] = {(total + 1) / 2, (total * 9 + 9) / 10, (total * 99 + 99) / 100};
+    uint64_t percentiles[3] = {0};
+    uint64_t seen = 0;
+    int target = 0;
+    for(int i = 0; i < LATENCY_BUCKET_COUNT && target < 3; i++) {
+        seen += counts[i];
+        while(target < 3 && seen >= targets[target]) {
+            percentiles[target++] = bucket_upper_bound(i);
+        }
+    }
+
+    log_info("Unit %d %s: %llu events, p50 %llu us, p90 %llu us, p99 %llu us, max %llu us\n",
+        unit,
+        stage_names[stage],
+        (unsigned long long)total,
+        (unsigned long long)percentiles[0],
+        (unsigned long long)percentiles[1],
+        (unsigned long long)percentiles[2],
+        (unsigned long long)atomic_load_explicit(&histogram->max_us, memory_order_relaxed));
+}
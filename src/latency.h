@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Log-linear buckets over microseconds: exact below 16 us, then 8 buckets per power of two,
+// so any value lands in a bucket less than 12.5% wide.
+#define LATENCY_LINEAR_LIMIT 16
+#define LATENCY_SUB_BUCKETS 8
+#define LATENCY_BUCKET_COUNT (LATENCY_LINEAR_LIMIT + (64 - 4) * LATENCY_SUB_BUCKETS)
+
+typedef enum latency_stage {
+    // Report completed by the transport until its card event is queued and published
+    LATENCY_CARD_PUBLISH,
+    // Card event queued until eam_io_poll() takes it
+    LATENCY_CARD_POLL,
+    // eam_io_poll() took the event until eam_io_read_card() first copied it out
+    LATENCY_CARD_READ,
+    // Key press queued by the keypad input path until eam_io_poll() applied it to the view
+    // eam_io_get_keypad_state() returns. Only presses are counted.
+    LATENCY_KEYPAD_POLL,
+    LATENCY_STAGE_COUNT,
+} latency_stage_t;
+
+// Each histogram has a single writer; the dump only needs counts that are roughly current
+typedef struct latency_histogram {
+    _Atomic uint32_t buckets[LATENCY_BUCKET_COUNT];
+    _Atomic uint64_t max_us;
+} latency_histogram_t;
+
+// 7-14 ns on a desktop x64 core, plus one clock_now_us() (about 30 ns) wherever the caller did not already have the time.
+// eamio_bench_latency measures it, a card event pays about 100 ns over its three stages.
+void latency_record(latency_histogram_t* histogram, uint64_t elapsed_us);
+void latency_dump(const latency_histogram_t* histogram, int unit, latency_stage_t stage);
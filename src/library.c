@@ -1,8 +1,11 @@
 #include "library.h"
 #include "aic.h"
+#include "clock.h"
+#include "log.h"
 #include "bemanitools/eamio.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <confuse.h>
 
 log_formatter_t misc_logger;
@@ -14,11 +17,23 @@ thread_create_t create_thread;
 thread_join_t join_thread;
 thread_destroy_t destroy_thread;
 
-uint8_t sensor_1_state = 0x03;
-uint8_t sensor_2_state = 0x03;
+// Runs initialize(), joined by eam_io_fini()
+static int init_thread = -1;
 
 // Config
 long int single_unit_no = 0;
+long int card_hold_ms = 2000;
+long int card_min_presence_ms = 100;
+long int card_cooldown_ms = 0;
+cfg_bool_t card_retap_extends = cfg_true;
+cfg_bool_t single_thread_io = cfg_false;
+cfg_bool_t keypad_direct = cfg_false;
+char* log_path = NULL;
+char* log_level = NULL;
+char* device_cache_path = NULL;
+char* trace_record_path = NULL;
+char* trace_replay_path = NULL;
+cfg_bool_t trace_replay_fast = cfg_false;
 
 __declspec(dllexport) void eam_io_set_loggers(
     const log_formatter_t misc,
@@ -41,13 +56,42 @@ __declspec(dllexport) bool eam_io_init(
     join_thread = thread_join;
     destroy_thread = thread_destroy;
 
-    create_thread(initialize, NULL, 0x4000, 0);
+    // Enumerating can take a while, the game keeps starting up meanwhile and sees no units until it's done
+    init_thread = create_thread(initialize, NULL, 0x4000, 0);
 
-    return true;
+    return init_thread >= 0;
 }
 
 __declspec(dllexport) void eam_io_fini(void) {
     misc_logger("aic_key_eamio", "Shutting down library");
+    if(init_thread < 0) {
+        return;
+    }
+
+    dump_latency();
+
+    const uint64_t start = clock_now_us();
+    request_stop();
+
+    // init() gives up at its next stage, so this is at most one stage of startup
+    int result;
+    join_thread(init_thread, &result);
+    destroy_thread(init_thread);
+    init_thread = -1;
+
+    fini();
+    log_info("Shut down in %llu us\n", (unsigned long long)(clock_now_us() - start));
+    log_stop();
+}
+
+// Not part of the bemanitools API. Logs the latency histograms without shutting down.
+__declspec(dllexport) void eam_io_ext_dump_latency(void) {
+    dump_latency();
+}
+
+// Not part of the bemanitools API. True once every unit is set up, for hosts that want to wait for it.
+__declspec(dllexport) bool eam_io_ext_ready(void) {
+    return get_unit_count() > 0;
 }
 
 __declspec(dllexport) uint16_t eam_io_get_keypad_state(uint8_t unit_no) {
@@ -55,7 +99,7 @@ __declspec(dllexport) uint16_t eam_io_get_keypad_state(uint8_t unit_no) {
 }
 
 __declspec(dllexport) uint8_t eam_io_get_sensor_state(uint8_t unit_no) {
-    uint8_t state = unit_no == 0 ? sensor_1_state : sensor_2_state;
+    uint8_t state = get_sensor_state(unit_no);
     // misc_logger("aic_key_eamio", "eam_io_get_sensor_state unit_no: %d, return: %d", unit_no, state);
     return state;
 }
@@ -73,12 +117,18 @@ __declspec(dllexport) bool eam_io_card_slot_cmd(uint8_t unit_no, uint8_t cmd) {
 
 __declspec(dllexport) bool eam_io_poll(uint8_t unit_no) {
     // misc_logger("aic_key_eamio", "eam_io_poll unit_no: %d", unit_no);
-    uint8_t* state = unit_no == 0 ? &sensor_1_state : &sensor_2_state;
+    poll_reader(unit_no);
+    poll_keypad(unit_no);
     bool inserted = get_reader_state(unit_no);
-    *state = inserted ? 0x03 : 0x00;
+    set_sensor_state(unit_no, inserted ? 0x03 : 0x00);
     return true;
 }
 
+// Not part of the bemanitools API. Hands raw card events to tools in batches, returns how many were written.
+__declspec(dllexport) int eam_io_ext_drain_card_events(uint8_t unit_no, card_event_t* events, int max_events) {
+    return drain_card_events(unit_no, events, max_events);
+}
+
 __declspec(dllexport) const struct eam_io_config_api* eam_io_get_config_api(void) {
     misc_logger("eam_io_get_config_api", "Returning NULL");
     return NULL;
@@ -89,39 +139,94 @@ int initialize(void* ctx) {
 
     cfg_opt_t opts[] = {
         CFG_SIMPLE_INT("single_unit_no", &single_unit_no),
+        CFG_SIMPLE_INT("card_hold_ms", &card_hold_ms),
+        CFG_SIMPLE_INT("card_min_presence_ms", &card_min_presence_ms),
+        CFG_SIMPLE_INT("card_cooldown_ms", &card_cooldown_ms),
+        CFG_SIMPLE_BOOL("card_retap_extends", &card_retap_extends),
+        CFG_SIMPLE_BOOL("single_thread_io", &single_thread_io),
+        CFG_SIMPLE_BOOL("keypad_direct", &keypad_direct),
+        CFG_STR_LIST("keypad_keymaps", "{}", CFGF_NONE),
+        CFG_SIMPLE_STR("log_file", &log_path),
+        CFG_SIMPLE_STR("log_level", &log_level),
+        CFG_SIMPLE_STR("device_cache", &device_cache_path),
+        CFG_SIMPLE_STR("trace_record", &trace_record_path),
+        CFG_SIMPLE_STR("trace_replay", &trace_replay_path),
+        CFG_SIMPLE_BOOL("trace_replay_fast", &trace_replay_fast),
         CFG_END()
     };
     cfg_t *cfg = cfg_init(opts, 0);
     cfg_parse(cfg, "eamio.conf");
 
-    printf("single_unit_no: %d\n", single_unit_no);
+    log_runtime_level = log_level_from_name(log_level);
+    log_start(log_path);
+
+    log_info("single_unit_no: %ld\n", single_unit_no);
+    log_info("card_hold_ms: %ld, card_min_presence_ms: %ld, card_cooldown_ms: %ld, card_retap_extends: %d\n",
+        card_hold_ms, card_min_presence_ms, card_cooldown_ms, card_retap_extends);
+    log_info("single_thread_io: %d, keypad_direct: %d\n", single_thread_io, keypad_direct);
+    if(trace_replay_path != NULL) {
+        log_info("trace_replay: %s, trace_replay_fast: %d\n", trace_replay_path, trace_replay_fast);
+    }
+
+    const int keymap_count = (int)cfg_size(cfg, "keypad_keymaps");
+    const char** keymaps = malloc(keymap_count * sizeof(char*));
+    for(int i = 0; i < keymap_count; i++) {
+        keymaps[i] = cfg_getnstr(cfg, "keypad_keymaps", i);
+    }
+
+    const aic_config_t config = {
+        .presence = {
+            .min_presence_us = (uint64_t)card_min_presence_ms * 1000,
+            .hold_us = (uint64_t)card_hold_ms * 1000,
+            .cooldown_us = (uint64_t)card_cooldown_ms * 1000,
+            .retap_extends = card_retap_extends,
+        },
+        .single_thread_io = single_thread_io,
+        .keypad_direct = keypad_direct,
+        .keymaps = keymaps,
+        .keymap_count = keymap_count,
+        // Off unless device_cache names a file, it would otherwise be written into the game's directory
+        .device_cache_path = device_cache_path,
+        .trace_record_path = trace_record_path,
+        .trace_replay_path = trace_replay_path,
+        .trace_replay_fast = trace_replay_fast,
+    };
 
-    init(misc_logger);
+    init(&config);
+
+    // init() copied or opened everything it needed. cfg_free() also frees the strings it stored in
+    // the globals above, they are cleared so the next initialize() doesn't see them.
+    free(keymaps);
+    cfg_free(cfg);
+    log_path = NULL;
+    log_level = NULL;
+    device_cache_path = NULL;
+    trace_record_path = NULL;
+    trace_replay_path = NULL;
     return 0;
 }
 
 void process_card_slot_cmd(uint8_t unit_no, uint8_t cmd) {
-    uint8_t* state = unit_no == 0 ? &sensor_1_state : &sensor_2_state;
     bool inserted = false;
 
     switch(cmd) {
         case EAM_IO_CARD_SLOT_CMD_CLOSE:
-            *state = 0x00;
+            set_sensor_state(unit_no, 0x00);
             break;
         case EAM_IO_CARD_SLOT_CMD_OPEN:
             inserted = get_reader_state(unit_no);
-            *state = inserted ? 0x03 : 0x00;
+            set_sensor_state(unit_no, inserted ? 0x03 : 0x00);
             break;
         case EAM_IO_CARD_SLOT_CMD_EJECT:
-            *state = 0x00;
+            set_sensor_state(unit_no, 0x00);
             break;
         case EAM_IO_CARD_SLOT_CMD_READ:
             inserted = get_reader_state(unit_no);
-            *state = inserted ? 0x03 : 0x00;
+            set_sensor_state(unit_no, inserted ? 0x03 : 0x00);
             break;
         default:
             break;
     }
 
-    // misc_logger("aic_key_eamio", "Unit %d: Card slot command %d, state: %d", unit_no, cmd, *state);
+    // misc_logger("aic_key_eamio", "Unit %d: Card slot command %d, state: %d", unit_no, cmd, get_sensor_state(unit_no));
 }
\ No newline at end of file
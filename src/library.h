@@ -1,9 +1,20 @@
 #ifndef AIC_KEY_EAMIO_LIBRARY_H
 #define AIC_KEY_EAMIO_LIBRARY_H
 
+#include "bemanitools/glue.h"
+
 #include <stdint.h>
 
+extern log_formatter_t misc_logger;
+extern log_formatter_t info_logger;
+extern log_formatter_t warning_logger;
+extern log_formatter_t fatal_logger;
+
+extern thread_create_t create_thread;
+extern thread_join_t join_thread;
+extern thread_destroy_t destroy_thread;
+
 int initialize(void* ctx);
 void process_card_slot_cmd(uint8_t unit_no, uint8_t cmd);
 
-#endif //AIC_KEY_EAMIO_LIBRARY_H
\ No newline at end of file
+#endif //AIC_KEY_EAMIO_LIBRARY_H
@@ -0,0 +1,18 @@
+#include "../clock.h"
+
+#include <time.h>
+
+uint64_t clock_now_us() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+void clock_sleep_ms(const uint32_t milliseconds) {
+    const struct timespec duration = {
+        .tv_sec = milliseconds / 1000,
+        .tv_nsec = (long)(milliseconds % 1000) * 1000000,
+    };
+    nanosleep(&duration, NULL);
+}
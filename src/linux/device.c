@@ -0,0 +1,190 @@
+#include "../device.h"
+#include "../device_group.h"
+#include "../arena.h"
+#include "../clock.h"
+#include "../log.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define HIDRAW_CLASS_PATH "/sys/class/hidraw"
+
+static bool read_sysfs_file(const char* path, char* buffer, const size_t size) {
+    FILE* file = fopen(path, "r");
+    if(file == NULL) {
+        return false;
+    }
+
+    const size_t length = fread(buffer, 1, size - 1, file);
+    fclose(file);
+    buffer[length] = '\0';
+
+    return length > 0;
+}
+
+// HID devices carry "HID_ID=<bus>:<vid>:<pid>" (hex) and "HID_PHYS=<location>/input<interface>" in their uevent.
+// Going by HID_PHYS rather than the sysfs topology keeps uhid test devices working, which have no USB parent.
+static bool read_hid_uevent(const char* hid_path, int* vid, int* pid, int* mi, char* location, const size_t location_size) {
+    char path[PATH_MAX];
+    char uevent[1024];
+    snprintf(path, sizeof(path), "%s/uevent", hid_path);
+    if(!read_sysfs_file(path, uevent, sizeof(uevent))) {
+        return false;
+    }
+
+    const char* hid_id = strstr(uevent, "HID_ID=");
+    const char* hid_phys = strstr(uevent, "HID_PHYS=");
+    if(hid_id == NULL || hid_phys == NULL) {
+        return false;
+    }
+
+    unsigned int bus, parsed_vid, parsed_pid;
+    if(sscanf(hid_id, "HID_ID=%x:%x:%x", &bus, &parsed_vid, &parsed_pid) != 3) {
+        return false;
+    }
+
+    hid_phys += strlen("HID_PHYS=");
+    const char* input = strstr(hid_phys, "/input");
+    const char* line_end = strchr(hid_phys, '\n');
+    if(input == NULL || (line_end != NULL && input > line_end)) {
+        return false;
+    }
+
+    *vid = (int)parsed_vid;
+    *pid = (int)parsed_pid;
+    *mi = (int)strtol(input + strlen("/input"), NULL, 10);
+    snprintf(location, location_size, "%.*s", (int)(input - hid_phys), hid_phys);
+    return true;
+}
+
+device_t* get_devices(int vid, int pid, int cardio_mi, int keypad_mi, int* device_count) {
+    *device_count = 0;
+
+    // Only hidraw nodes are looked at, and only their uevent is read before the VID/PID check
+    const uint64_t start = clock_now_us();
+    DIR* hidraw_class = opendir(HIDRAW_CLASS_PATH);
+    if(hidraw_class == NULL) {
+        log_error("Failed to open %s\n", HIDRAW_CLASS_PATH);
+        return NULL;
+    }
+
+    // Matched interfaces and their strings live here until grouped
+    arena_t arena = {0};
+    parsed_device_t* parsed_devices = NULL;
+    int parsed_device_count = 0;
+    int parsed_device_capacity = 0;
+
+    int node_count = 0;
+    const struct dirent* entry;
+    while((entry = readdir(hidraw_class)) != NULL) {
+        if(entry->d_name[0] == '.') {
+            continue;
+        }
+        node_count++;
+
+        char path[PATH_MAX];
+        char hid_path[PATH_MAX];
+        const int path_length = snprintf(path, sizeof(path), "%s/%s/device", HIDRAW_CLASS_PATH, entry->d_name);
+        if(path_length < 0 || (size_t)path_length >= sizeof(path) || realpath(path, hid_path) == NULL) {
+            continue;
+        }
+
+        int device_vid, device_pid, device_mi;
+        char location[DEVICE_LOCATION_SIZE];
+        if(!read_hid_uevent(hid_path, &device_vid, &device_pid, &device_mi, location, sizeof(location))) {
+            continue;
+        }
+
+        if(device_vid != vid || device_pid != pid) {
+            continue;
+        }
+
+        log_debug("Device: %s, location: %s, interface: %d\n", entry->d_name, location, device_mi);
+
+        parsed_device_t parsed_device = {
+            .location = arena_copy(&arena, location, strlen(location) + 1),
+        };
+        if(device_mi == cardio_mi) {
+            const int length = snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+            if(length < 0 || (size_t)length >= DEVICE_PATH_SIZE) {
+                log_warn("Device node name %s is too long, skipping it\n", entry->d_name);
+                continue;
+            }
+            parsed_device.cardio_path = arena_copy(&arena, path, length + 1);
+        }
+        else if(device_mi == keypad_mi) {
+            // The keypad interface is identified by its HID node, its evdev node hangs off of it
+            const size_t length = strlen(hid_path);
+            if(length >= DEVICE_PATH_SIZE) {
+                log_warn("Keypad HID path %s is too long, skipping it\n", hid_path);
+                continue;
+            }
+            parsed_device.keypad_identifier = arena_copy(&arena, hid_path, length + 1);
+        }
+
+        if(parsed_device_count == parsed_device_capacity) {
+            const int capacity = parsed_device_capacity == 0 ? 8 : parsed_device_capacity * 2;
+            parsed_devices = arena_grow(&arena, parsed_devices, parsed_device_capacity * sizeof(parsed_device_t), capacity * sizeof(parsed_device_t));
+            parsed_device_capacity = capacity;
+        }
+        parsed_devices[parsed_device_count++] = parsed_device;
+    }
+
+    closedir(hidraw_class);
+
+    device_t* devices = group_devices(&arena, parsed_devices, parsed_device_count, device_count);
+    arena_free(&arena);
+
+    log_info("Enumeration: %llu us over %d hidraw nodes, %d matched\n", (unsigned long long)(clock_now_us() - start), node_count, parsed_device_count);
+    return devices;
+}
+
+int match_device(const device_t* devices, const int device_count, const char* path, const int vid, const int pid, const int mi) {
+    // hidraw numbers are handed out again on every plug, so go by HID_PHYS instead of the node
+    const char* name = strrchr(path, '/');
+    name = name == NULL ? path : name + 1;
+
+    char sysfs_path[PATH_MAX];
+    char hid_path[PATH_MAX];
+    const int path_length = snprintf(sysfs_path, sizeof(sysfs_path), "%s/%s/device", HIDRAW_CLASS_PATH, name);
+    if(path_length < 0 || (size_t)path_length >= sizeof(sysfs_path) || realpath(sysfs_path, hid_path) == NULL) {
+        return -1;
+    }
+
+    int device_vid, device_pid, device_mi;
+    char location[DEVICE_LOCATION_SIZE];
+    if(!read_hid_uevent(hid_path, &device_vid, &device_pid, &device_mi, location, sizeof(location))) {
+        return -1;
+    }
+
+    if(device_vid != vid || device_pid != pid || device_mi != mi) {
+        return -1;
+    }
+
+    for(int i = 0; i < device_count; i++) {
+        if(strcmp(devices[i].location, location) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool match_keypad(const device_t* device, const int vid, const int pid, const int mi) {
+    // The identifier is the keypad's sysfs HID node, whose name changes whenever the device is enumerated again
+    char hid_path[PATH_MAX];
+    if(realpath(device->keypad_identifier, hid_path) == NULL) {
+        return false;
+    }
+
+    int device_vid, device_pid, device_mi;
+    char location[DEVICE_LOCATION_SIZE];
+    if(!read_hid_uevent(hid_path, &device_vid, &device_pid, &device_mi, location, sizeof(location))) {
+        return false;
+    }
+
+    return device_vid == vid && device_pid == pid && device_mi == mi && strcmp(device->location, location) == 0;
+}
@@ -0,0 +1,157 @@
+#include "../hotplug.h"
+#include "../library.h"
+#include "../log.h"
+
+#include <errno.h>
+#include <linux/netlink.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#define UEVENT_BUFFER_SIZE 4096
+// The kernel announces the node before udev has created it and set its permissions
+#define NODE_WAIT_ATTEMPTS 50
+#define NODE_WAIT_INTERVAL_MS 20
+
+static int uevent_socket = -1;
+// Written by hotplug_stop(), the watch thread waits on it next to the socket
+static int stop_fd = -1;
+static int watch_thread = -1;
+static hotplug_arrival_t arrival_callback = NULL;
+
+// Waits for the socket or a stop, and doubles as the sleep between node checks. False once stopped.
+static bool wait_uevent(const int timeout_ms) {
+    struct pollfd fds[2] = {
+        {
+            .fd = uevent_socket,
+            .events = POLLIN,
+        },
+        {
+            .fd = stop_fd,
+            .events = POLLIN,
+        },
+    };
+
+    if(poll(fds, 2, timeout_ms) < 0 && errno != EINTR) {
+        log_error("uevent poll failed, error: %s\n", strerror(errno));
+        return false;
+    }
+
+    return !(fds[1].revents & POLLIN);
+}
+
+// Kernel uevents are "<action>@<devpath>" followed by NUL separated KEY=value pairs
+static const char* find_uevent_value(const char* message, const size_t length, const char* key) {
+    const size_t key_length = strlen(key);
+    for(size_t offset = 0; offset < length; offset += strlen(message + offset) + 1) {
+        if(strncmp(message + offset, key, key_length) == 0 && message[offset + key_length] == '=') {
+            return message + offset + key_length + 1;
+        }
+    }
+
+    return NULL;
+}
+
+static int watch_uevents(void* param) {
+    char message[UEVENT_BUFFER_SIZE];
+
+    while(wait_uevent(-1)) {
+        const ssize_t length = recv(uevent_socket, message, sizeof(message) - 1, MSG_DONTWAIT);
+        if(length < 0) {
+            if(errno == EINTR || errno == ENOBUFS || errno == EAGAIN) {
+                continue;
+            }
+
+            log_error("uevent recv failed, error: %s\n", strerror(errno));
+            return 1;
+        }
+        message[length] = '\0';
+
+        if(strncmp(message, "add@", 4) != 0) {
+            continue;
+        }
+
+        const char* subsystem = find_uevent_value(message, (size_t)length, "SUBSYSTEM");
+        const char* device_name = find_uevent_value(message, (size_t)length, "DEVNAME");
+        if(subsystem == NULL || device_name == NULL || strcmp(subsystem, "hidraw") != 0) {
+            continue;
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "/dev/%s", device_name);
+        bool stopped = false;
+        for(int i = 0; i < NODE_WAIT_ATTEMPTS && !stopped && access(path, R_OK | W_OK) != 0; i++) {
+            stopped = !wait_uevent(NODE_WAIT_INTERVAL_MS);
+        }
+        if(stopped) {
+            break;
+        }
+
+        log_debug("HID interface arrived: %s\n", path);
+        arrival_callback(path);
+    }
+
+    return 0;
+}
+
+bool hotplug_start(const hotplug_arrival_t on_arrival) {
+    if(uevent_socket >= 0) {
+        return true;
+    }
+
+    arrival_callback = on_arrival;
+
+    uevent_socket = socket(AF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_KOBJECT_UEVENT);
+    if(uevent_socket < 0) {
+        log_error("Failed to open uevent socket, error: %s\n", strerror(errno));
+        return false;
+    }
+
+    // Group 1 carries the kernel's own events, which does not depend on udevd running
+    struct sockaddr_nl address = {
+        .nl_family = AF_NETLINK,
+        .nl_pid = 0,
+        .nl_groups = 1,
+    };
+    if(bind(uevent_socket, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        log_error("Failed to bind uevent socket, error: %s\n", strerror(errno));
+        close(uevent_socket);
+        uevent_socket = -1;
+        return false;
+    }
+
+    stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    watch_thread = stop_fd >= 0 ? create_thread(watch_uevents, NULL, 0x4000, 0) : -1;
+    if(watch_thread < 0) {
+        log_error("Failed to start the uevent thread\n");
+        hotplug_stop();
+        return false;
+    }
+
+    return true;
+}
+
+void hotplug_stop() {
+    if(watch_thread >= 0) {
+        const uint64_t stop = 1;
+        write(stop_fd, &stop, sizeof(stop));
+
+        int result;
+        join_thread(watch_thread, &result);
+        destroy_thread(watch_thread);
+        watch_thread = -1;
+    }
+
+    if(stop_fd >= 0) {
+        close(stop_fd);
+        stop_fd = -1;
+    }
+
+    if(uevent_socket >= 0) {
+        close(uevent_socket);
+        uevent_socket = -1;
+    }
+}
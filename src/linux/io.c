@@ -0,0 +1,255 @@
+#include "../transport.h"
+#include "../log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/hidraw.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define IO_LOOP_MAX_EVENTS 16
+
+struct transport {
+    int fd;
+    uint8_t* buffer;
+    uint32_t size;
+    bool readable;
+};
+
+struct transport_cancel {
+    int fd;
+};
+
+struct io_loop {
+    int epoll_fd;
+    int timer_fd;
+    int wake_fd;
+};
+
+transport_t* transport_open(const char* path) {
+    const int fd = open(path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if(fd < 0) {
+        log_error("Failed to open %s, error: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    transport_t* transport = calloc(1, sizeof(transport_t));
+    transport->fd = fd;
+
+    return transport;
+}
+
+void transport_close(transport_t* transport) {
+    if(transport == NULL) {
+        return;
+    }
+
+    close(transport->fd);
+    free(transport);
+}
+
+transport_result_t transport_begin_read(transport_t* transport, uint8_t* buffer, const uint32_t size) {
+    // hidraw reads are non-blocking, the buffer is only filled once the fd is readable
+    transport->buffer = buffer;
+    transport->size = size;
+    return TRANSPORT_OK;
+}
+
+transport_result_t transport_wait(transport_t* transport, transport_cancel_t* cancel, const uint32_t timeout_ms) {
+    // poll() skips negative fds, so a wait without a cancel signal is a single-fd wait
+    struct pollfd fds[2] = {
+        {
+            .fd = transport->fd,
+            .events = POLLIN,
+        },
+        {
+            .fd = cancel != NULL ? cancel->fd : -1,
+            .events = POLLIN,
+        },
+    };
+
+    const int result = poll(fds, 2, timeout_ms == TRANSPORT_INFINITE ? -1 : (int)timeout_ms);
+    if(result < 0) {
+        return errno == EINTR ? TRANSPORT_PENDING : TRANSPORT_ERROR;
+    }
+
+    if(fds[1].revents & POLLIN) {
+        return TRANSPORT_CANCELLED;
+    }
+
+    if(result == 0) {
+        return TRANSPORT_PENDING;
+    }
+
+    transport->readable = true;
+    return TRANSPORT_OK;
+}
+
+transport_result_t transport_complete_read(transport_t* transport, uint32_t* length) {
+    transport->readable = false;
+
+    const ssize_t bytes_read = read(transport->fd, transport->buffer, transport->size);
+    if(bytes_read < 0) {
+        if(errno == EAGAIN || errno == EINTR) {
+            return TRANSPORT_PENDING;
+        }
+
+        log_warn("read failed, error: %s\n", strerror(errno));
+        return TRANSPORT_ERROR;
+    }
+
+    // hidraw and evdev never return empty reads, end of file means the node hung up
+    if(bytes_read == 0) {
+        return TRANSPORT_ERROR;
+    }
+
+    *length = (uint32_t)bytes_read;
+    return TRANSPORT_OK;
+}
+
+bool transport_ready(const transport_t* transport) {
+    return transport->readable;
+}
+
+bool transport_get_report_layout(transport_t* transport, report_layout_t* layout) {
+    // 4 KB, too much for a reader thread's stack
+    struct hidraw_report_descriptor* descriptor = calloc(1, sizeof(*descriptor));
+    bool parsed = false;
+
+    if(ioctl(transport->fd, HIDIOCGRDESCSIZE, &descriptor->size) == 0 && ioctl(transport->fd, HIDIOCGRDESC, descriptor) == 0) {
+        parsed = report_descriptor_parse(descriptor->value, descriptor->size, layout);
+    }
+    else {
+        log_warn("Failed to read report descriptor, error: %s\n", strerror(errno));
+    }
+
+    free(descriptor);
+    return parsed;
+}
+
+transport_cancel_t* transport_cancel_create() {
+    const int fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(fd < 0) {
+        log_error("Failed to create cancel signal, error: %s\n", strerror(errno));
+        return NULL;
+    }
+
+    transport_cancel_t* cancel = calloc(1, sizeof(transport_cancel_t));
+    cancel->fd = fd;
+    return cancel;
+}
+
+// The eventfd is never read, so it stays readable for every wait after this one too
+void transport_cancel(transport_cancel_t* cancel) {
+    const uint64_t raised = 1;
+    write(cancel->fd, &raised, sizeof(raised));
+}
+
+void transport_cancel_destroy(transport_cancel_t* cancel) {
+    if(cancel == NULL) {
+        return;
+    }
+
+    close(cancel->fd);
+    free(cancel);
+}
+
+io_loop_t* io_loop_create() {
+    io_loop_t* loop = calloc(1, sizeof(io_loop_t));
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    loop->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    loop->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if(loop->epoll_fd < 0 || loop->timer_fd < 0 || loop->wake_fd < 0) {
+        log_error("Failed to create I/O loop, error: %s\n", strerror(errno));
+        io_loop_destroy(loop);
+        return NULL;
+    }
+
+    // The timer and the wake eventfd are the only entries without a transport attached
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = NULL,
+    };
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->timer_fd, &event);
+
+    event.data.ptr = loop;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, loop->wake_fd, &event);
+
+    return loop;
+}
+
+bool io_loop_add(io_loop_t* loop, transport_t* transport) {
+    struct epoll_event event = {
+        .events = EPOLLIN,
+        .data.ptr = transport,
+    };
+
+    return epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, transport->fd, &event) == 0;
+}
+
+void io_loop_remove(io_loop_t* loop, transport_t* transport) {
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, transport->fd, NULL);
+}
+
+void io_loop_wait(io_loop_t* loop, const uint64_t deadline_us) {
+    // clock_now_us() is CLOCK_MONOTONIC as well, so the deadline can be armed as an absolute time
+    struct itimerspec timer = {0};
+    if(deadline_us != TRANSPORT_NO_DEADLINE) {
+        timer.it_value.tv_sec = (time_t)(deadline_us / 1000000);
+        timer.it_value.tv_nsec = (long)(deadline_us % 1000000) * 1000;
+        if(timer.it_value.tv_sec == 0 && timer.it_value.tv_nsec == 0) {
+            timer.it_value.tv_nsec = 1;
+        }
+    }
+    timerfd_settime(loop->timer_fd, TFD_TIMER_ABSTIME, &timer, NULL);
+
+    struct epoll_event events[IO_LOOP_MAX_EVENTS];
+    const int count = epoll_wait(loop->epoll_fd, events, IO_LOOP_MAX_EVENTS, -1);
+
+    for(int i = 0; i < count; i++) {
+        transport_t* transport = events[i].data.ptr;
+        if(transport == NULL) {
+            uint64_t expirations;
+            read(loop->timer_fd, &expirations, sizeof(expirations));
+            continue;
+        }
+
+        if(events[i].data.ptr == loop) {
+            uint64_t wakeups;
+            read(loop->wake_fd, &wakeups, sizeof(wakeups));
+            continue;
+        }
+
+        transport->readable = true;
+    }
+}
+
+void io_loop_wake(io_loop_t* loop) {
+    const uint64_t wakeup = 1;
+    write(loop->wake_fd, &wakeup, sizeof(wakeup));
+}
+
+void io_loop_destroy(io_loop_t* loop) {
+    if(loop == NULL) {
+        return;
+    }
+
+    if(loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+    if(loop->timer_fd >= 0) {
+        close(loop->timer_fd);
+    }
+    if(loop->wake_fd >= 0) {
+        close(loop->wake_fd);
+    }
+    free(loop);
+}
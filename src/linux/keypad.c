@@ -0,0 +1,439 @@
+#include "../keypad.h"
+#include "../aic.h"
+#include "../library.h"
+#include "../clock.h"
+#include "../log.h"
+
+#include <glob.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <linux/input.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define KEYPAD_EVENT_BATCH 64
+// Boot keyboard report: modifiers, a reserved byte, then up to 6 HID usages of the keys held
+#define KEYPAD_BOOT_REPORT_BITS 64
+#define KEYPAD_BOOT_KEYS 6
+#define KEYPAD_USAGE_ERROR_ROLLOVER 0x01
+// udev sets the permissions of a re-plugged keypad's event node on its own time
+#define KEYPAD_NODE_WAIT_ATTEMPTS 25
+#define KEYPAD_NODE_WAIT_INTERVAL_MS 20
+
+typedef struct keypad_unit {
+    transport_t* transport;
+    union {
+        // evdev
+        struct input_event events[KEYPAD_EVENT_BATCH];
+        // Direct, one HID input report per read
+        uint8_t report[64];
+    };
+    // Direct: report ID of the keyboard report, 0 when the interface doesn't number its reports
+    uint8_t report_id;
+    // Direct: usages held as of the last report
+    uint8_t held[KEYPAD_BOOT_KEYS];
+    // Read by the hotplug thread, transport is only touched by the thread servicing the keypads
+    _Atomic bool attached;
+    // Set by keypad_arrival() once keypad_identifier points at the new node
+    _Atomic bool reopen_pending;
+    // Owned by the thread servicing the keypads: when to look for the evdev node again, 0 when not waiting
+    uint64_t reopen_at_us;
+    int reopen_attempts;
+} keypad_unit_t;
+
+static keypad_unit_t* keypad_units = NULL;
+static int keypad_count = 0;
+static bool direct = false;
+static io_loop_t* keypad_loop = NULL;
+// The loop keypad_register() added the keypads to, whichever thread runs it. Null until the units are set up.
+static _Atomic(io_loop_t*) service_loop = NULL;
+static int keypad_thread = -1;
+static _Atomic bool keypad_stopping = false;
+
+// The keypad's evdev node hangs off its HID node: <hid>/input/inputN/eventM
+static bool find_event_node(const char* hid_path, char* event_path, const size_t size) {
+    char pattern[DEVICE_PATH_SIZE + 32];
+    snprintf(pattern, sizeof(pattern), "%s/input/input*/event*", hid_path);
+
+    glob_t matches;
+    if(glob(pattern, 0, NULL, &matches) != 0 || matches.gl_pathc == 0) {
+        globfree(&matches);
+        return false;
+    }
+
+    const char* event_name = strrchr(matches.gl_pathv[0], '/') + 1;
+    snprintf(event_path, size, "/dev/input/%s", event_name);
+    globfree(&matches);
+
+    return true;
+}
+
+// The keypad interface's own hidraw node: <hid>/hidraw/hidrawN
+static bool find_hidraw_node(const char* hid_path, char* hidraw_path, const size_t size) {
+    char pattern[DEVICE_PATH_SIZE + 32];
+    snprintf(pattern, sizeof(pattern), "%s/hidraw/hidraw*", hid_path);
+
+    glob_t matches;
+    if(glob(pattern, 0, NULL, &matches) != 0 || matches.gl_pathc == 0) {
+        globfree(&matches);
+        return false;
+    }
+
+    snprintf(hidraw_path, size, "/dev/%s", strrchr(matches.gl_pathv[0], '/') + 1);
+    globfree(&matches);
+
+    return true;
+}
+
+// Only the boot keyboard format is understood, which is what the firmware sends
+static bool find_boot_report(keypad_unit_t* unit) {
+    report_layout_t layout;
+    if(!transport_get_report_layout(unit->transport, &layout)) {
+        return false;
+    }
+
+    for(int i = 0; i < layout.input_count; i++) {
+        if(layout.inputs[i].bits == KEYPAD_BOOT_REPORT_BITS) {
+            unit->report_id = layout.numbered ? layout.inputs[i].id : 0;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool begin_read(keypad_unit_t* unit) {
+    return transport_begin_read(unit->transport, direct ? unit->report : (uint8_t*)unit->events, direct ? sizeof(unit->report) : sizeof(unit->events)) == TRANSPORT_OK;
+}
+
+static bool open_keypad(const int index) {
+    char path[DEVICE_PATH_SIZE];
+    const bool found = direct
+        ? find_hidraw_node(devices[index].keypad_identifier, path, sizeof(path))
+        : find_event_node(devices[index].keypad_identifier, path, sizeof(path));
+    if(!found) {
+        return false;
+    }
+
+    transport_t* transport = transport_open(path);
+    if(transport == NULL) {
+        return false;
+    }
+
+    keypad_unit_t* unit = &keypad_units[index];
+    unit->transport = transport;
+    if(direct && !find_boot_report(unit)) {
+        log_warn("Keypad %d at %s does not send boot keyboard reports\n", index, path);
+        unit->transport = NULL;
+        transport_close(transport);
+        return false;
+    }
+
+    log_info("Keypad %d: %s\n", index, path);
+    return true;
+}
+
+static bool open_keypads() {
+    if(keypad_units != NULL) {
+        return keypad_count > 0;
+    }
+
+    keypad_units = calloc(device_count, sizeof(keypad_unit_t));
+    keypad_count = device_count;
+
+    bool opened = false;
+    for(int i = 0; i < keypad_count; i++) {
+        if(devices[i].keypad_identifier[0] == '\0' || !open_keypad(i)) {
+            log_warn("No keypad found for device %d\n", i);
+            continue;
+        }
+
+        if(!begin_read(&keypad_units[i])) {
+            transport_close(keypad_units[i].transport);
+            keypad_units[i].transport = NULL;
+            continue;
+        }
+
+        atomic_store(&keypad_units[i].attached, true);
+        opened = true;
+    }
+
+    return opened;
+}
+
+static bool is_held(const uint8_t* keys, const uint8_t usage) {
+    for(int i = 0; i < KEYPAD_BOOT_KEYS; i++) {
+        if(keys[i] == usage) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Reports list what is held rather than what changed, so edges come from comparing with the last one
+static void handle_boot_report(const int index, const uint32_t length) {
+    keypad_unit_t* unit = &keypad_units[index];
+    const uint32_t offset = unit->report_id != 0 ? 1 : 0;
+    if(length < offset + 2 + KEYPAD_BOOT_KEYS || (unit->report_id != 0 && unit->report[0] != unit->report_id)) {
+        return;
+    }
+
+    const uint8_t* keys = unit->report + offset + 2;
+    // Too many keys down, the report doesn't say which
+    if(keys[0] == KEYPAD_USAGE_ERROR_ROLLOVER) {
+        return;
+    }
+
+    for(int i = 0; i < KEYPAD_BOOT_KEYS; i++) {
+        if(unit->held[i] != 0 && !is_held(keys, unit->held[i])) {
+            update_keypad_state(index, unit->held[i], false);
+        }
+    }
+
+    for(int i = 0; i < KEYPAD_BOOT_KEYS; i++) {
+        if(keys[i] != 0 && !is_held(unit->held, keys[i])) {
+            update_keypad_state(index, keys[i], true);
+        }
+    }
+
+    memcpy(unit->held, keys, KEYPAD_BOOT_KEYS);
+}
+
+// A node that fails stays readable with POLLHUP/POLLERR, so it has to leave the loop. Keys it held
+// would otherwise stay down.
+static void close_keypad(const int index) {
+    keypad_unit_t* unit = &keypad_units[index];
+    log_warn("Keypad %d detached\n", index);
+
+    io_loop_remove(atomic_load(&service_loop), unit->transport);
+    transport_close(unit->transport);
+    unit->transport = NULL;
+    memset(unit->held, 0, sizeof(unit->held));
+    release_keypad(index);
+
+    atomic_store(&unit->attached, false);
+}
+
+// udev creates the evdev node after the hidraw one and sets its permissions on its own time
+static bool event_node_ready(const char* hid_path) {
+    char node_path[DEVICE_PATH_SIZE];
+    return find_event_node(hid_path, node_path, sizeof(node_path)) && access(node_path, R_OK | W_OK) == 0;
+}
+
+// On the thread servicing the keypads, after keypad_arrival() pointed the unit at its new node. Until the
+// evdev node is usable this only schedules another look, so neither this thread nor the hotplug one sleeps.
+static void reopen_keypad(const int index) {
+    keypad_unit_t* unit = &keypad_units[index];
+    if(!direct && unit->reopen_attempts < KEYPAD_NODE_WAIT_ATTEMPTS && !event_node_ready(devices[index].keypad_identifier)) {
+        unit->reopen_attempts++;
+        unit->reopen_at_us = clock_now_us() + KEYPAD_NODE_WAIT_INTERVAL_MS * 1000;
+        return;
+    }
+
+    unit->reopen_attempts = 0;
+    unit->reopen_at_us = 0;
+    if(open_keypad(index)) {
+        if(begin_read(unit)) {
+            io_loop_add(atomic_load(&service_loop), unit->transport);
+            atomic_store(&unit->attached, true);
+        }
+        else {
+            transport_close(unit->transport);
+            unit->transport = NULL;
+        }
+    }
+
+    atomic_store(&unit->reopen_pending, false);
+}
+
+// evdev: a single read() drains every event the kernel has queued, up to one batch.
+// Direct: one read() is one report.
+static void drain_keypad(const int index) {
+    keypad_unit_t* unit = &keypad_units[index];
+
+    uint32_t length = 0;
+    const transport_result_t result = transport_complete_read(unit->transport, &length);
+    if(result == TRANSPORT_ERROR) {
+        close_keypad(index);
+        return;
+    }
+    if(result != TRANSPORT_OK) {
+        return;
+    }
+
+    if(direct) {
+        handle_boot_report(index, length);
+        if(!begin_read(unit)) {
+            close_keypad(index);
+        }
+        return;
+    }
+
+    const uint32_t event_count = length / sizeof(struct input_event);
+    for(uint32_t i = 0; i < event_count; i++) {
+        const struct input_event* event = &unit->events[i];
+
+        // Value 2 is autorepeat, which doesn't change the bitmap
+        if(event->type != EV_KEY || event->value > 1) {
+            continue;
+        }
+
+        update_keypad_state(index, event->code, event->value == 1);
+    }
+
+    if(!begin_read(unit)) {
+        close_keypad(index);
+    }
+}
+
+static int run_keypads(void* param) {
+    io_loop_t* loop = param;
+
+    while(!atomic_load(&keypad_stopping)) {
+        io_loop_wait(loop, keypad_deadline());
+        keypad_service();
+    }
+
+    keypad_unregister(loop);
+    return EXIT_SUCCESS;
+}
+
+bool keypad_start() {
+    io_loop_t* loop = io_loop_create();
+    if(loop == NULL) {
+        return false;
+    }
+
+    // Keypads missing now attach through keypad_arrival() when plugged in, which needs the loop and the units
+    if(!keypad_register(loop)) {
+        log_warn("No keypad opened, waiting for one to be plugged in\n");
+    }
+
+    keypad_thread = create_thread(run_keypads, loop, 0x4000, 0);
+    if(keypad_thread < 0) {
+        keypad_unregister(loop);
+        io_loop_destroy(loop);
+        return false;
+    }
+
+    keypad_loop = loop;
+    return true;
+}
+
+void keypad_stop() {
+    if(keypad_thread < 0) {
+        return;
+    }
+
+    atomic_store(&keypad_stopping, true);
+    io_loop_wake(keypad_loop);
+
+    int result;
+    join_thread(keypad_thread, &result);
+    destroy_thread(keypad_thread);
+    io_loop_destroy(keypad_loop);
+
+    keypad_thread = -1;
+    keypad_loop = NULL;
+    atomic_store(&keypad_stopping, false);
+}
+
+bool keypad_register(io_loop_t* loop) {
+    const bool opened = open_keypads();
+
+    for(int i = 0; i < keypad_count; i++) {
+        if(keypad_units[i].transport != NULL) {
+            io_loop_add(loop, keypad_units[i].transport);
+        }
+    }
+
+    // Keypads that go missing are reopened on this loop once they are back, see keypad_arrival()
+    atomic_store(&service_loop, loop);
+    return opened;
+}
+
+void keypad_unregister(io_loop_t* loop) {
+    atomic_store(&service_loop, NULL);
+
+    for(int i = 0; i < keypad_count; i++) {
+        if(keypad_units[i].transport == NULL) {
+            continue;
+        }
+
+        if(loop != NULL) {
+            io_loop_remove(loop, keypad_units[i].transport);
+        }
+        transport_close(keypad_units[i].transport);
+    }
+
+    free(keypad_units);
+    keypad_units = NULL;
+    keypad_count = 0;
+}
+
+void keypad_service() {
+    const uint64_t now = clock_now_us();
+    for(int i = 0; i < keypad_count; i++) {
+        if(atomic_load(&keypad_units[i].reopen_pending) && keypad_units[i].transport == NULL && keypad_units[i].reopen_at_us <= now) {
+            reopen_keypad(i);
+        }
+
+        if(keypad_units[i].transport != NULL && transport_ready(keypad_units[i].transport)) {
+            drain_keypad(i);
+        }
+    }
+}
+
+uint64_t keypad_deadline() {
+    uint64_t deadline = TRANSPORT_NO_DEADLINE;
+    for(int i = 0; i < keypad_count; i++) {
+        if(keypad_units[i].reopen_at_us != 0 && keypad_units[i].reopen_at_us < deadline) {
+            deadline = keypad_units[i].reopen_at_us;
+        }
+    }
+
+    return deadline;
+}
+
+// path is the keypad interface's hidraw node. Its sysfs HID node becomes the new keypad_identifier,
+// which open_keypad() finds the evdev or hidraw node under.
+void keypad_arrival(const int index, const char* path) {
+    io_loop_t* loop = atomic_load(&service_loop);
+    if(loop == NULL || index < 0 || index >= keypad_count) {
+        return;
+    }
+
+    keypad_unit_t* unit = &keypad_units[index];
+    if(atomic_load(&unit->attached) || atomic_load(&unit->reopen_pending)) {
+        return;
+    }
+
+    const char* name = strrchr(path, '/');
+    name = name == NULL ? path : name + 1;
+
+    char sysfs_path[PATH_MAX];
+    char hid_path[PATH_MAX];
+    snprintf(sysfs_path, sizeof(sysfs_path), "/sys/class/hidraw/%s/device", name);
+    if(realpath(sysfs_path, hid_path) == NULL || strlen(hid_path) >= sizeof(devices[index].keypad_identifier)) {
+        return;
+    }
+
+    // The thread servicing the keypads waits for the evdev node, see reopen_keypad().
+    // Nothing else reads keypad_identifier until reopen_pending is set.
+    memcpy(devices[index].keypad_identifier, hid_path, strlen(hid_path) + 1);
+    log_info("Keypad %d arrived at %s, reopening\n", index, path);
+
+    atomic_store(&unit->reopen_pending, true);
+    io_loop_wake(loop);
+}
+
+void keypad_set_direct(const bool enabled) {
+    direct = enabled;
+}
+
+const char* keypad_default_keymap() {
+    return direct ? "hid" : "evdev";
+}
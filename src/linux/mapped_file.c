@@ -0,0 +1,40 @@
+#include "../mapped_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const uint8_t* mapped_file_open(const char* path, size_t* size) {
+    *size = 0;
+
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if(fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+    if(fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // The mapping keeps the file alive on its own
+    void* data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Replay walks it front to back once
+    madvise(data, (size_t)info.st_size, MADV_SEQUENTIAL);
+
+    *size = (size_t)info.st_size;
+    return data;
+}
+
+void mapped_file_close(const uint8_t* data, const size_t size) {
+    if(data != NULL) {
+        munmap((void*)data, size);
+    }
+}
@@ -1,44 +1,240 @@
 #include "log.h"
+#include "clock.h"
+#include "library.h"
 
 #include <stdarg.h>
+#include <stdatomic.h>
 #include <stdio.h>
+#include <string.h>
+
+#define LOG_RING_SIZE 1024
+#define LOG_DRAIN_INTERVAL_MS 10
+// Ends text log_write() had to cut, so a shortened path never passes for the whole one
+#define LOG_TRUNCATED_MARKER "..."
+
+typedef struct log_record {
+    _Atomic uint32_t sequence;
+    uint8_t level;
+    uint8_t event;
+    uint16_t data_length;
+    int32_t args[2];
+    uint8_t data[LOG_RECORD_DATA_SIZE];
+} log_record_t;
+
+// Bounded multi-producer queue: each slot's sequence tells producers and the drain whose turn it is.
+// Slot i stores its sequence minus i, so the zero-initialized ring is already valid before anyone starts.
+static log_record_t ring[LOG_RING_SIZE];
+static _Atomic uint32_t ring_head = 0;
+static uint32_t ring_tail = 0;
+static _Atomic uint32_t dropped = 0;
+static FILE* log_file = NULL;
+static int drain_thread = -1;
+static _Atomic bool drain_stopping = false;
+
+int log_runtime_level = LOG_LEVEL_INFO;
+
+static const char* level_names[] = {"trace", "debug", "info", "warn", "error", "off"};
+
+static uint32_t slot_sequence(const uint32_t position) {
+    const uint32_t index = position % LOG_RING_SIZE;
+    return atomic_load_explicit(&ring[index].sequence, memory_order_acquire) + index;
+}
+
+static void set_slot_sequence(const uint32_t position, const uint32_t sequence) {
+    const uint32_t index = position % LOG_RING_SIZE;
+    atomic_store_explicit(&ring[index].sequence, sequence - index, memory_order_release);
+}
+
+static log_record_t* ring_claim(uint32_t* position) {
+    uint32_t head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    while(true) {
+        const uint32_t sequence = slot_sequence(head);
+
+        if(sequence == head) {
+            if(atomic_compare_exchange_weak_explicit(&ring_head, &head, head + 1, memory_order_relaxed, memory_order_relaxed)) {
+                *position = head;
+                return &ring[head % LOG_RING_SIZE];
+            }
+        }
+        else if((int32_t)(sequence - head) < 0) {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            return NULL;
+        }
+        else {
+            head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+        }
+    }
+}
+
+static void format_record(const log_record_t* record, char* text, const size_t size) {
+    switch(record->event) {
+        case LOG_EVENT_CARD_REPORT: {
+            int written = snprintf(text, size, "Device %d [%d bytes]: Card type: %d, ", record->args[0], record->args[1], record->data[0]);
+            for(uint16_t i = 0; i < record->data_length && written > 0 && (size_t)written + 3 < size; i++) {
+                written += snprintf(text + written, size - written, "%02X", record->data[i]);
+            }
+            break;
+        }
+        case LOG_EVENT_READ_FAILED:
+            snprintf(text, size, "Failed to read from device %d", record->args[0]);
+            break;
+        default:
+            snprintf(text, size, "%.*s", record->data_length, (const char*)record->data);
+            break;
+    }
+
+    // The bemanitools loggers end lines themselves
+    const size_t length = strlen(text);
+    if(length > 0 && text[length - 1] == '\n') {
+        text[length - 1] = '\0';
+    }
+}
+
+static void write_text(const int level, const char* text) {
+    if(log_file != NULL) {
+        fprintf(log_file, "[%s] %s\n", level_names[level], text);
+        return;
+    }
+
+    // Never the fatal logger, that one aborts the process
+    log_formatter_t logger = misc_logger;
+    if(level >= LOG_LEVEL_WARN) {
+        logger = warning_logger;
+    }
+    else if(level == LOG_LEVEL_INFO) {
+        logger = info_logger;
+    }
+
+    if(logger != NULL) {
+        logger("aic_key_eamio", "%s", text);
+    }
+    else {
+        printf("%s\n", text);
+    }
+}
+
+static int drain_log(void* param) {
+    uint32_t reported_drops = 0;
+    char text[LOG_RECORD_DATA_SIZE * 2 + 64];
+    bool stopping;
+
+    // One more pass after log_stop(), so everything logged before it is written
+    do {
+        stopping = atomic_load(&drain_stopping);
+        bool drained = false;
+
+        while(slot_sequence(ring_tail) == ring_tail + 1) {
+            const log_record_t* record = &ring[ring_tail % LOG_RING_SIZE];
+            const int level = record->level;
+            format_record(record, text, sizeof(text));
+            set_slot_sequence(ring_tail, ring_tail + LOG_RING_SIZE);
+            ring_tail++;
+
+            write_text(level, text);
+            drained = true;
+        }
+
+        const uint32_t total_drops = atomic_load_explicit(&dropped, memory_order_relaxed);
+        if(total_drops != reported_drops) {
+            snprintf(text, sizeof(text), "Log ring full, dropped %u records", total_drops - reported_drops);
+            write_text(LOG_LEVEL_WARN, text);
+            reported_drops = total_drops;
+        }
+
+        if(drained && log_file != NULL) {
+            fflush(log_file);
+        }
+
+        if(!stopping) {
+            clock_sleep_ms(LOG_DRAIN_INTERVAL_MS);
+        }
+    } while(!stopping);
+
+    return 0;
+}
+
+void log_write(const int level, const char* fmt, ...) {
+    uint32_t position;
+    log_record_t* record = ring_claim(&position);
+    if(record == NULL) {
+        return;
+    }
 
-void my_log(const char* fmt, ...) {
-    // Pass to printf for now
     va_list args;
     va_start(args, fmt);
-    vprintf(fmt, args);
+    const int length = vsnprintf((char*)record->data, sizeof(record->data), fmt, args);
     va_end(args);
+
+    record->level = (uint8_t)level;
+    record->event = LOG_EVENT_TEXT;
+    record->data_length = length < 0 ? 0 : (length < (int)sizeof(record->data) ? length : (int)sizeof(record->data) - 1);
+    if(length >= (int)sizeof(record->data)) {
+        memcpy(record->data + sizeof(record->data) - sizeof(LOG_TRUNCATED_MARKER), LOG_TRUNCATED_MARKER, sizeof(LOG_TRUNCATED_MARKER));
+    }
+    set_slot_sequence(position, position + 1);
 }
 
-void log_windows_error(const char* text, const DWORD code) {
-    LPSTR error_text = get_error_text(code);
-    if(error_text == NULL) {
-        my_log(text);
+void log_event_write(const int level, const log_event_t event, const int32_t arg_0, const int32_t arg_1, const uint8_t* data, uint32_t data_length) {
+    uint32_t position;
+    log_record_t* record = ring_claim(&position);
+    if(record == NULL) {
+        return;
     }
-    else {
-        my_log("%s with error: %s", text, error_text);
-        LocalFree(error_text);
+
+    if(data_length > sizeof(record->data)) {
+        data_length = sizeof(record->data);
+    }
+
+    record->level = (uint8_t)level;
+    record->event = (uint8_t)event;
+    record->args[0] = arg_0;
+    record->args[1] = arg_1;
+    record->data_length = (uint16_t)data_length;
+    if(data_length > 0) {
+        memcpy(record->data, data, data_length);
     }
+    set_slot_sequence(position, position + 1);
+}
+
+bool log_start(const char* path) {
+    if(path != NULL && path[0] != '\0') {
+        log_file = fopen(path, "a");
+        if(log_file == NULL) {
+            log_error("Failed to open log file %s\n", path);
+        }
+    }
+
+    drain_thread = create_thread(drain_log, NULL, 0x4000, 0);
+    return drain_thread >= 0;
 }
 
-LPTSTR get_error_text(const int code) {
-    const LPTSTR message_buffer;
+void log_stop() {
+    if(drain_thread >= 0) {
+        atomic_store(&drain_stopping, true);
 
-    const size_t size = FormatMessage(
-        FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
-        NULL,
-        code,
-        MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
-        (LPTSTR)&message_buffer,
-        0,
-        NULL
-    );
+        int result;
+        join_thread(drain_thread, &result);
+        destroy_thread(drain_thread);
+        drain_thread = -1;
+        atomic_store(&drain_stopping, false);
+    }
+
+    if(log_file != NULL) {
+        fclose(log_file);
+        log_file = NULL;
+    }
+}
+
+uint32_t log_dropped() {
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
 
-    if(size == 0) {
-        my_log("FormatMessage failed with error code: %d\n", GetLastError());
-        return NULL;
+int log_level_from_name(const char* name) {
+    for(int i = 0; name != NULL && i < (int)(sizeof(level_names) / sizeof(level_names[0])); i++) {
+        if(strcmp(level_names[i], name) == 0) {
+            return i;
+        }
     }
 
-    return message_buffer;
+    return LOG_LEVEL_INFO;
 }
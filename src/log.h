@@ -1,10 +1,87 @@
 #ifndef LOG_H
 #define LOG_H
 
-#include <windows.h>
+#include <stdint.h>
+#include <stdbool.h>
 
-void my_log(const char* fmt, ...);
-void log_windows_error(const char* text, DWORD code);
-LPTSTR get_error_text(int code);
+#define LOG_LEVEL_TRACE 0
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO 2
+#define LOG_LEVEL_WARN 3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_OFF 5
 
-#endif
\ No newline at end of file
+// Set from the EAMIO_LOG_LEVEL CMake option, calls below it are not compiled in at all
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL LOG_LEVEL_TRACE
+#endif
+
+// Set from log_level in eamio.conf
+extern int log_runtime_level;
+
+#define LOG_AT(level, ...) do { if((level) >= log_runtime_level) log_write(level, __VA_ARGS__); } while(0)
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_TRACE
+#define log_trace(...) LOG_AT(LOG_LEVEL_TRACE, __VA_ARGS__)
+#else
+#define log_trace(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_DEBUG
+#define log_debug(...) LOG_AT(LOG_LEVEL_DEBUG, __VA_ARGS__)
+#else
+#define log_debug(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_INFO
+#define log_info(...) LOG_AT(LOG_LEVEL_INFO, __VA_ARGS__)
+#else
+#define log_info(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_WARN
+#define log_warn(...) LOG_AT(LOG_LEVEL_WARN, __VA_ARGS__)
+#else
+#define log_warn(...) ((void)0)
+#endif
+
+#if LOG_COMPILE_LEVEL <= LOG_LEVEL_ERROR
+#define log_error(...) LOG_AT(LOG_LEVEL_ERROR, __VA_ARGS__)
+#else
+#define log_error(...) ((void)0)
+#endif
+
+// Hot-path log records carry an event id and raw arguments, the drain thread formats them
+typedef enum log_event {
+    LOG_EVENT_TEXT,
+    LOG_EVENT_CARD_REPORT,
+    LOG_EVENT_READ_FAILED,
+} log_event_t;
+
+// Holds a MAX_PATH device path with the message around it, longer text is cut and ends in "..."
+#define LOG_RECORD_DATA_SIZE 320
+
+// level must be one of the LOG_LEVEL_* constants, so the compile-time check folds away
+#define log_event(level, event, arg_0, arg_1, data, data_length) do { \
+    if((level) >= LOG_COMPILE_LEVEL && (level) >= log_runtime_level) { \
+        log_event_write(level, event, arg_0, arg_1, data, data_length); \
+    } \
+} while(0)
+
+// Formats on the calling thread but never blocks on I/O, safe from any thread; text is cut to LOG_RECORD_DATA_SIZE - 1
+void log_write(int level, const char* fmt, ...);
+// Cheaper than log_write(), only copies the arguments; data is truncated to LOG_RECORD_DATA_SIZE
+void log_event_write(int level, log_event_t event, int32_t arg_0, int32_t arg_1, const uint8_t* data, uint32_t data_length);
+// Starts the drain thread, which writes to path if given, the bemanitools loggers otherwise
+bool log_start(const char* path);
+// Writes what is still queued and stops the drain thread, records logged after it wait for the next log_start()
+void log_stop();
+uint32_t log_dropped();
+// Returns LOG_LEVEL_INFO for unknown names
+int log_level_from_name(const char* name);
+
+// Windows only, code is a DWORD from GetLastError()
+void log_windows_error(const char* text, unsigned long code);
+char* get_error_text(int code);
+
+#endif
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Maps a whole file read-only. Returns NULL for missing or empty files.
+const uint8_t* mapped_file_open(const char* path, size_t* size);
+void mapped_file_close(const uint8_t* data, size_t size);
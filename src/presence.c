@@ -0,0 +1,107 @@
+#include "presence.h"
+
+#include <string.h>
+
+static presence_action_t accept_card(presence_t* presence, const card_record_t* card, const uint64_t now) {
+    presence->card[0] = (uint8_t)card->type;
+    memcpy(presence->card + 1, card->id, CARD_ID_SIZE);
+    presence->phase = PRESENCE_PRESENT;
+    presence->tapped_at = now;
+    presence->deadline = now + presence->config->min_presence_us;
+    presence->removed = false;
+
+    return PRESENCE_ACTION_PUBLISH_CARD;
+}
+
+static presence_action_t drop_card(presence_t* presence, const uint64_t now) {
+    if(presence->config->cooldown_us == 0) {
+        presence->phase = PRESENCE_IDLE;
+        presence->deadline = PRESENCE_NO_DEADLINE;
+    }
+    else {
+        presence->phase = PRESENCE_COOLDOWN;
+        presence->deadline = now + presence->config->cooldown_us;
+    }
+
+    return PRESENCE_ACTION_PUBLISH_CLEAR;
+}
+
+void presence_init(presence_t* presence, const presence_config_t* config) {
+    memset(presence, 0, sizeof(*presence));
+    presence->config = config;
+    presence->phase = PRESENCE_IDLE;
+    presence->deadline = PRESENCE_NO_DEADLINE;
+}
+
+presence_action_t presence_on_report(presence_t* presence, const card_record_t* card, const uint64_t now) {
+    if(card->type == CARD_TYPE_NONE) {
+        switch(presence->phase) {
+            case PRESENCE_PRESENT:
+                presence->removed = true;
+                return PRESENCE_ACTION_NONE;
+            case PRESENCE_HOLD:
+                return drop_card(presence, now);
+            default:
+                return PRESENCE_ACTION_NONE;
+        }
+    }
+
+    const bool same_card = presence->card[0] == card->type && memcmp(presence->card + 1, card->id, CARD_ID_SIZE) == 0;
+
+    switch(presence->phase) {
+        case PRESENCE_IDLE:
+            return accept_card(presence, card, now);
+        case PRESENCE_PRESENT:
+        case PRESENCE_HOLD:
+            if(!same_card) {
+                return accept_card(presence, card, now);
+            }
+
+            if(presence->config->retap_extends) {
+                presence->tapped_at = now;
+                presence->removed = false;
+                if(presence->phase == PRESENCE_HOLD) {
+                    presence->deadline = now + presence->config->hold_us;
+                }
+            }
+            return PRESENCE_ACTION_NONE;
+        case PRESENCE_COOLDOWN:
+            if(same_card) {
+                return PRESENCE_ACTION_NONE;
+            }
+            return accept_card(presence, card, now);
+        default:
+            return PRESENCE_ACTION_NONE;
+    }
+}
+
+presence_action_t presence_on_timer(presence_t* presence, const uint64_t now) {
+    if(now < presence->deadline) {
+        return PRESENCE_ACTION_NONE;
+    }
+
+    switch(presence->phase) {
+        case PRESENCE_PRESENT:
+            if(presence->removed || presence->config->hold_us <= presence->config->min_presence_us) {
+                return drop_card(presence, now);
+            }
+
+            presence->phase = PRESENCE_HOLD;
+            presence->deadline = presence->tapped_at + presence->config->hold_us;
+            return presence_on_timer(presence, now);
+        case PRESENCE_HOLD:
+            return drop_card(presence, now);
+        case PRESENCE_COOLDOWN:
+            presence->phase = PRESENCE_IDLE;
+            presence->deadline = PRESENCE_NO_DEADLINE;
+            memset(presence->card, 0, sizeof(presence->card));
+            return PRESENCE_ACTION_NONE;
+        default:
+            presence->deadline = PRESENCE_NO_DEADLINE;
+            return PRESENCE_ACTION_NONE;
+    }
+}
+
+uint64_t presence_deadline(const presence_t* presence) {
+    return presence->deadline;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "report_parser.h"
+
+typedef enum presence_phase {
+    PRESENCE_IDLE,
+    PRESENCE_PRESENT,
+    PRESENCE_HOLD,
+    PRESENCE_COOLDOWN,
+} presence_phase_t;
+
+typedef enum presence_action {
+    PRESENCE_ACTION_NONE,
+    PRESENCE_ACTION_PUBLISH_CARD,
+    PRESENCE_ACTION_PUBLISH_CLEAR,
+} presence_action_t;
+
+typedef struct presence_config {
+    // A tap stays visible for at least this long, even if the reader reports the card gone
+    uint64_t min_presence_us;
+    // A tap is dropped after this long unless the same card is tapped again
+    uint64_t hold_us;
+    // The card that was just dropped is ignored for this long
+    uint64_t cooldown_us;
+    // Whether a re-tap of the card that is currently held restarts its hold time
+    bool retap_extends;
+} presence_config_t;
+
+#define PRESENCE_NO_DEADLINE UINT64_MAX
+// Card type byte followed by the ID
+#define PRESENCE_CARD_SIZE (1 + CARD_ID_SIZE)
+
+// Card presence for one reader. Time is always passed in by the caller (microseconds on any
+// monotonic clock), so the machine itself never sleeps and never reads a clock.
+typedef struct presence {
+    const presence_config_t* config;
+    presence_phase_t phase;
+    uint64_t tapped_at;
+    uint64_t deadline;
+    bool removed;
+    uint8_t card[PRESENCE_CARD_SIZE];
+} presence_t;
+
+void presence_init(presence_t* presence, const presence_config_t* config);
+// card->type is CARD_TYPE_NONE once the reader reports the card gone
+presence_action_t presence_on_report(presence_t* presence, const card_record_t* card, uint64_t now);
+presence_action_t presence_on_timer(presence_t* presence, uint64_t now);
+uint64_t presence_deadline(const presence_t* presence);
@@ -0,0 +1,39 @@
+#include "reader_state.h"
+
+#include <string.h>
+
+#define SLOT_MASK 0x03
+#define SLOT_FRESH 0x04
+
+void reader_state_init(reader_state_t* state) {
+    memset(state->slots, 0, sizeof(state->slots));
+    state->front = 0;
+    state->back = 1;
+    state->spare = 3;
+    atomic_init(&state->middle, 2);
+}
+
+reader_snapshot_t* reader_state_back(reader_state_t* state) {
+    return &state->slots[state->back];
+}
+
+void reader_state_publish(reader_state_t* state) {
+    const uint8_t previous = atomic_exchange_explicit(&state->middle, state->back | SLOT_FRESH, memory_order_acq_rel);
+    state->back = previous & SLOT_MASK;
+}
+
+void reader_state_clear(reader_state_t* state) {
+    state->slots[state->spare].length = 0;
+    const uint8_t previous = atomic_exchange_explicit(&state->middle, state->spare | SLOT_FRESH, memory_order_acq_rel);
+    state->spare = previous & SLOT_MASK;
+}
+
+const reader_snapshot_t* reader_state_front(reader_state_t* state) {
+    // Only swap when the producer published something new, otherwise keep reading our own slot
+    if(atomic_load_explicit(&state->middle, memory_order_relaxed) & SLOT_FRESH) {
+        const uint8_t latest = atomic_exchange_explicit(&state->middle, state->front, memory_order_acq_rel);
+        state->front = latest & SLOT_MASK;
+    }
+
+    return &state->slots[state->front];
+}
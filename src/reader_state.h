@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+// Large enough for any full-speed HID input report, so ReadFile can fill a slot directly
+#define READER_REPORT_SIZE 64
+
+typedef struct reader_snapshot {
+    uint32_t length;
+    uint8_t report[READER_REPORT_SIZE];
+} reader_snapshot_t;
+
+// Triple buffer between one reader thread (producer) and the game thread (consumer).
+// The producer fills its back slot and publishes it by swapping it with the middle slot,
+// the consumer picks up the latest middle slot with a single atomic exchange.
+// Neither side ever waits on the other.
+// The producer also owns a spare slot, so it can publish a cleared state while a read
+// into the back slot is still in flight.
+typedef struct reader_state {
+    reader_snapshot_t slots[4];
+    _Atomic uint8_t middle;
+    uint8_t back;
+    uint8_t spare;
+    uint8_t front;
+} reader_state_t;
+
+void reader_state_init(reader_state_t* state);
+reader_snapshot_t* reader_state_back(reader_state_t* state);
+void reader_state_publish(reader_state_t* state);
+void reader_state_clear(reader_state_t* state);
+const reader_snapshot_t* reader_state_front(reader_state_t* state);
@@ -0,0 +1,194 @@
+#include "report_parser.h"
+#include "reader_state.h"
+
+#include <string.h>
+
+#define CARDIO_REPORT_ISO15693 1
+#define CARDIO_REPORT_FELICA 2
+// Nesting limit for Push items, real descriptors use one level at most
+#define DESCRIPTOR_STACK_SIZE 4
+// Largest report a full-speed interrupt endpoint can deliver is far below this
+#define REPORT_MAX_BITS (UINT16_MAX * 8u)
+
+// HID 1.11 section 6.2.2, short item prefixes with the size bits masked off
+#define ITEM_INPUT 0x80
+#define ITEM_REPORT_SIZE 0x74
+#define ITEM_REPORT_ID 0x84
+#define ITEM_REPORT_COUNT 0x94
+#define ITEM_PUSH 0xA4
+#define ITEM_POP 0xB4
+#define ITEM_LONG 0xFE
+
+typedef struct descriptor_globals {
+    uint32_t report_size;
+    uint32_t report_count;
+    uint8_t report_id;
+} descriptor_globals_t;
+
+bool report_layout_add(report_layout_t* layout, const uint8_t id, const uint32_t bits) {
+    for(int i = 0; i < layout->input_count; i++) {
+        if(layout->inputs[i].id == id) {
+            if(bits > REPORT_MAX_BITS - layout->inputs[i].bits) {
+                return false;
+            }
+            layout->inputs[i].bits += bits;
+            return true;
+        }
+    }
+
+    if(layout->input_count == REPORT_MAX_INPUTS || bits > REPORT_MAX_BITS) {
+        return false;
+    }
+
+    layout->inputs[layout->input_count++] = (report_input_t){.id = id, .bits = bits};
+    return true;
+}
+
+bool report_descriptor_parse(const uint8_t* descriptor, const size_t length, report_layout_t* layout) {
+    memset(layout, 0, sizeof(*layout));
+
+    descriptor_globals_t stack[DESCRIPTOR_STACK_SIZE];
+    int depth = 0;
+    descriptor_globals_t globals = {0};
+
+    size_t offset = 0;
+    while(offset < length) {
+        const uint8_t prefix = descriptor[offset++];
+
+        // Long items carry their own size and mean nothing here
+        if(prefix == ITEM_LONG) {
+            if(length - offset < 2 || length - offset - 2 < descriptor[offset]) {
+                return false;
+            }
+            offset += 2 + descriptor[offset];
+            continue;
+        }
+
+        const size_t size = (prefix & 0x03) == 3 ? 4 : prefix & 0x03;
+        if(length - offset < size) {
+            return false;
+        }
+
+        uint32_t value = 0;
+        for(size_t i = 0; i < size; i++) {
+            value |= (uint32_t)descriptor[offset + i] << (8 * i);
+        }
+        offset += size;
+
+        switch(prefix & 0xFC) {
+            case ITEM_REPORT_SIZE:
+                globals.report_size = value;
+                break;
+            case ITEM_REPORT_COUNT:
+                globals.report_count = value;
+                break;
+            case ITEM_REPORT_ID:
+                if(value == 0 || value > UINT8_MAX) {
+                    return false;
+                }
+                globals.report_id = (uint8_t)value;
+                layout->numbered = true;
+                break;
+            case ITEM_PUSH:
+                if(depth == DESCRIPTOR_STACK_SIZE) {
+                    return false;
+                }
+                stack[depth++] = globals;
+                break;
+            case ITEM_POP:
+                if(depth == 0) {
+                    return false;
+                }
+                globals = stack[--depth];
+                break;
+            case ITEM_INPUT:
+                if(globals.report_size > 0 && globals.report_count > REPORT_MAX_BITS / globals.report_size) {
+                    return false;
+                }
+                if(!report_layout_add(layout, globals.report_id, globals.report_size * globals.report_count)) {
+                    return false;
+                }
+                break;
+            default:
+                break;
+        }
+    }
+
+    return layout->input_count > 0;
+}
+
+bool report_parser_init(report_parser_t* parser, const report_layout_t* layout) {
+    if(!layout->numbered) {
+        return false;
+    }
+
+    report_parser_t parsed = {0};
+    bool has_card_report = false;
+    for(int i = 0; i < layout->input_count; i++) {
+        const report_input_t* input = &layout->inputs[i];
+        // Reads are READER_REPORT_SIZE bytes, a longer report would never arrive whole
+        const uint32_t length = 1 + (input->bits + 7) / 8;
+        if(length > READER_REPORT_SIZE) {
+            return false;
+        }
+
+        report_entry_t* entry = &parsed.reports[input->id];
+        entry->length = (uint16_t)length;
+
+        if(input->id == CARDIO_REPORT_ISO15693 || input->id == CARDIO_REPORT_FELICA) {
+            if(input->bits < CARD_ID_SIZE * 8) {
+                return false;
+            }
+            entry->type = input->id == CARDIO_REPORT_ISO15693 ? CARD_TYPE_ISO15693 : CARD_TYPE_FELICA;
+            has_card_report = true;
+        }
+    }
+
+    if(!has_card_report) {
+        return false;
+    }
+
+    *parser = parsed;
+    return true;
+}
+
+void report_parser_init_cardio(report_parser_t* parser) {
+    report_layout_t layout = {.numbered = true};
+    report_layout_add(&layout, CARDIO_REPORT_ISO15693, CARD_ID_SIZE * 8);
+    report_layout_add(&layout, CARDIO_REPORT_FELICA, CARD_ID_SIZE * 8);
+    report_parser_init(parser, &layout);
+}
+
+report_result_t report_parser_decode(const report_parser_t* parser, const uint8_t* report, const uint32_t length, card_record_t* card) {
+    card->type = CARD_TYPE_NONE;
+    card->id = NULL;
+
+    if(length == 0) {
+        return REPORT_NO_CARD;
+    }
+
+    // Report ID 0 is reserved, a numbered interface never sends it
+    if(report[0] == 0) {
+        return REPORT_MALFORMED;
+    }
+
+    const report_entry_t* entry = &parser->reports[report[0]];
+    if(entry->length == 0 || length < entry->length) {
+        return REPORT_MALFORMED;
+    }
+
+    if(entry->type == CARD_TYPE_NONE) {
+        return REPORT_IGNORED;
+    }
+
+    // An all-zero ID is how the reader says the card left the field
+    uint64_t id;
+    memcpy(&id, report + 1, sizeof(id));
+    if(id == 0) {
+        return REPORT_NO_CARD;
+    }
+
+    card->type = (card_type_t)entry->type;
+    card->id = report + 1;
+    return REPORT_CARD;
+}
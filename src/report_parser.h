@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Same values as eam_io_read_card_result
+typedef enum card_type {
+    CARD_TYPE_NONE = 0,
+    CARD_TYPE_ISO15693 = 1,
+    CARD_TYPE_FELICA = 2,
+} card_type_t;
+
+#define CARD_ID_SIZE 8
+#define REPORT_MAX_INPUTS 16
+
+typedef struct report_input {
+    uint8_t id;
+    uint32_t bits;
+} report_input_t;
+
+// Input reports of one HID interface, as declared by its report descriptor
+typedef struct report_layout {
+    // Reports start with their report ID byte
+    bool numbered;
+    int input_count;
+    report_input_t inputs[REPORT_MAX_INPUTS];
+} report_layout_t;
+
+// What one report says is on the reader
+typedef struct card_record {
+    card_type_t type;
+    // CARD_ID_SIZE bytes inside the report itself, NULL without a card
+    const uint8_t* id;
+} card_record_t;
+
+typedef enum report_result {
+    REPORT_CARD,
+    REPORT_NO_CARD,
+    // A report the interface declares but that carries no card, it says nothing about presence
+    REPORT_IGNORED,
+    // Shorter than its report ID says, report ID 0, or an ID the interface never declared
+    REPORT_MALFORMED,
+} report_result_t;
+
+typedef struct report_entry {
+    uint8_t type;
+    // Bytes a report with this ID needs, counting the ID itself. 0 for undeclared IDs.
+    uint16_t length;
+} report_entry_t;
+
+// Indexed by report ID, so decoding is one lookup and a length check
+typedef struct report_parser {
+    report_entry_t reports[256];
+} report_parser_t;
+
+// Adds an input item's bits to its report, false once the layout is full
+bool report_layout_add(report_layout_t* layout, uint8_t id, uint32_t bits);
+// Walks a raw HID report descriptor for its input reports. False for descriptors that don't parse.
+bool report_descriptor_parse(const uint8_t* descriptor, size_t length, report_layout_t* layout);
+
+// CardIO sends the card ID as report 1 for ISO15693 and report 2 for FeliCa. Returns false and leaves
+// the parser alone when the layout has neither, declares them too short for an ID, or declares any
+// report longer than READER_REPORT_SIZE.
+bool report_parser_init(report_parser_t* parser, const report_layout_t* layout);
+// The layout every CardIO interface is expected to have, for when the real one is unavailable
+void report_parser_init_cardio(report_parser_t* parser);
+report_result_t report_parser_decode(const report_parser_t* parser, const uint8_t* report, uint32_t length, card_record_t* card);
@@ -0,0 +1,34 @@
+#include "spsc_ring.h"
+
+#include <string.h>
+
+bool spsc_ring_push(spsc_ring_t* ring, void* slots, const uint32_t capacity, const size_t item_size, const void* item) {
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if(tail - head == capacity) {
+        return false;
+    }
+
+    memcpy((uint8_t*)slots + (tail & (capacity - 1)) * item_size, item, item_size);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+    return true;
+}
+
+int spsc_ring_peek(spsc_ring_t* ring, const void* slots, const uint32_t capacity, const size_t item_size, void* items, const int max_items) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+
+    int count = 0;
+    while(count < max_items && head + (uint32_t)count != tail) {
+        const uint32_t slot = (head + (uint32_t)count) & (capacity - 1);
+        memcpy((uint8_t*)items + (size_t)count * item_size, (const uint8_t*)slots + slot * item_size, item_size);
+        count++;
+    }
+
+    return count;
+}
+
+void spsc_ring_skip(spsc_ring_t* ring, const int count) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    atomic_store_explicit(&ring->head, head + (uint32_t)count, memory_order_release);
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Indices of a single producer, single consumer ring. The owner keeps the slots next to it and passes
+// them in with their count, which must be a power of two, and element size.
+// head and tail sit on separate cache lines so the two sides don't bounce one between them.
+typedef struct spsc_ring {
+    _Alignas(64) _Atomic uint32_t head;
+    _Alignas(64) _Atomic uint32_t tail;
+} spsc_ring_t;
+
+// Producer side. Returns false and drops the item when the consumer has fallen a whole ring behind
+bool spsc_ring_push(spsc_ring_t* ring, void* slots, uint32_t capacity, size_t item_size, const void* item);
+// Consumer side. Copies up to max_items of the oldest items without taking them
+int spsc_ring_peek(spsc_ring_t* ring, const void* slots, uint32_t capacity, size_t item_size, void* items, int max_items);
+// Consumer side. Takes count items, at most what the last peek returned
+void spsc_ring_skip(spsc_ring_t* ring, int count);
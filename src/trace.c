@@ -0,0 +1,165 @@
+#include "trace.h"
+#include "mapped_file.h"
+#include "reader_state.h"
+#include "log.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define TRACE_MAGIC 0x54434941 // "AICT"
+#define TRACE_VERSION 1
+
+typedef struct trace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t unit_count;
+} trace_header_t;
+
+static FILE* trace_file = NULL;
+
+// A new file gets a header, an existing one is only appended to when it has the same layout and units
+static bool check_header(FILE* file, const char* path, const int unit_count) {
+    const trace_header_t expected = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .record_size = sizeof(trace_record_t),
+        .unit_count = (uint32_t)unit_count,
+    };
+
+    fseek(file, 0, SEEK_END);
+    if(ftell(file) == 0) {
+        return fwrite(&expected, sizeof(expected), 1, file) == 1 && fflush(file) == 0;
+    }
+
+    trace_header_t header;
+    fseek(file, 0, SEEK_SET);
+    if(fread(&header, sizeof(header), 1, file) != 1 || memcmp(&header, &expected, sizeof(header)) != 0) {
+        log_warn("Trace %s was written by another build or for other units, not recording\n", path);
+        return false;
+    }
+
+    // Back to appending after a read
+    fseek(file, 0, SEEK_END);
+    return true;
+}
+
+bool trace_start(const char* path, const int unit_count) {
+    FILE* file = fopen(path, "a+b");
+    if(file == NULL) {
+        log_warn("Failed to open trace %s\n", path);
+        return false;
+    }
+
+    if(!check_header(file, path, unit_count)) {
+        fclose(file);
+        return false;
+    }
+
+    log_info("Recording card reports and key events to %s\n", path);
+    trace_file = file;
+    return true;
+}
+
+void trace_stop() {
+    if(trace_file == NULL) {
+        return;
+    }
+
+    fclose(trace_file);
+    trace_file = NULL;
+}
+
+// One fwrite per record, the CRT locks each call so records from different threads don't interleave.
+// Flushed every time: a trace is for chasing a misread, and the process that misread may not exit cleanly.
+static void write_record(const trace_record_t* record, const uint8_t* payload) {
+    uint8_t buffer[sizeof(trace_record_t) + READER_REPORT_SIZE];
+    memcpy(buffer, record, sizeof(*record));
+    if(record->length > 0) {
+        memcpy(buffer + sizeof(*record), payload, record->length);
+    }
+
+    fwrite(buffer, sizeof(*record) + record->length, 1, trace_file);
+    fflush(trace_file);
+}
+
+void trace_card_report(const int unit, const uint64_t now, const uint8_t* report, const uint32_t length) {
+    if(trace_file == NULL) {
+        return;
+    }
+
+    const trace_record_t record = {
+        .timestamp_us = now,
+        .unit = (uint8_t)unit,
+        .type = TRACE_CARD_REPORT,
+        .length = (uint16_t)(length < READER_REPORT_SIZE ? length : READER_REPORT_SIZE),
+    };
+    write_record(&record, report);
+}
+
+void trace_key(const int unit, const uint64_t now, const uint16_t key, const bool pressed) {
+    if(trace_file == NULL) {
+        return;
+    }
+
+    const trace_record_t record = {
+        .timestamp_us = now,
+        .unit = (uint8_t)unit,
+        .type = TRACE_KEY,
+        .value = key | (uint32_t)pressed << 16,
+    };
+    write_record(&record, NULL);
+}
+
+bool trace_open(trace_reader_t* reader, const char* path) {
+    memset(reader, 0, sizeof(*reader));
+
+    reader->data = mapped_file_open(path, &reader->size);
+    if(reader->data == NULL) {
+        log_error("Failed to open trace %s\n", path);
+        return false;
+    }
+
+    trace_header_t header;
+    if(reader->size < sizeof(header)) {
+        log_error("Trace %s is not a trace\n", path);
+        trace_close(reader);
+        return false;
+    }
+
+    memcpy(&header, reader->data, sizeof(header));
+    if(header.magic != TRACE_MAGIC
+        || header.version != TRACE_VERSION
+        || header.record_size != sizeof(trace_record_t)
+        || header.unit_count == 0
+        || header.unit_count > UINT8_MAX) {
+        log_error("Trace %s was written by another build\n", path);
+        trace_close(reader);
+        return false;
+    }
+
+    reader->offset = sizeof(header);
+    reader->unit_count = (int)header.unit_count;
+    return true;
+}
+
+bool trace_next(trace_reader_t* reader, trace_record_t* record, const uint8_t** payload) {
+    if(reader->size - reader->offset < sizeof(*record)) {
+        return false;
+    }
+
+    memcpy(record, reader->data + reader->offset, sizeof(*record));
+    if(record->length > READER_REPORT_SIZE || reader->size - reader->offset - sizeof(*record) < record->length) {
+        return false;
+    }
+
+    *payload = reader->data + reader->offset + sizeof(*record);
+    reader->offset += sizeof(*record) + record->length;
+    return true;
+}
+
+void trace_close(trace_reader_t* reader) {
+    mapped_file_close(reader->data, reader->size);
+    reader->data = NULL;
+    reader->size = 0;
+}
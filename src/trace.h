@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum trace_record_type {
+    // Raw CardIO input report, as read in scan() or the I/O loop
+    TRACE_CARD_REPORT = 1,
+    // Raw key code as seen by update_keypad_state(), before the keymap
+    TRACE_KEY = 2,
+} trace_record_type_t;
+
+// Fixed part of every record, followed by length bytes of payload. Records are packed back to back,
+// so they are copied out of the file rather than read in place.
+typedef struct trace_record {
+    // clock_now_us() when the report or key was seen
+    uint64_t timestamp_us;
+    uint8_t unit;
+    uint8_t type;
+    uint16_t length;
+    // TRACE_KEY: key code in the low 16 bits, 1 in bit 16 when pressed
+    uint32_t value;
+} trace_record_t;
+
+// Appends every report and key event to path until trace_stop(). A file written by another
+// build or for a different number of units is left alone and nothing is recorded.
+bool trace_start(const char* path, int unit_count);
+// Only once nothing can record any more, the file is closed under the writers' feet otherwise
+void trace_stop();
+void trace_card_report(int unit, uint64_t now, const uint8_t* report, uint32_t length);
+void trace_key(int unit, uint64_t now, uint16_t key, bool pressed);
+
+typedef struct trace_reader {
+    const uint8_t* data;
+    size_t size;
+    size_t offset;
+    int unit_count;
+} trace_reader_t;
+
+// Maps a recorded trace for replay
+bool trace_open(trace_reader_t* reader, const char* path);
+// Copies the next record out and points payload into the mapping. False at the end, or at a record cut short by a crash.
+bool trace_next(trace_reader_t* reader, trace_record_t* record, const uint8_t** payload);
+void trace_close(trace_reader_t* reader);
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "report_parser.h"
+
+#define TRANSPORT_INFINITE UINT32_MAX
+#define TRANSPORT_NO_DEADLINE UINT64_MAX
+
+typedef enum transport_result {
+    TRANSPORT_OK,
+    // Nothing to complete yet, either the wait timed out or the wakeup was spurious
+    TRANSPORT_PENDING,
+    TRANSPORT_ERROR,
+    // The wait's cancel signal was raised, see transport_cancel()
+    TRANSPORT_CANCELLED,
+} transport_result_t;
+
+// One open HID interface. Reads are split into begin/complete so a read can stay
+// queued while the caller waits on timers or on other transports.
+typedef struct transport transport_t;
+
+// Lets another thread break transport_wait() calls out of their wait, for shutting down
+typedef struct transport_cancel transport_cancel_t;
+
+transport_t* transport_open(const char* path);
+void transport_close(transport_t* transport);
+transport_result_t transport_begin_read(transport_t* transport, uint8_t* buffer, uint32_t size);
+// cancel may be NULL for a wait only the transport or the timeout ends
+transport_result_t transport_wait(transport_t* transport, transport_cancel_t* cancel, uint32_t timeout_ms);
+transport_result_t transport_complete_read(transport_t* transport, uint32_t* length);
+bool transport_ready(const transport_t* transport);
+// Input reports the interface declares in its report descriptor
+bool transport_get_report_layout(transport_t* transport, report_layout_t* layout);
+
+transport_cancel_t* transport_cancel_create();
+// Makes every pending and later transport_wait() given this signal return TRANSPORT_CANCELLED, safe to call from any thread
+void transport_cancel(transport_cancel_t* cancel);
+void transport_cancel_destroy(transport_cancel_t* cancel);
+
+// Waits on many transports, platform input and one deadline from a single thread
+typedef struct io_loop io_loop_t;
+
+io_loop_t* io_loop_create();
+bool io_loop_add(io_loop_t* loop, transport_t* transport);
+void io_loop_remove(io_loop_t* loop, transport_t* transport);
+// Returns once any transport is ready, platform input was serviced, or the clock_now_us() deadline passed
+void io_loop_wait(io_loop_t* loop, uint64_t deadline_us);
+// Makes a pending io_loop_wait() return early, safe to call from any thread
+void io_loop_wake(io_loop_t* loop);
+void io_loop_destroy(io_loop_t* loop);
@@ -0,0 +1,23 @@
+#include "../clock.h"
+
+#include <windows.h>
+
+static LARGE_INTEGER frequency = {0};
+
+uint64_t clock_now_us() {
+    if(frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+
+    // Split to avoid overflowing the multiplication on long uptimes
+    const uint64_t seconds = counter.QuadPart / frequency.QuadPart;
+    const uint64_t remainder = counter.QuadPart % frequency.QuadPart;
+    return seconds * 1000000 + remainder * 1000000 / frequency.QuadPart;
+}
+
+void clock_sleep_ms(const uint32_t milliseconds) {
+    Sleep(milliseconds);
+}
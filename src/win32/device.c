@@ -0,0 +1,443 @@
+#include "device_enum.h"
+#include "../arena.h"
+#include "../clock.h"
+#include "../log.h"
+
+#include <windows.h>
+#include <initguid.h>
+#include <devguid.h>
+#include <hidsdi.h>
+#include <tchar.h>
+#include <devpkey.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <hidclass.h>
+#include <cfgmgr32.h>
+
+void list_device_descriptions(HDEVINFO devices) {
+    if (devices == INVALID_HANDLE_VALUE) {
+        log_error("Failed to get device information set.\n");
+        return;
+    }
+
+    SP_DEVINFO_DATA devInfoData;
+    devInfoData.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    DWORD deviceIndex = 0;
+
+    while (SetupDiEnumDeviceInfo(devices, deviceIndex, &devInfoData)) {
+        deviceIndex++;
+
+        DWORD required_size = 0;
+        DEVPROPTYPE propertyType;
+        BOOL result = SetupDiGetDevicePropertyW(
+            devices,
+            &devInfoData,
+            &DEVPKEY_Device_BusReportedDeviceDesc,
+            &propertyType,
+            NULL,
+            0,
+            &required_size,
+            0
+        );
+        if(!result) {
+            log_trace("Failed to get required size for device %lu, error: %d\n", deviceIndex, GetLastError());
+        }
+        else {
+            log_trace("Size required for device %lu: %lu\n", deviceIndex, required_size);
+        }
+
+        WCHAR deviceDesc[1024];
+        DWORD requiredSize = 0;
+
+
+        // Initialize memory to avoid alignment issues
+        ZeroMemory(deviceDesc, sizeof(deviceDesc));
+
+        // Query the DEVPKEY_Device_BusReportedDeviceDesc property
+        if (SetupDiGetDevicePropertyW(devices, &devInfoData, &DEVPKEY_Device_BusReportedDeviceDesc,
+                                      &propertyType, (PBYTE)deviceDesc, sizeof(deviceDesc), 0, 0)) {
+            log_trace("Device %lu: %ls\n", deviceIndex, deviceDesc);
+                                      } else {
+                                          DWORD error = GetLastError();
+                                          if (error == ERROR_INSUFFICIENT_BUFFER) {
+                                              log_trace("Device %lu: Buffer size insufficient (required: %lu bytes).\n", deviceIndex, requiredSize);
+                                          } else if (error == ERROR_NOT_FOUND) {
+                                              log_trace("Device %lu: Description not available.\n", deviceIndex);
+                                          } else {
+                                              log_trace("Device %lu: Failed to get description, error: %lu\n", deviceIndex, error);
+                                          }
+                                      }
+    }
+
+    DWORD lastError = GetLastError();
+    if (lastError != ERROR_NO_MORE_ITEMS) {
+        log_error("Error during device enumeration: %lu\n", lastError);
+    }
+
+    SetupDiDestroyDeviceInfoList(devices);
+}
+
+// The HID collection's parent is its USB interface, whose parent is the composite device shared by
+// the CardIO and keypad interfaces. Its location tells the readers apart.
+static bool get_composite_location(const WCHAR* interface_id, CHAR* location, const size_t location_size) {
+    DEVINST interface_instance, composite_instance;
+    if(CM_Locate_DevNodeW(&interface_instance, (DEVINSTID_W)interface_id, CM_LOCATE_DEVNODE_NORMAL) != CR_SUCCESS) {
+        return false;
+    }
+    if(CM_Get_Parent(&composite_instance, interface_instance, 0) != CR_SUCCESS) {
+        return false;
+    }
+
+    ULONG size = (ULONG)location_size;
+    if(CM_Get_DevNode_Registry_PropertyA(composite_instance, CM_DRP_LOCATION_INFORMATION, NULL, location, &size, 0) == CR_SUCCESS) {
+        return true;
+    }
+
+    // Not every hub reports a location, the instance ID is just as unique
+    return CM_Get_Device_IDA(composite_instance, location, (ULONG)location_size, 0) == CR_SUCCESS;
+}
+
+// Cuts the instance part out of a keypad interface path in place, raw input device names contain it too.
+// The path is \\?\hid#<hardware ID>#<instance>#{<interface class>}, whichever MI the interface has.
+static CHAR* get_keypad_identifier(PSTR keypad_path) {
+    PCHAR hardware_id = strchr(keypad_path, '#');
+    PCHAR instance = hardware_id == NULL ? NULL : strchr(hardware_id + 1, '#');
+    PCHAR interface_class = strrchr(keypad_path, '#');
+    if(instance == NULL || interface_class <= instance) {
+        return NULL;
+    }
+    *interface_class = '\0';
+
+    return instance + 1;
+}
+
+device_t* get_devices(int vid, int pid, int cardio_mi, int keypad_mi, int* device_count) {
+    const uint64_t query_start = clock_now_us();
+    const HDEVINFO devices = get_device_info();
+    if(devices == NULL) {
+        return NULL;
+    }
+    const uint64_t walk_start = clock_now_us();
+
+    // Everything up to the final device_t table lives here and goes away in one arena_free()
+    arena_t arena = {0};
+    parsed_device_t* parsed_devices = NULL;
+    int parsed_device_count = 0;
+    int parsed_device_capacity = 0;
+    uint64_t properties_us = 0;
+
+    DWORD device_index = 0;
+    SP_DEVINFO_DATA device_info_data;
+    device_info_data.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    while(SetupDiEnumDeviceInfo(devices, device_index, &device_info_data)) {
+        device_index++;
+        device_info_data.cbSize = sizeof(SP_DEVINFO_DATA);
+
+        // The instance ID carries VID, PID and MI, so everything else is only queried for our own interfaces
+        WCHAR device_id[MAX_DEVICE_ID_LEN];
+        if(!SetupDiGetDeviceInstanceIdW(devices, &device_info_data, device_id, MAX_DEVICE_ID_LEN, NULL)) {
+            continue;
+        }
+
+        device_details_t details;
+        if(!get_device_details(device_id, &details) || details.vid != vid || details.pid != pid) {
+            continue;
+        }
+
+        const uint64_t properties_start = clock_now_us();
+
+        if(parsed_device_count == parsed_device_capacity) {
+            const int capacity = parsed_device_capacity == 0 ? 8 : parsed_device_capacity * 2;
+            parsed_devices = arena_grow(&arena, parsed_devices, parsed_device_capacity * sizeof(parsed_device_t), capacity * sizeof(parsed_device_t));
+            parsed_device_capacity = capacity;
+        }
+        parsed_device_t* parsed_device = &parsed_devices[parsed_device_count];
+        parsed_device_count++;
+        memset(parsed_device, 0, sizeof(parsed_device_t));
+
+        log_trace("Device ID: %ls\n", device_id);
+
+        LPWSTR parent = get_string_property(&arena, devices, &device_info_data, &DEVPKEY_Device_Parent, NULL);
+        if(parent != NULL) {
+            log_trace("Parent: %ls\n", parent);
+
+            // Interfaces of one composite device share its location, which is what groups them
+            CHAR* location = arena_alloc(&arena, MAX_DEVICE_ID_LEN);
+            if(get_composite_location(parent, location, MAX_DEVICE_ID_LEN)) {
+                parsed_device->location = location;
+                log_trace("Location information: %s\n", location);
+            }
+        }
+
+        DWORD interface_index = 0;
+        SP_DEVICE_INTERFACE_DATA device_interface_data;
+        device_interface_data.cbSize = sizeof(SP_DEVICE_INTERFACE_DATA);
+        while(SetupDiEnumDeviceInterfaces(devices, &device_info_data, &GUID_DEVINTERFACE_HID, interface_index, &device_interface_data)) {
+            interface_index++;
+
+            DWORD required_size = 0;
+            SetupDiGetDeviceInterfaceDetail(devices, &device_interface_data, NULL, 0, &required_size, NULL);
+            if(required_size == 0) {
+                log_windows_error("SetupDiGetDeviceInterfaceDetail failed", GetLastError());
+                continue;
+            }
+
+            PSP_INTERFACE_DEVICE_DETAIL_DATA interface_detail_data = arena_alloc(&arena, required_size);
+            interface_detail_data->cbSize = sizeof(SP_INTERFACE_DEVICE_DETAIL_DATA);
+            if(!SetupDiGetDeviceInterfaceDetail(devices, &device_interface_data, interface_detail_data, required_size, NULL, NULL)) {
+                log_windows_error("SetupDiGetDeviceInterfaceDetail failed", GetLastError());
+                continue;
+            }
+
+            log_trace("Device path: %s\n", interface_detail_data->DevicePath);
+
+            if(details.mi == cardio_mi) {
+                parsed_device->cardio_path = interface_detail_data->DevicePath;
+            }
+            else if(details.mi == keypad_mi) {
+                parsed_device->keypad_identifier = get_keypad_identifier(interface_detail_data->DevicePath);
+            }
+        }
+
+        if(interface_index == 0) {
+            log_windows_error("SetupDiEnumDeviceInterfaces failed", GetLastError());
+        }
+
+        properties_us += clock_now_us() - properties_start;
+    }
+
+    SetupDiDestroyDeviceInfoList(devices);
+    const uint64_t group_start = clock_now_us();
+
+    log_debug("Parsed device count: %d\n", parsed_device_count);
+    for(int i = 0; i < parsed_device_count; i++) {
+        log_trace("Parsed device %d:\n", i);
+        log_trace("Location: %s\n", parsed_devices[i].location);
+        log_trace("CardIO path: %s\n", parsed_devices[i].cardio_path);
+        log_trace("Keypad identifier: %s\n", parsed_devices[i].keypad_identifier);
+    }
+
+    log_debug("Grouping devices...\n");
+    device_t* grouped = group_devices(&arena, parsed_devices, parsed_device_count, device_count);
+    arena_free(&arena);
+    const uint64_t end = clock_now_us();
+
+    log_info("Enumeration: query %llu us, filter %llu us over %lu interfaces, properties %llu us for %d, grouping %llu us\n",
+        (unsigned long long)(walk_start - query_start),
+        (unsigned long long)(group_start - walk_start - properties_us),
+        device_index,
+        (unsigned long long)properties_us,
+        parsed_device_count,
+        (unsigned long long)(end - group_start));
+
+    return grouped;
+}
+
+HDEVINFO get_device_info() {
+    // Only present HID interfaces, rather than every device on the machine
+    // An interface class, GUID_DEVCLASS_HIDCLASS is a setup class and matches no interfaces here
+    const HDEVINFO devices = SetupDiGetClassDevs(&GUID_DEVINTERFACE_HID, NULL, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if(devices == INVALID_HANDLE_VALUE) {
+        log_windows_error("SetupDiGetClassDevs failed", GetLastError());
+        return NULL;
+    }
+
+    return devices;
+}
+
+bool get_device_details(LPCWSTR device_id, device_details_t* details) {
+    WCHAR uppercase_device_id[MAX_DEVICE_ID_LEN];
+    if(wcscpy_s(uppercase_device_id, MAX_DEVICE_ID_LEN, device_id) != 0) {
+        return false;
+    }
+    _wcsupr_s(uppercase_device_id, MAX_DEVICE_ID_LEN);
+
+    const WCHAR* vid_pos = wcsstr(uppercase_device_id, L"VID_");
+    const WCHAR* pid_pos = wcsstr(uppercase_device_id, L"PID_");
+    const WCHAR* mi_pos = wcsstr(uppercase_device_id, L"MI_");
+
+    if(vid_pos == NULL || pid_pos == NULL || mi_pos == NULL) {
+        return false;
+    }
+
+    details->vid = wcstol(vid_pos + 4, NULL, 16);
+    details->pid = wcstol(pid_pos + 4, NULL, 16);
+    details->mi = wcstol(mi_pos + 3, NULL, 16);
+
+    return true;
+}
+
+DWORD get_required_property_size(const HDEVINFO devices, PSP_DEVINFO_DATA device_info_data, const DEVPROPKEY* property_key) {
+    DEVPROPTYPE property_type;
+    DWORD required_size = 0;
+
+    SetupDiGetDevicePropertyW(
+        devices,
+        device_info_data,
+        property_key,
+        &property_type,
+        NULL,
+        0,
+        &required_size,
+        0
+    );
+
+    if(required_size == 0) {
+        DWORD error = GetLastError();
+        if(error != ERROR_NOT_FOUND) {
+            log_windows_error("SetupDiGetDevicePropertyW for required size failed", GetLastError());
+        }
+
+        return 0;
+    }
+
+    return required_size;
+}
+
+LPWSTR get_string_property(arena_t* arena, const HDEVINFO devices, PSP_DEVINFO_DATA device_info_data, const DEVPROPKEY* property_key, DWORD* size_out) {
+    const DWORD size = get_required_property_size(devices, device_info_data, property_key);
+    if(size == 0) {
+        return NULL;
+    }
+
+    DEVPROPTYPE property_type;
+    LPWSTR buffer = arena_alloc(arena, size);
+
+    const BOOL result = SetupDiGetDevicePropertyW(
+        devices,
+        device_info_data,
+        property_key,
+        &property_type,
+        (PBYTE)buffer,
+        size,
+        NULL,
+        0
+    );
+
+    if(!result) {
+        log_windows_error("SetupDiGetDevicePropertyW for string property failed", GetLastError());
+        return NULL;
+    }
+
+    if(size_out != NULL) {
+        *size_out = size;
+    }
+
+    return buffer;
+}
+
+BOOL validate_device(const char* device_path, const int vid, const int pid, const int mi, const bool capitalized) {
+    if (capitalized) {
+        const char* vid_pos = strstr(device_path, "VID_");
+        if(vid_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_vid = strtol(vid_pos + 4, NULL, 16);
+
+        const char* pid_pos = strstr(device_path, "PID_");
+        if(pid_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_pid = strtol(pid_pos + 4, NULL, 16);
+
+        const char* mi_pos = strstr(device_path, "MI_");
+        if(mi_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_mi = strtol(mi_pos + 3, NULL, 16);
+
+        return parsed_vid == vid && parsed_pid == pid && parsed_mi == mi;
+    }
+    else {
+        const char* vid_pos = strstr(device_path, "vid_");
+        if(vid_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_vid = strtol(vid_pos + 4, NULL, 16);
+
+        const char* pid_pos = strstr(device_path, "pid_");
+        if(pid_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_pid = strtol(pid_pos + 4, NULL, 16);
+
+        const char* mi_pos = strstr(device_path, "mi_");
+        if(mi_pos == NULL) {
+            return FALSE;
+        }
+        const int parsed_mi = strtol(mi_pos + 3, NULL, 16);
+
+        return parsed_vid == vid && parsed_pid == pid && parsed_mi == mi;
+    }
+}
+
+bool get_parent_device_id(const char* device_name, char* parent_id, size_t parent_id_size) {
+    HDEVINFO device_info_set = SetupDiGetClassDevs(NULL, device_name, NULL, DIGCF_PRESENT | DIGCF_DEVICEINTERFACE);
+    if (device_info_set == INVALID_HANDLE_VALUE) {
+        log_error("SetupDiGetClassDevs failed, error: %lu\n", GetLastError());
+        return false;
+    }
+
+    SP_DEVINFO_DATA device_info_data = {0};
+    device_info_data.cbSize = sizeof(SP_DEVINFO_DATA);
+
+    if (!SetupDiEnumDeviceInfo(device_info_set, 0, &device_info_data)) {
+        log_error("SetupDiEnumDeviceInfo failed, error: %lu\n", GetLastError());
+        SetupDiDestroyDeviceInfoList(device_info_set);
+        return false;
+    }
+
+    DEVPROPTYPE property_type;
+    if (!SetupDiGetDevicePropertyW(
+            device_info_set,
+            &device_info_data,
+            &DEVPKEY_Device_Parent,
+            &property_type,
+            (PBYTE)parent_id,
+            (DWORD)parent_id_size,
+            NULL,
+            0)) {
+        log_error("SetupDiGetDeviceProperty failed, error: %lu\n", GetLastError());
+        SetupDiDestroyDeviceInfoList(device_info_set);
+        return false;
+    }
+
+    SetupDiDestroyDeviceInfoList(device_info_set);
+    return true;
+}
+
+int match_device(const device_t* devices, const int device_count, const char* path, const int vid, const int pid, const int mi) {
+    if(!validate_device(path, vid, pid, mi, false) && !validate_device(path, vid, pid, mi, true)) {
+        return -1;
+    }
+
+    // A reader that comes back on the same port gets the same interface path, only the case may differ
+    for(int i = 0; i < device_count; i++) {
+        if(_stricmp(devices[i].cardio_path, path) == 0) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+bool match_keypad(const device_t* device, const int vid, const int pid, const int mi) {
+    // The identifier is the instance part of the keypad's interface path, see get_keypad_identifier()
+    char path[MAX_PATH];
+    const int length = snprintf(path, sizeof(path), "\\\\?\\hid#vid_%04x&pid_%04x&mi_%02d#%s#{4d1e55b2-f16f-11cf-88cb-001111000030}",
+        vid, pid, mi, device->keypad_identifier);
+    if(length < 0 || (size_t)length >= sizeof(path)) {
+        return false;
+    }
+
+    // Keyboards can't be opened for reading, but opening them for nothing still tells whether they are there
+    const HANDLE handle = CreateFileA(path, 0, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, NULL);
+    if(handle == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    CloseHandle(handle);
+    return true;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include "../device.h"
+#include "../device_group.h"
+#include "../arena.h"
+
+#include <windows.h>
+#include <setupapi.h>
+#include <stdint.h>
+
+HDEVINFO get_device_info();
+bool get_device_details(LPCWSTR device_id, device_details_t* details);
+DWORD get_required_property_size(HDEVINFO devices, PSP_DEVINFO_DATA device_info_data, const DEVPROPKEY* property_key);
+LPWSTR get_string_property(arena_t* arena, HDEVINFO devices, PSP_DEVINFO_DATA device_info_data, const DEVPROPKEY* property_key, DWORD* size_out);
+bool get_parent_device_id(const char* device_name, char* parent_id, size_t parent_id_size);
+BOOL validate_device(const char* device_path, int vid, int pid, int mi, bool capitalized);
@@ -0,0 +1,59 @@
+#include "../hotplug.h"
+#include "../log.h"
+
+#include <stdio.h>
+#include <windows.h>
+#include <cfgmgr32.h>
+#include <hidclass.h>
+
+static HCMNOTIFICATION notification = NULL;
+static hotplug_arrival_t arrival_callback = NULL;
+
+static DWORD CALLBACK on_notification(HCMNOTIFICATION handle, PVOID context, CM_NOTIFY_ACTION action, PCM_NOTIFY_EVENT_DATA event_data, DWORD event_data_size) {
+    if(action != CM_NOTIFY_ACTION_DEVICEINTERFACEARRIVAL) {
+        return ERROR_SUCCESS;
+    }
+
+    // Interface paths are plain ASCII, so the ANSI path compares against what SetupAPI handed out at startup
+    char path[MAX_PATH];
+    if(WideCharToMultiByte(CP_ACP, 0, event_data->u.DeviceInterface.SymbolicLink, -1, path, sizeof(path), NULL, NULL) == 0) {
+        return ERROR_SUCCESS;
+    }
+
+    log_debug("HID interface arrived: %s\n", path);
+    arrival_callback(path);
+
+    return ERROR_SUCCESS;
+}
+
+bool hotplug_start(const hotplug_arrival_t on_arrival) {
+    if(notification != NULL) {
+        return true;
+    }
+
+    arrival_callback = on_arrival;
+
+    CM_NOTIFY_FILTER filter = {0};
+    filter.cbSize = sizeof(filter);
+    filter.FilterType = CM_NOTIFY_FILTER_TYPE_DEVICEINTERFACE;
+    filter.u.DeviceInterface.ClassGuid = GUID_DEVINTERFACE_HID;
+
+    const CONFIGRET result = CM_Register_Notification(&filter, NULL, on_notification, &notification);
+    if(result != CR_SUCCESS) {
+        log_error("CM_Register_Notification failed, error: %lu\n", result);
+        notification = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void hotplug_stop() {
+    if(notification == NULL) {
+        return;
+    }
+
+    // Waits for a callback that is already running, which is why it's never called from one
+    CM_Unregister_Notification(notification);
+    notification = NULL;
+}
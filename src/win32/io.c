@@ -0,0 +1,251 @@
+#include "../transport.h"
+#include "../clock.h"
+#include "../log.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+#include <hidsdi.h>
+
+struct transport {
+    HANDLE file;
+    OVERLAPPED overlapped;
+};
+
+struct transport_cancel {
+    HANDLE event;
+};
+
+// events[0] is the wake event, transports follow it
+struct io_loop {
+    HANDLE events[MAXIMUM_WAIT_OBJECTS - 1];
+    int event_count;
+};
+
+transport_t* transport_open(const char* path) {
+    const HANDLE file = CreateFile(
+        path,
+        GENERIC_READ | GENERIC_WRITE,
+        FILE_SHARE_READ | FILE_SHARE_WRITE,
+        NULL,
+        OPEN_EXISTING,
+        FILE_FLAG_OVERLAPPED,
+        NULL
+    );
+
+    if(file == INVALID_HANDLE_VALUE) {
+        log_error("Failed to open %s, error: %lu\n", path, GetLastError());
+        return NULL;
+    }
+
+    transport_t* transport = calloc(1, sizeof(transport_t));
+    transport->file = file;
+    transport->overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+
+    return transport;
+}
+
+void transport_close(transport_t* transport) {
+    if(transport == NULL) {
+        return;
+    }
+
+    // Make sure the kernel is done writing into the caller's buffer before handing it back
+    DWORD bytes_read;
+    if(CancelIoEx(transport->file, &transport->overlapped)) {
+        GetOverlappedResult(transport->file, &transport->overlapped, &bytes_read, TRUE);
+    }
+
+    CloseHandle(transport->overlapped.hEvent);
+    CloseHandle(transport->file);
+    free(transport);
+}
+
+transport_result_t transport_begin_read(transport_t* transport, uint8_t* buffer, const uint32_t size) {
+    if(!ReadFile(transport->file, buffer, size, NULL, &transport->overlapped) && GetLastError() != ERROR_IO_PENDING) {
+        log_warn("ReadFile failed, error: %lu\n", GetLastError());
+        return TRANSPORT_ERROR;
+    }
+
+    return TRANSPORT_OK;
+}
+
+transport_result_t transport_wait(transport_t* transport, transport_cancel_t* cancel, const uint32_t timeout_ms) {
+    if(cancel == NULL) {
+        switch(WaitForSingleObject(transport->overlapped.hEvent, timeout_ms)) {
+            case WAIT_OBJECT_0:
+                return TRANSPORT_OK;
+            case WAIT_TIMEOUT:
+                return TRANSPORT_PENDING;
+            default:
+                return TRANSPORT_ERROR;
+        }
+    }
+
+    // The lowest signalled index wins, so a raised cancel is seen even with a read completed
+    const HANDLE events[2] = {cancel->event, transport->overlapped.hEvent};
+    switch(WaitForMultipleObjects(2, events, FALSE, timeout_ms)) {
+        case WAIT_OBJECT_0:
+            return TRANSPORT_CANCELLED;
+        case WAIT_OBJECT_0 + 1:
+            return TRANSPORT_OK;
+        case WAIT_TIMEOUT:
+            return TRANSPORT_PENDING;
+        default:
+            return TRANSPORT_ERROR;
+    }
+}
+
+transport_result_t transport_complete_read(transport_t* transport, uint32_t* length) {
+    DWORD bytes_read = 0;
+    if(!GetOverlappedResult(transport->file, &transport->overlapped, &bytes_read, FALSE)) {
+        if(GetLastError() == ERROR_IO_INCOMPLETE) {
+            return TRANSPORT_PENDING;
+        }
+
+        log_warn("GetOverlappedResult failed, error: %lu\n", GetLastError());
+        return TRANSPORT_ERROR;
+    }
+
+    *length = bytes_read;
+    return TRANSPORT_OK;
+}
+
+bool transport_ready(const transport_t* transport) {
+    return HasOverlappedIoCompleted(&transport->overlapped);
+}
+
+// Windows keeps the raw descriptor to itself, the parsed caps give the same per-report sizes
+bool transport_get_report_layout(transport_t* transport, report_layout_t* layout) {
+    memset(layout, 0, sizeof(*layout));
+
+    PHIDP_PREPARSED_DATA preparsed;
+    if(!HidD_GetPreparsedData(transport->file, &preparsed)) {
+        log_warn("HidD_GetPreparsedData failed, error: %lu\n", GetLastError());
+        return false;
+    }
+
+    HIDP_CAPS caps;
+    bool parsed = HidP_GetCaps(preparsed, &caps) == HIDP_STATUS_SUCCESS;
+
+    USHORT value_count = parsed ? caps.NumberInputValueCaps : 0;
+    HIDP_VALUE_CAPS* values = calloc(value_count + 1, sizeof(HIDP_VALUE_CAPS));
+    if(value_count > 0 && HidP_GetValueCaps(HidP_Input, values, &value_count, preparsed) != HIDP_STATUS_SUCCESS) {
+        parsed = false;
+    }
+
+    for(USHORT i = 0; parsed && i < value_count; i++) {
+        layout->numbered |= values[i].ReportID != 0;
+        parsed = report_layout_add(layout, values[i].ReportID, (uint32_t)values[i].BitSize * values[i].ReportCount);
+    }
+    free(values);
+
+    USHORT button_count = parsed ? caps.NumberInputButtonCaps : 0;
+    HIDP_BUTTON_CAPS* buttons = calloc(button_count + 1, sizeof(HIDP_BUTTON_CAPS));
+    if(button_count > 0 && HidP_GetButtonCaps(HidP_Input, buttons, &button_count, preparsed) != HIDP_STATUS_SUCCESS) {
+        parsed = false;
+    }
+
+    for(USHORT i = 0; parsed && i < button_count; i++) {
+        const uint32_t bits = buttons[i].IsRange ? buttons[i].Range.UsageMax - buttons[i].Range.UsageMin + 1 : 1;
+        layout->numbered |= buttons[i].ReportID != 0;
+        parsed = report_layout_add(layout, buttons[i].ReportID, bits);
+    }
+    free(buttons);
+
+    HidD_FreePreparsedData(preparsed);
+    return parsed && layout->input_count > 0;
+}
+
+transport_cancel_t* transport_cancel_create() {
+    // Manual reset, so it stays signalled for every wait after this one too
+    const HANDLE event = CreateEvent(NULL, TRUE, FALSE, NULL);
+    if(event == NULL) {
+        log_error("Failed to create cancel signal, error: %lu\n", GetLastError());
+        return NULL;
+    }
+
+    transport_cancel_t* cancel = calloc(1, sizeof(transport_cancel_t));
+    cancel->event = event;
+    return cancel;
+}
+
+void transport_cancel(transport_cancel_t* cancel) {
+    SetEvent(cancel->event);
+}
+
+void transport_cancel_destroy(transport_cancel_t* cancel) {
+    if(cancel == NULL) {
+        return;
+    }
+
+    CloseHandle(cancel->event);
+    free(cancel);
+}
+
+io_loop_t* io_loop_create() {
+    io_loop_t* loop = calloc(1, sizeof(io_loop_t));
+    loop->events[0] = CreateEvent(NULL, FALSE, FALSE, NULL);
+    if(loop->events[0] == NULL) {
+        log_error("Failed to create I/O loop, error: %lu\n", GetLastError());
+        free(loop);
+        return NULL;
+    }
+
+    loop->event_count = 1;
+    return loop;
+}
+
+bool io_loop_add(io_loop_t* loop, transport_t* transport) {
+    if(loop->event_count >= MAXIMUM_WAIT_OBJECTS - 1) {
+        return false;
+    }
+
+    loop->events[loop->event_count] = transport->overlapped.hEvent;
+    loop->event_count++;
+    return true;
+}
+
+void io_loop_remove(io_loop_t* loop, transport_t* transport) {
+    for(int i = 1; i < loop->event_count; i++) {
+        if(loop->events[i] != transport->overlapped.hEvent) {
+            continue;
+        }
+
+        loop->event_count--;
+        loop->events[i] = loop->events[loop->event_count];
+        return;
+    }
+}
+
+void io_loop_wait(io_loop_t* loop, const uint64_t deadline_us) {
+    DWORD timeout = INFINITE;
+    if(deadline_us != TRANSPORT_NO_DEADLINE) {
+        const uint64_t now = clock_now_us();
+        timeout = deadline_us <= now ? 0 : (DWORD)((deadline_us - now + 999) / 1000);
+    }
+
+    // Raw input for windows owned by this thread arrives through the message queue
+    const DWORD wait = MsgWaitForMultipleObjects(loop->event_count, loop->events, FALSE, timeout, QS_ALLINPUT);
+    if(wait == WAIT_OBJECT_0 + loop->event_count) {
+        MSG msg;
+        while(PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            TranslateMessage(&msg);
+            DispatchMessage(&msg);
+        }
+    }
+}
+
+void io_loop_wake(io_loop_t* loop) {
+    SetEvent(loop->events[0]);
+}
+
+void io_loop_destroy(io_loop_t* loop) {
+    if(loop == NULL) {
+        return;
+    }
+
+    CloseHandle(loop->events[0]);
+    free(loop);
+}
@@ -0,0 +1,289 @@
+#include "../keypad.h"
+#include "../aic.h"
+#include "../device.h"
+#include "../library.h"
+#include "../handle_cache.h"
+#include "../log.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <windows.h>
+
+#define KBD_DEVICE_USAGE_KEYBOARD 0x00010006
+#define KBD_DEVICE_USAGE_KEYPAD 0x00010007
+
+static HWND window = NULL;
+static WNDPROC orig_proc = NULL;
+static HHOOK hook = NULL;
+// Our own window when geninput's msg-thread window isn't there
+static bool own_window = false;
+static handle_cache_t keypad_handles;
+static int keypad_thread = -1;
+static DWORD keypad_thread_id = 0;
+// Set once the keypad thread has a message queue, so keypad_stop() can post to it
+static HANDLE keypad_queue_ready = NULL;
+
+static int resolve_keypad_unit(const HANDLE device) {
+    int device_index = HANDLE_CACHE_NO_UNIT;
+    if(handle_cache_lookup(&keypad_handles, (uintptr_t)device, &device_index)) {
+        return device_index;
+    }
+
+    char device_name[512];
+    UINT name_size = sizeof(device_name);
+    if(GetRawInputDeviceInfoA(device, RIDI_DEVICENAME, device_name, &name_size) == (UINT)-1) {
+        device_name[0] = '\0';
+    }
+
+    for(int i = 0; device_name[0] != '\0' && i < device_count; i++) {
+        if(devices[i].keypad_identifier[0] != '\0' && strstr(device_name, devices[i].keypad_identifier) != NULL) {
+            device_index = i;
+        }
+    }
+
+    // Unrelated keyboards are cached too, so they only ever cost one lookup
+    handle_cache_insert(&keypad_handles, (uintptr_t)device, device_index);
+    return device_index;
+}
+
+static void ProcessRawInput(LPARAM lParam) {
+    RAWINPUT raw;
+    UINT size = sizeof(raw);
+
+    if(GetRawInputData((HRAWINPUT)lParam, RID_INPUT, &raw, &size, sizeof(RAWINPUTHEADER)) == (UINT)-1) {
+        return;
+    }
+
+    if(raw.header.dwType != RIM_TYPEKEYBOARD || raw.header.hDevice == NULL) {
+        return;
+    }
+
+    const int device_index = resolve_keypad_unit(raw.header.hDevice);
+    if(device_index == HANDLE_CACHE_NO_UNIT) {
+        return;
+    }
+
+    update_keypad_state(device_index, raw.data.keyboard.VKey, !(raw.data.keyboard.Flags & RI_KEY_BREAK));
+}
+
+static LRESULT CALLBACK HiddenWndProc(HWND hwnd, UINT uMsg, WPARAM wParam, LPARAM lParam) {
+    if (uMsg == WM_INPUT) {
+        ProcessRawInput(lParam);
+    }
+    else if (uMsg == WM_INPUT_DEVICE_CHANGE) {
+        // Handles can be reused once a device goes away
+        handle_cache_clear(&keypad_handles);
+    }
+
+    if(orig_proc) {
+        return orig_proc(hwnd, uMsg, wParam, lParam);
+    }
+
+    return DefWindowProc(hwnd, uMsg, wParam, lParam);
+}
+
+bool keypad_register(io_loop_t* loop) {
+    window = FindWindow(
+        "msg-thread",
+        NULL
+    );
+
+    if(!window) {
+        WNDCLASS wc = {0};
+        wc.lpfnWndProc = HiddenWndProc;
+        wc.hInstance = GetModuleHandle(NULL);
+        wc.lpszClassName = "aic-key-input";
+
+        if(!RegisterClass(&wc)) {
+            log_error("Failed to register window class\n");
+            return false;
+        }
+
+        window = CreateWindow(
+            wc.lpszClassName,
+            "aic-key-input-window",
+            WS_MINIMIZE,
+            CW_USEDEFAULT, 0,
+            CW_USEDEFAULT, 0,
+            HWND_MESSAGE,
+            NULL,
+            wc.hInstance,
+            NULL
+        );
+        own_window = true;
+    }
+    else {
+        HINSTANCE geninput_dll = GetModuleHandle("geninput.dll");
+        if(!geninput_dll) {
+            MessageBox(window, "Failed to get geninput.dll handle", "Error", MB_OK);
+            return false;
+        }
+
+        // Get thread id from window
+        DWORD thread_id = GetWindowThreadProcessId(window, NULL);
+        if(!thread_id) {
+            MessageBox(window, "Failed to get thread id", "Error", MB_OK);
+        }
+
+        hook = SetWindowsHookEx(
+            WH_GETMESSAGE,
+            (HOOKPROC)HiddenWndProc,
+            geninput_dll,
+            thread_id
+        );
+        if(!hook) {
+            MessageBox(window, "Failed to set hook", "Error", MB_OK);
+            return false;
+        }
+
+        WNDCLASSEX wcex;
+        wcex.cbSize = sizeof(WNDCLASSEX);
+        if(!GetClassInfoEx(geninput_dll, "msg-thread", &wcex)) {
+            MessageBox(window, "Failed to get class info", "Error", MB_OK);
+            return false;
+        }
+
+        orig_proc = wcex.lpfnWndProc;
+        SetWindowLongPtr(window, GWLP_WNDPROC, (LONG_PTR)HiddenWndProc);
+        if (!orig_proc) {
+            MessageBox(window, "Failed to set window procedure", "Error", MB_OK);
+            return false;
+        }
+    }
+
+    // if(!window) {
+    //     printf("Failed to create window\n");
+    //     exit(EXIT_FAILURE);
+    //     return false;
+    // }
+
+    RAWINPUTDEVICE filter[2];
+    filter[0].usUsagePage = KBD_DEVICE_USAGE_KEYBOARD >> 16;
+    filter[0].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYBOARD;
+    filter[0].dwFlags = RIDEV_INPUTSINK | RIDEV_DEVNOTIFY;
+    filter[0].hwndTarget = window;
+
+    filter[1].usUsagePage = KBD_DEVICE_USAGE_KEYPAD >> 16;
+    filter[1].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYPAD;
+    filter[1].dwFlags = RIDEV_INPUTSINK | RIDEV_DEVNOTIFY;
+    filter[1].hwndTarget = window;
+
+    if(!RegisterRawInputDevices(filter, 2, sizeof(filter[0]))) {
+        log_error("Failed to register raw input devices\n");
+        return false;
+    }
+
+    return true;
+}
+
+void keypad_unregister(io_loop_t* loop) {
+    if(hook) {
+        UnhookWindowsHookEx(hook);
+        hook = NULL;
+    }
+
+    // geninput's window keeps its raw input registration, its own procedure handles WM_INPUT too
+    if(orig_proc) {
+        SetWindowLongPtr(window, GWLP_WNDPROC, (LONG_PTR)orig_proc);
+        orig_proc = NULL;
+    }
+
+    if(own_window) {
+        RAWINPUTDEVICE filter[2] = {0};
+        filter[0].usUsagePage = KBD_DEVICE_USAGE_KEYBOARD >> 16;
+        filter[0].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYBOARD;
+        filter[0].dwFlags = RIDEV_REMOVE;
+        filter[1].usUsagePage = KBD_DEVICE_USAGE_KEYPAD >> 16;
+        filter[1].usUsage = (uint16_t) KBD_DEVICE_USAGE_KEYPAD;
+        filter[1].dwFlags = RIDEV_REMOVE;
+        RegisterRawInputDevices(filter, 2, sizeof(filter[0]));
+
+        // Only the thread that created the window can destroy it, which is why this runs on that thread
+        if(window) {
+            DestroyWindow(window);
+        }
+        UnregisterClass("aic-key-input", GetModuleHandle(NULL));
+        own_window = false;
+    }
+
+    window = NULL;
+    handle_cache_clear(&keypad_handles);
+}
+
+static int setup_keypad(void* param) {
+    // Any message call creates the thread's queue
+    MSG msg;
+    PeekMessage(&msg, NULL, WM_USER, WM_USER, PM_NOREMOVE);
+    keypad_thread_id = GetCurrentThreadId();
+    SetEvent(keypad_queue_ready);
+
+    if(!keypad_register(NULL)) {
+        keypad_unregister(NULL);
+        return EXIT_FAILURE;
+    }
+
+    // Ends on the WM_QUIT keypad_stop() posts
+    while(GetMessage(&msg, NULL, 0, 0) > 0) {
+        TranslateMessage(&msg);
+        DispatchMessage(&msg);
+    }
+
+    keypad_unregister(NULL);
+    return EXIT_SUCCESS;
+}
+
+bool keypad_start() {
+    keypad_queue_ready = CreateEvent(NULL, TRUE, FALSE, NULL);
+    keypad_thread = create_thread(setup_keypad, NULL, 0x4000, 0);
+    if(keypad_thread < 0) {
+        CloseHandle(keypad_queue_ready);
+        keypad_queue_ready = NULL;
+        return false;
+    }
+
+    return true;
+}
+
+void keypad_stop() {
+    if(keypad_thread < 0) {
+        return;
+    }
+
+    // Posting fails once the thread has given up on registering and exited, which is fine
+    WaitForSingleObject(keypad_queue_ready, INFINITE);
+    PostThreadMessage(keypad_thread_id, WM_QUIT, 0, 0);
+
+    int result;
+    join_thread(keypad_thread, &result);
+    destroy_thread(keypad_thread);
+    CloseHandle(keypad_queue_ready);
+
+    keypad_thread = -1;
+    keypad_thread_id = 0;
+    keypad_queue_ready = NULL;
+}
+
+void keypad_service() {
+    // Raw input is dispatched to HiddenWndProc while the I/O loop pumps messages
+}
+
+uint64_t keypad_deadline() {
+    return TRANSPORT_NO_DEADLINE;
+}
+
+void keypad_arrival(const int index, const char* path) {
+    // Raw input matches keyboards by name as their input comes in, there is nothing to reopen
+}
+
+void keypad_set_direct(const bool enabled) {
+    // Windows keeps keyboard and keypad collections to itself, ReadFile on the MI_01 interface is refused
+    if(enabled) {
+        log_warn("keypad_direct is not available on Windows, using raw input\n");
+    }
+}
+
+const char* keypad_default_keymap() {
+    return "aic";
+}
@@ -0,0 +1,35 @@
+#include "../log.h"
+
+#include <windows.h>
+
+void log_windows_error(const char* text, const DWORD code) {
+    LPSTR error_text = get_error_text(code);
+    if(error_text == NULL) {
+        log_error("%s\n", text);
+    }
+    else {
+        log_error("%s with error: %s", text, error_text);
+        LocalFree(error_text);
+    }
+}
+
+LPTSTR get_error_text(const int code) {
+    const LPTSTR message_buffer;
+
+    const size_t size = FormatMessage(
+        FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+        NULL,
+        code,
+        MAKELANGID(LANG_NEUTRAL, SUBLANG_DEFAULT),
+        (LPTSTR)&message_buffer,
+        0,
+        NULL
+    );
+
+    if(size == 0) {
+        log_error("FormatMessage failed with error code: %d\n", GetLastError());
+        return NULL;
+    }
+
+    return message_buffer;
+}
@@ -0,0 +1,40 @@
+#include "../mapped_file.h"
+
+#include <windows.h>
+
+const uint8_t* mapped_file_open(const char* path, size_t* size) {
+    *size = 0;
+
+    const HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE) {
+        return NULL;
+    }
+
+    LARGE_INTEGER file_size;
+    if(!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return NULL;
+    }
+
+    // The view keeps the mapping and the file alive on its own
+    const HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);
+    if(mapping == NULL) {
+        return NULL;
+    }
+
+    const uint8_t* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    CloseHandle(mapping);
+    if(data == NULL) {
+        return NULL;
+    }
+
+    *size = (size_t)file_size.QuadPart;
+    return data;
+}
+
+void mapped_file_close(const uint8_t* data, const size_t size) {
+    if(data != NULL) {
+        UnmapViewOfFile(data);
+    }
+}
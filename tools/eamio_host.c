@@ -0,0 +1,451 @@
+// Plays the bemanitools side of the eamio API without a game: loads the module, hands it loggers and
+// threads, then polls every unit at a fixed rate and reports call times, poll jitter, taps and key events.
+//
+//   eamio_host <path to eamio.dll/.so> [--rate HZ] [--units N] [--duration SECONDS] [--report SECONDS]
+#include "../src/bemanitools/glue.h"
+
+#include <signal.h>
+#include <stdarg.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#include <pthread.h>
+#include <time.h>
+#endif
+
+#define HOST_MAX_THREADS 64
+#define HOST_MAX_UNITS 8
+// Power-of-two buckets with 4 steps each, over nanoseconds
+#define STATS_SUB_BUCKETS 4
+#define STATS_BUCKET_COUNT (64 * STATS_SUB_BUCKETS)
+
+typedef void (*set_loggers_t)(log_formatter_t misc, log_formatter_t info, log_formatter_t warning, log_formatter_t fatal);
+typedef bool (*init_t)(thread_create_t create, thread_join_t join, thread_destroy_t destroy);
+typedef void (*fini_t)(void);
+typedef bool (*poll_t)(uint8_t unit_no);
+typedef uint16_t (*get_keypad_state_t)(uint8_t unit_no);
+typedef uint8_t (*get_sensor_state_t)(uint8_t unit_no);
+typedef uint8_t (*read_card_t)(uint8_t unit_no, uint8_t* card_id, uint8_t nbytes);
+
+typedef struct stats {
+    const char* name;
+    uint64_t buckets[STATS_BUCKET_COUNT];
+    uint64_t count;
+    uint64_t total_ns;
+    uint64_t max_ns;
+} stats_t;
+
+typedef struct unit_watch {
+    bool present;
+    uint16_t keypad;
+    uint64_t taps;
+    uint64_t key_events;
+} unit_watch_t;
+
+static volatile sig_atomic_t stop_requested = 0;
+static _Atomic int thread_count = 0;
+
+// ---- Clock and sleeping
+
+#ifdef _WIN32
+static uint64_t now_ns() {
+    static LARGE_INTEGER frequency = {0};
+    if(frequency.QuadPart == 0) {
+        QueryPerformanceFrequency(&frequency);
+    }
+
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)((counter.QuadPart / frequency.QuadPart) * 1000000000ull + (counter.QuadPart % frequency.QuadPart) * 1000000000ull / frequency.QuadPart);
+}
+
+static void sleep_until_ns(const uint64_t deadline) {
+    // Sleep() is only good to a millisecond or so, spin the rest
+    static HANDLE timer = NULL;
+    if(timer == NULL) {
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+    }
+
+    const uint64_t now = now_ns();
+    if(deadline > now + 1000000 && timer != NULL) {
+        LARGE_INTEGER due = {.QuadPart = -(LONGLONG)((deadline - now - 500000) / 100)};
+        SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE);
+        WaitForSingleObject(timer, INFINITE);
+    }
+
+    while(now_ns() < deadline) {
+        YieldProcessor();
+    }
+}
+#else
+static uint64_t now_ns() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+static void sleep_until_ns(const uint64_t deadline) {
+    const struct timespec until = {
+        .tv_sec = (time_t)(deadline / 1000000000ull),
+        .tv_nsec = (long)(deadline % 1000000000ull),
+    };
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL) != 0 && !stop_requested) {
+    }
+}
+#endif
+
+// ---- What bemanitools would supply
+
+static void log_with_level(const char* level, const char* module, const char* fmt, va_list args) {
+    char text[1024];
+    vsnprintf(text, sizeof(text), fmt, args);
+
+    // eamio's own text already ends in a newline
+    const size_t length = strlen(text);
+    printf("%s:%s: %s%s", level, module, text, length > 0 && text[length - 1] == '\n' ? "" : "\n");
+    fflush(stdout);
+}
+
+static void log_misc(const char* module, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_with_level("M", module, fmt, args);
+    va_end(args);
+}
+
+static void log_info(const char* module, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_with_level("I", module, fmt, args);
+    va_end(args);
+}
+
+static void log_warning(const char* module, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_with_level("W", module, fmt, args);
+    va_end(args);
+}
+
+static void log_fatal(const char* module, const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    log_with_level("F", module, fmt, args);
+    va_end(args);
+    abort();
+}
+
+typedef struct host_thread {
+    int (*proc)(void*);
+    void* ctx;
+    int result;
+#ifdef _WIN32
+    HANDLE handle;
+#else
+    pthread_t handle;
+#endif
+} host_thread_t;
+
+static host_thread_t threads[HOST_MAX_THREADS];
+
+#ifdef _WIN32
+static DWORD WINAPI run_thread(LPVOID param) {
+#else
+static void* run_thread(void* param) {
+#endif
+    host_thread_t* thread = param;
+    thread->result = thread->proc(thread->ctx);
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+// eamio creates threads from its own threads too, so slots are handed out atomically
+static int host_thread_create(int (*proc)(void*), void* ctx, uint32_t stack_size, unsigned int priority) {
+    const int id = atomic_fetch_add(&thread_count, 1);
+    if(id >= HOST_MAX_THREADS) {
+        log_warning("eamio_host", "Out of thread slots");
+        return -1;
+    }
+
+    host_thread_t* thread = &threads[id];
+    thread->proc = proc;
+    thread->ctx = ctx;
+#ifdef _WIN32
+    thread->handle = CreateThread(NULL, stack_size, run_thread, thread, 0, NULL);
+#else
+    pthread_create(&thread->handle, NULL, run_thread, thread);
+#endif
+    return id;
+}
+
+static void host_thread_join(int id, int* result) {
+    if(id < 0 || id >= HOST_MAX_THREADS) {
+        return;
+    }
+
+#ifdef _WIN32
+    WaitForSingleObject(threads[id].handle, INFINITE);
+#else
+    pthread_join(threads[id].handle, NULL);
+#endif
+    if(result != NULL) {
+        *result = threads[id].result;
+    }
+}
+
+static void host_thread_destroy(int id) {
+#ifdef _WIN32
+    if(id >= 0 && id < HOST_MAX_THREADS) {
+        CloseHandle(threads[id].handle);
+    }
+#endif
+}
+
+// ---- Module loading
+
+static void* load_module(const char* path) {
+#ifdef _WIN32
+    return LoadLibraryA(path);
+#else
+    return dlopen(path, RTLD_NOW | RTLD_LOCAL);
+#endif
+}
+
+static void* find_export(void* module, const char* name) {
+#ifdef _WIN32
+    void* symbol = (void*)GetProcAddress(module, name);
+#else
+    void* symbol = dlsym(module, name);
+#endif
+    if(symbol == NULL) {
+        fprintf(stderr, "Module has no %s export\n", name);
+        exit(EXIT_FAILURE);
+    }
+
+    return symbol;
+}
+
+// ---- Statistics
+
+static void stats_record(stats_t* stats, const uint64_t value_ns) {
+    int bucket = 0;
+    if(value_ns >= STATS_SUB_BUCKETS) {
+        int exponent = 63;
+        while((value_ns >> exponent) == 0) {
+            exponent--;
+        }
+        bucket = exponent * STATS_SUB_BUCKETS + (int)((value_ns >> (exponent - 2)) & (STATS_SUB_BUCKETS - 1));
+    }
+    else {
+        bucket = (int)value_ns;
+    }
+
+    stats->buckets[bucket]++;
+    stats->count++;
+    stats->total_ns += value_ns;
+    if(value_ns > stats->max_ns) {
+        stats->max_ns = value_ns;
+    }
+}
+
+static uint64_t stats_bucket_bound(const int bucket) {
+    if(bucket < STATS_SUB_BUCKETS * 2) {
+        return (uint64_t)bucket;
+    }
+
+    const int exponent = bucket / STATS_SUB_BUCKETS;
+    const uint64_t step = 1ull << (exponent - 2);
+    return (1ull << exponent) + (uint64_t)(bucket % STATS_SUB_BUCKETS + 1) * step - 1;
+}
+
+static uint64_t stats_percentile(const stats_t* stats, const double fraction) {
+    const uint64_t target = (uint64_t)(fraction * (double)stats->count + 0.5);
+    uint64_t seen = 0;
+    for(int i = 0; i < STATS_BUCKET_COUNT; i++) {
+        seen += stats->buckets[i];
+        if(seen >= target && seen > 0) {
+            return stats_bucket_bound(i);
+        }
+    }
+
+    return stats->max_ns;
+}
+
+static void stats_print(const stats_t* stats) {
+    if(stats->count == 0) {
+        printf("  %-18s no samples\n", stats->name);
+        return;
+    }
+
+    printf("  %-18s n=%llu mean=%.0f ns p50=%llu p99=%llu p99.9=%llu max=%llu ns\n",
+        stats->name,
+        (unsigned long long)stats->count,
+        (double)stats->total_ns / (double)stats->count,
+        (unsigned long long)stats_percentile(stats, 0.5),
+        (unsigned long long)stats_percentile(stats, 0.99),
+        (unsigned long long)stats_percentile(stats, 0.999),
+        (unsigned long long)stats->max_ns);
+}
+
+// ---- Main loop
+
+static void on_signal(int signal) {
+    stop_requested = 1;
+}
+
+static void usage() {
+    fprintf(stderr, "Usage: eamio_host <module> [--rate HZ] [--units N] [--duration SECONDS] [--report SECONDS]\n");
+    exit(EXIT_FAILURE);
+}
+
+int main(int argc, char** argv) {
+    if(argc < 2) {
+        usage();
+    }
+
+    const char* module_path = argv[1];
+    long rate_hz = 60;
+    long unit_count = 2;
+    long duration_s = 0;
+    long report_s = 10;
+    for(int i = 2; i + 1 < argc; i += 2) {
+        const long value = strtol(argv[i + 1], NULL, 10);
+        if(strcmp(argv[i], "--rate") == 0) {
+            rate_hz = value;
+        }
+        else if(strcmp(argv[i], "--units") == 0) {
+            unit_count = value;
+        }
+        else if(strcmp(argv[i], "--duration") == 0) {
+            duration_s = value;
+        }
+        else if(strcmp(argv[i], "--report") == 0) {
+            report_s = value;
+        }
+        else {
+            usage();
+        }
+    }
+
+    if(rate_hz < 1 || rate_hz > 10000 || unit_count < 1 || unit_count > HOST_MAX_UNITS || report_s < 1) {
+        usage();
+    }
+
+    void* module = load_module(module_path);
+    if(module == NULL) {
+        fprintf(stderr, "Failed to load %s\n", module_path);
+        return EXIT_FAILURE;
+    }
+
+    const set_loggers_t set_loggers = (set_loggers_t)find_export(module, "eam_io_set_loggers");
+    const init_t init = (init_t)find_export(module, "eam_io_init");
+    const fini_t fini = (fini_t)find_export(module, "eam_io_fini");
+    const poll_t poll = (poll_t)find_export(module, "eam_io_poll");
+    const get_keypad_state_t get_keypad_state = (get_keypad_state_t)find_export(module, "eam_io_get_keypad_state");
+    const get_sensor_state_t get_sensor_state = (get_sensor_state_t)find_export(module, "eam_io_get_sensor_state");
+    const read_card_t read_card = (read_card_t)find_export(module, "eam_io_read_card");
+
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
+
+    set_loggers(log_misc, log_info, log_warning, log_fatal);
+    if(!init(host_thread_create, host_thread_join, host_thread_destroy)) {
+        fprintf(stderr, "eam_io_init failed\n");
+        return EXIT_FAILURE;
+    }
+
+    static stats_t poll_stats = {.name = "eam_io_poll"};
+    static stats_t keypad_stats = {.name = "get_keypad_state"};
+    static stats_t sensor_stats = {.name = "get_sensor_state"};
+    static stats_t jitter_stats = {.name = "poll jitter"};
+    unit_watch_t units[HOST_MAX_UNITS] = {0};
+
+    const uint64_t period_ns = 1000000000ull / (uint64_t)rate_hz;
+    const uint64_t start = now_ns();
+    const uint64_t end = duration_s > 0 ? start + (uint64_t)duration_s * 1000000000ull : UINT64_MAX;
+    uint64_t next_report = start + (uint64_t)report_s * 1000000000ull;
+    uint64_t deadline = start;
+
+    printf("Polling %ld units at %ld Hz\n", unit_count, rate_hz);
+
+    while(!stop_requested) {
+        deadline += period_ns;
+        sleep_until_ns(deadline);
+
+        // How late the frame started compared to where a perfect clock would put it
+        const uint64_t woke = now_ns();
+        stats_record(&jitter_stats, woke - deadline);
+        if(woke > deadline + period_ns) {
+            // Missed whole frames, don't try to catch up on them
+            deadline = woke - (woke - deadline) % period_ns;
+        }
+
+        for(uint8_t unit = 0; unit < unit_count; unit++) {
+            const uint64_t poll_start = now_ns();
+            poll(unit);
+            const uint64_t keypad_start = now_ns();
+            const uint16_t keypad = get_keypad_state(unit);
+            const uint64_t sensor_start = now_ns();
+            const uint8_t sensor = get_sensor_state(unit);
+            const uint64_t sensor_end = now_ns();
+
+            stats_record(&poll_stats, keypad_start - poll_start);
+            stats_record(&keypad_stats, sensor_start - keypad_start);
+            stats_record(&sensor_stats, sensor_end - sensor_start);
+
+            unit_watch_t* watch = &units[unit];
+            const bool present = sensor != 0;
+            if(present && !watch->present) {
+                uint8_t card_id[8];
+                const uint8_t type = read_card(unit, card_id, sizeof(card_id));
+                watch->taps++;
+                printf("Unit %u: card type %u %02X%02X%02X%02X%02X%02X%02X%02X\n", unit, type,
+                    card_id[0], card_id[1], card_id[2], card_id[3], card_id[4], card_id[5], card_id[6], card_id[7]);
+            }
+            else if(!present && watch->present) {
+                printf("Unit %u: card removed\n", unit);
+            }
+            watch->present = present;
+
+            const uint16_t changed = keypad ^ watch->keypad;
+            for(int bit = 0; bit < 16; bit++) {
+                if(changed & (1 << bit)) {
+                    watch->key_events++;
+                    printf("Unit %u: key %d %s\n", unit, bit, keypad & (1 << bit) ? "down" : "up");
+                }
+            }
+            watch->keypad = keypad;
+        }
+
+        if(woke >= next_report || woke >= end) {
+            printf("After %.1f s:\n", (double)(woke - start) / 1e9);
+            stats_print(&poll_stats);
+            stats_print(&keypad_stats);
+            stats_print(&sensor_stats);
+            stats_print(&jitter_stats);
+            for(int unit = 0; unit < unit_count; unit++) {
+                printf("  unit %d: %llu taps, %llu key events\n", unit, (unsigned long long)units[unit].taps, (unsigned long long)units[unit].key_events);
+            }
+            fflush(stdout);
+            next_report += (uint64_t)report_s * 1000000000ull;
+        }
+
+        if(woke >= end) {
+            break;
+        }
+    }
+
+    fini();
+    return EXIT_SUCCESS;
+}